@@ -24,11 +24,13 @@ SOFTWARE.
 ***********************************************************************/
 
 #include "FeedingGameController.h"
+#include "../FrameClock.h"
 
 CFeedingGameController::CFeedingGameController()
 {
     // Inicializa o estado atual do jogo como ocioso
     currentState = STATE_IDLE;
+    projectorLayerVersion = 0;
 
     // SISTEMA DE NÍVEIS
     // Define o nível atual, máximo de níveis, status de conclusão e comida alvo
@@ -195,7 +197,7 @@ void CFeedingGameController::goToNextLevel()
     if (currentLevel > maxLevels) {
         // JOGO COMPLETO - TODOS NÍVEIS CONCLUÍDOS
         currentState = STATE_SHOWING_RESULTS;
-        resultsStartTime = ofGetElapsedTimef();
+        resultsStartTime = FrameClock::getElapsedTimef();
         victory = true;
         // Gerar efeitos de vitória final
         generateVictoryEffects();
@@ -204,7 +206,7 @@ void CFeedingGameController::goToNextLevel()
 
     // VAI PARA TELA DE LEVEL COMPLETE
     currentState = STATE_LEVEL_COMPLETE;
-    levelTransitionStartTime = ofGetElapsedTimef();
+    levelTransitionStartTime = FrameClock::getElapsedTimef();
     // Resetar flag para gerar novos efeitos
     levelCompleteEffectsGenerated = false;
 }
@@ -212,6 +214,7 @@ void CFeedingGameController::goToNextLevel()
 void CFeedingGameController::setup(std::shared_ptr<KinectProjector> const& k)
 {
     kinectProjector = k; // Armazena referência ao KinectProjector
+    vehicleRenderer.setup(); // Geometria dos animais e shader de instâncias
 
     // Configura fontes para texto
     gameFont.load("verdana.ttf", 45);   // Fonte para títulos
@@ -220,20 +223,18 @@ void CFeedingGameController::setup(std::shared_ptr<KinectProjector> const& k)
     resetGame(); // Inicializa o jogo
 }
 
-void CFeedingGameController::update()
+void CFeedingGameController::update(const SimulationClock& clock)
 {
-    // Estado ocioso - apenas limpa o FBO
+    // Estado ocioso - a camada não é desenhada pelo compositor, nada a fazer
+    // (todos os outros estados limpam o FBO antes de desenhar)
     if (currentState == STATE_IDLE) {
-        fboGame.begin();
-        ofClear(0, 0, 0, 0); // Limpa com transparência total
-        ofSetColor(255, 255, 255, 150);
-        fboGame.end();
         return;
     }
+    projectorLayerVersion++;
 
     // Estado de introdução - verifica se tempo acabou
     if (currentState == STATE_INTRO) {
-        float currentTime = ofGetElapsedTimef();
+        float currentTime = FrameClock::getElapsedTimef();
         if (currentTime - introStartTime > introDisplayTime) {
             startFromIntro(); // Começa o jogo após introdução
         }
@@ -242,7 +243,7 @@ void CFeedingGameController::update()
 
     // Estado de jogo ativo
     if (currentState == STATE_PLAYING) {
-        float currentTime = ofGetElapsedTimef();
+        float currentTime = FrameClock::getElapsedTimef();
         float levelElapsedTime = currentTime - levelStartTime;
 
         // VERIFICA SE NÍVEL FOI COMPLETADO (por comida coletada)
@@ -276,7 +277,7 @@ void CFeedingGameController::update()
         }
 
         // Update do estado do jogo
-        updateGameState();
+        updateGameState(clock);
 
         // Renderiza cena do jogo no FBO
         fboGame.begin();
@@ -287,9 +288,7 @@ void CFeedingGameController::update()
         drawFoodItems();
 
         // Desenha animais na cena
-        for (auto &f : fish) {
-            f.draw(); // Desenha cada peixe
-        }
+        vehicleRenderer.draw(fish); // Desenha todos os peixes
         fboGame.end();
     }
 
@@ -298,19 +297,19 @@ void CFeedingGameController::update()
         // Atualizar efeitos visuais (confete, estrelas, etc.)
         updateVisualEffects();
 
-        float currentTime = ofGetElapsedTimef();
+        float currentTime = FrameClock::getElapsedTimef();
         // Verifica se tempo de transição acabou
         if (currentTime - levelTransitionStartTime > levelTransitionDuration) {
             // PREPARA PRÓXIMO NÍVEL
             applyLevelConfig(currentLevel);
             levelCompleted = false;
-            levelStartTime = ofGetElapsedTimef();
+            levelStartTime = FrameClock::getElapsedTimef();
             
             // RESETA ESTADO PARA NOVO NÍVEL
             spawnInitialFish(); // Cria novos peixes
             foodItems.clear();  // Remove toda comida
             foodCollected = 0;  // Reseta contador
-            lastFoodSpawnTime = ofGetElapsedTimef();
+            lastFoodSpawnTime = FrameClock::getElapsedTimef();
 
             // Limpar efeitos visuais
             clearVisualEffects();
@@ -328,7 +327,7 @@ void CFeedingGameController::update()
             updateVisualEffects();
         }
 
-        float currentTime = ofGetElapsedTimef();
+        float currentTime = FrameClock::getElapsedTimef();
         // Verifica se tempo de exibição acabou
         if (currentTime - resultsStartTime > resultsDisplayTime) {
             resetGame(); // Reinicia o jogo
@@ -336,18 +335,25 @@ void CFeedingGameController::update()
     }
 }
 
-void CFeedingGameController::updateGameState()
+void CFeedingGameController::updateGameState(const SimulationClock& clock)
 {
     // Só atualiza estado se a imagem do Kinect estiver estável
     if (kinectProjector->isImageStabilized()) {
-        // Update fish - aplica comportamentos e atualiza posição
-        for (auto &f : fish) {
-            // Comportamentos sem perigos (segundo jogo não tem tubarões)
-            f.applyBehaviours(false, fish, std::vector<DangerousBOID>());
-            f.update();
+        // Passos fixos de simulação: a velocidade dos peixes não depende do frame rate
+        for (int tick = 0; tick < clock.getTicks(); tick++) {
+            // Update fish - aplica comportamentos e atualiza posição
+            // (grade de vizinhança reconstruída a cada passo)
+            flockGrid.build(fish);
+            for (auto &f : fish) {
+                // Comportamentos sem perigos (segundo jogo não tem tubarões)
+                f.applyBehaviours(false, fish, flockGrid, std::vector<DangerousBOID>());
+                f.update();
+            }
+            // Verifica colisões entre peixes e comida
+            checkFoodCollection();
         }
-        // Verifica colisões entre peixes e comida
-        checkFoodCollection();
+        // Desenha entre os dois últimos passos
+        Vehicle::updateProjectorCoords(*kinectProjector, fish, clock.getAlpha());
     }
 }
 
@@ -399,7 +405,7 @@ void CFeedingGameController::spawnFood()
         FoodItem food;
         food.location = location;
         food.active = true;
-        food.spawnTime = ofGetElapsedTimef(); // Marca tempo de criação
+        food.spawnTime = FrameClock::getElapsedTimef(); // Marca tempo de criação
         foodItems.push_back(food); // Adiciona à lista
     }
 }
@@ -407,11 +413,12 @@ void CFeedingGameController::spawnFood()
 void CFeedingGameController::generateConfettiEffects()
 {
     confettiParticles.clear(); // Limpa partículas existentes
+    confettiParticles.setPhysics(0.1, 0.99); // Gravidade e resistência do ar
+    confettiParticles.setWrap(-50, projROI.height + 50, 0, projROI.width); // Ao sair por baixo, volta ao topo
 
-    int particleCount = 150; // Quantidade de confetes
+    int particleCount = 1500; // Quantidade de confetes
+    confettiParticles.reserve(particleCount);
     for (int i = 0; i < particleCount; i++) {
-        ConfettiParticle p;
-        
         // Define posição inicial aleatória
         float spawnX = ofRandom(0, projROI.width);
         float spawnY;
@@ -424,34 +431,29 @@ void CFeedingGameController::generateConfettiEffects()
             spawnY = ofRandom(-100, projROI.height * 0.3);
         }
 
-        p.position.set(spawnX, spawnY);
-        p.velocity.set(ofRandom(-1, 1), ofRandom(1, 3)); // Velocidade mais lenta
-
+        ofColor color;
         // Cores em tons de amarelo/laranja para combinar com tema de comida
         int colorType = ofRandom(4);
         switch (colorType) {
-        case 0: p.color = ofColor(255, 200, 50); break;  // Amarelo dourado
-        case 1: p.color = ofColor(255, 150, 50); break;  // Laranja
-        case 2: p.color = ofColor(255, 255, 100); break; // Amarelo claro
-        case 3: p.color = ofColor(255, 100, 50); break;  // Laranja avermelhado
+        case 0: color = ofColor(255, 200, 50); break;  // Amarelo dourado
+        case 1: color = ofColor(255, 150, 50); break;  // Laranja
+        case 2: color = ofColor(255, 255, 100); break; // Amarelo claro
+        case 3: color = ofColor(255, 100, 50); break;  // Laranja avermelhado
         }
 
-        p.size = ofRandom(8, 15); // Tamanho menor
-        p.rotation = ofRandom(0, 360);
-        p.rotationSpeed = ofRandom(-3, 3); // Rotação mais lenta
-
-        confettiParticles.push_back(p); // Adiciona à lista
+        // Velocidade mais lenta, tamanho menor e rotação mais lenta
+        confettiParticles.add(ofVec2f(spawnX, spawnY), ofVec2f(ofRandom(-1, 1), ofRandom(1, 3)), color,
+            ofRandom(8, 15), ofRandom(0, 360), ofRandom(-3, 3));
     }
 }
 
 void CFeedingGameController::generateStarEffects()
 {
     starEffects.clear(); // Limpa estrelas existentes
+    starEffects.setFallback(ofColor(255, 255, 0), true); // Sem imagem: círculos amarelos
 
     int starCount = 15;
     for (int i = 0; i < starCount; i++) {
-        StarEffect star;
-
         // Posicionar estrelas nas bordas, evitando o centro
         float posX, posY;
         if (ofRandom(1.0) < 0.5) {
@@ -465,12 +467,9 @@ void CFeedingGameController::generateStarEffects()
             posY = ofRandom(1.0) < 0.5 ? ofRandom(0, 80) : ofRandom(projROI.height - 200, projROI.height - 100);
         }
 
-        star.position.set(posX, posY);
-        star.size = ofRandom(starMinSize, starMaxSize); // Tamanho aleatório
-        star.alpha = ofRandom(80, 180); // Transparência variável
-        star.pulseSpeed = ofRandom(0.3, 1.5); // Velocidade de pulsação
-
-        starEffects.push_back(star); // Adiciona à lista
+        // Tamanho aleatório, transparência variável e velocidade de pulsação
+        starEffects.add(ofVec2f(posX, posY), ofVec2f(0, 0), ofColor(255), ofRandom(starMinSize, starMaxSize),
+            0, 0, ofRandom(80, 180), ofRandom(0.3, 1.5));
     }
 }
 
@@ -479,17 +478,13 @@ void CFeedingGameController::generateVictoryEffects()
     // Gerar confete básico
     generateConfettiEffects();
 
-    // Adicionar mais confete especial para vitória
-    for (int i = 0; i < 100; i++) {
-        ConfettiParticle p;
-        p.position.set(ofRandom(0, projROI.width),
-            ofRandom(0, projROI.height));
-        p.velocity.set(ofRandom(-3, 3), ofRandom(-3, 3));
-        p.color = ofColor(255, 200, 50); // Dourado para vitória (tema comida)
-        p.size = ofRandom(15, 30); // Maior que confete normal
-        p.rotation = ofRandom(0, 360);
-        p.rotationSpeed = ofRandom(-8, 8); // Rotação mais rápida
-        confettiParticles.push_back(p);
+    // Adicionar mais confete especial para vitória: maior que o confete normal, rotação mais rápida
+    int particleCount = 1000;
+    confettiParticles.reserve(confettiParticles.size() + particleCount);
+    for (int i = 0; i < particleCount; i++) {
+        ofColor color = ofColor(255, 200, 50); // Dourado para vitória (tema comida)
+        confettiParticles.add(ofVec2f(ofRandom(0, projROI.width), ofRandom(0, projROI.height)), ofVec2f(ofRandom(-3, 3), ofRandom(-3, 3)), color,
+            ofRandom(15, 30), ofRandom(0, 360), ofRandom(-8, 8));
     }
 
     // Gerar estrelas
@@ -499,30 +494,11 @@ void CFeedingGameController::generateVictoryEffects()
 
 void CFeedingGameController::updateVisualEffects()
 {
-    // Atualizar partículas de confete
-    for (auto& p : confettiParticles) {
-        p.position += p.velocity; // Move partícula
-        p.rotation += p.rotationSpeed; // Rotaciona
-
-        // Gravidade - puxa para baixo
-        p.velocity.y += 0.1;
-
-        // Reduz velocidade com resistência do ar
-        p.velocity *= 0.99;
-
-        // Se sair da parte inferior da tela, resetar para o topo
-        if (p.position.y > projROI.height + 50) {
-            p.position.y = -50;
-            p.position.x = ofRandom(0, projROI.width);
-        }
-    }
+    // Atualizar partículas de confete (movimento, rotação, gravidade, retorno ao topo)
+    confettiParticles.update();
 
     // Atualizar estrelas piscantes (efeito de pulsação)
-    float currentTime = ofGetElapsedTimef();
-    for (auto& star : starEffects) {
-        // Usa seno para criar efeito de pulsação
-        star.alpha = 150 + 105 * sin(currentTime * star.pulseSpeed);
-    }
+    starEffects.update();
 }
 
 void CFeedingGameController::clearVisualEffects()
@@ -554,7 +530,7 @@ void CFeedingGameController::drawFoodItems()
         ofDrawCircle(0, 0, foodSize);
 
         // Efeito de pulsação para destacar a comida
-        float pulse = sin(ofGetElapsedTimef() * 5) * 2 + foodSize;
+        float pulse = sin(FrameClock::getElapsedTimef() * 5) * 2 + foodSize;
         ofSetColor(255, 165, 0, 100); // Laranja semi-transparente
         ofDrawCircle(0, 0, pulse);
 
@@ -564,7 +540,7 @@ void CFeedingGameController::drawFoodItems()
 
 void CFeedingGameController::drawGameInfo()
 {
-    float currentTime = ofGetElapsedTimef();
+    float currentTime = FrameClock::getElapsedTimef();
     float levelElapsedTime = currentTime - levelStartTime;
     float levelTimeLeft = levelDuration - levelElapsedTime;
 
@@ -582,10 +558,10 @@ void CFeedingGameController::drawGameInfo()
     //   LINHA 1: CENTRALIZAR FASE
     // ===========================================
     float yLine1 = 80; // Altura da primeira linha
-    float wLevel = gameFont.stringWidth(levelStr);
+    float wLevel = hud.stringWidth(gameFont, levelStr);
     float xLevel = (ofGetWidth() - wLevel) / 2; // Centraliza horizontalmente
 
-    gameFont.drawString(levelStr, xLevel, yLine1);
+    hud.drawString(gameFont, levelStr, xLevel, yLine1);
 
     // ===========================================
     //   LINHA 2: TEMPO E COMIDA LADO A LADO
@@ -593,8 +569,8 @@ void CFeedingGameController::drawGameInfo()
     float yLine2 = 140; // Altura da segunda linha (abaixo da primeira)
 
     // Calcula larguras dos textos
-    float wTime = scoreFont.stringWidth(timeStr);
-    float wFood = scoreFont.stringWidth(foodStr);
+    float wTime = hud.stringWidth(scoreFont, timeStr);
+    float wFood = hud.stringWidth(scoreFont, foodStr);
     float spacing = 100; // Espaçamento entre tempo e comida
 
     // Calcula posicionamento para centralizar grupo
@@ -602,10 +578,10 @@ void CFeedingGameController::drawGameInfo()
     float startX = (ofGetWidth() - totalWidth) / 2;
 
     // Desenhar Tempo
-    scoreFont.drawString(timeStr, startX, yLine2);
+    hud.drawString(scoreFont, timeStr, startX, yLine2);
 
     // Desenhar Comida
-    scoreFont.drawString(foodStr, startX + wTime + spacing, yLine2);
+    hud.drawString(scoreFont, foodStr, startX + wTime + spacing, yLine2);
 }
 
 void CFeedingGameController::drawIntroScreen()
@@ -623,30 +599,30 @@ void CFeedingGameController::drawIntroScreen()
         // Título centralizado
         ofSetColor(0, 0, 0); // Preto
         string title = "JOGO DE ALIMENTACAO";
-        float titleW = gameFont.stringWidth(title);
+        float titleW = hud.stringWidth(gameFont, title);
         float titleX = (projROI.width - titleW) / 2;
-        gameFont.drawString(title, titleX, 100);
+        hud.drawString(gameFont, title, titleX, 100);
 
         // Informações sobre o jogo
         string line1 = "Complete " + ofToString(maxLevels) + " fases!";
-        float line1W = scoreFont.stringWidth(line1);
+        float line1W = hud.stringWidth(scoreFont, line1);
         float line1X = (projROI.width - line1W) / 2;
-        scoreFont.drawString(line1, line1X, 180);
+        hud.drawString(scoreFont, line1, line1X, 180);
 
         string line2 = "Leve os peixes ate a comida.";
-        float line2W = scoreFont.stringWidth(line2);
+        float line2W = hud.stringWidth(scoreFont, line2);
         float line2X = (projROI.width - line2W) / 2;
-        scoreFont.drawString(line2, line2X, 230);
+        hud.drawString(scoreFont, line2, line2X, 230);
     }
 
     // Contador regressivo - Centralizado
-    float timeLeft = introDisplayTime - (ofGetElapsedTimef() - introStartTime);
+    float timeLeft = introDisplayTime - (FrameClock::getElapsedTimef() - introStartTime);
     string countdown = "O jogo inicia em: " + ofToString((int)timeLeft) + "s";
-    float countdownW = scoreFont.stringWidth(countdown);
+    float countdownW = hud.stringWidth(scoreFont, countdown);
     float countdownX = (projROI.width - countdownW) / 2;
 
     ofSetColor(0, 0, 0); // Preto
-    scoreFont.drawString(countdown, countdownX, projROI.height - 100);
+    hud.drawString(scoreFont, countdown, countdownX, projROI.height - 100);
 
     fboGame.end();
 }
@@ -669,44 +645,11 @@ void CFeedingGameController::drawLevelCompleteScreen()
     // CAMADA 1: EFEITOS DE FUNDO (mais suaves)
     ofPushStyle();
 
-    // Confete de fundo (mais transparente)
-    for (const auto& p : confettiParticles) {
-        if (p.position.y > projROI.height * 0.4) { // Só desenha na parte inferior
-            ofPushMatrix();
-            ofTranslate(p.position); // Move para posição da partícula
-            ofRotate(p.rotation);    // Rotaciona
-
-            if (confettiImage.isAllocated()) {
-                ofSetColor(p.color, 100); // Cor com transparência
-                confettiImage.draw(-p.size / 2, -p.size / 2, p.size, p.size);
-            }
-            else {
-                // Fallback: quadrado colorido
-                ofSetColor(p.color, 80);
-                ofDrawRectangle(-p.size / 2, -p.size / 2, p.size, p.size);
-            }
-
-            ofPopMatrix();
-        }
-    }
+    // Confete de fundo (mais transparente), só desenha na parte inferior
+    confettiParticles.draw(confettiImage, 100.0 / 255, 80.0 / 255, projROI.height * 0.4);
 
-    // Estrelas aumentadas (apenas nas bordas)
-    for (const auto& star : starEffects) {
-        // Verifica se está nas bordas da tela
-        if (star.position.x < 100 || star.position.x > projROI.width - 100 ||
-            star.position.y < 100 || star.position.y > projROI.height - 200) {
-            if (starsImage.isAllocated()) {
-                ofSetColor(255, 255, 255, star.alpha * 0.6);
-                starsImage.draw(star.position - ofVec2f(star.size / 2, star.size / 2),
-                    star.size, star.size);
-            }
-            else {
-                // Fallback: círculo amarelo
-                ofSetColor(255, 255, 0, star.alpha * 0.6);
-                ofDrawCircle(star.position, star.size / 2);
-            }
-        }
-    }
+    // Estrelas aumentadas (geradas apenas nas bordas)
+    starEffects.draw(starsImage, 0.6, 0.6);
     ofPopStyle();
 
     // CAMADA 2: troféu DA FASE COMPLETADA
@@ -742,8 +685,8 @@ void CFeedingGameController::drawLevelCompleteScreen()
         // Texto da troféu (opcional)
         if (!trophyText.empty()) {
             ofSetColor(255, 255, 200);
-            scoreFont.drawString(trophyText, 
-                (projROI.width - scoreFont.stringWidth(trophyText)) / 2, 
+            hud.drawString(scoreFont, trophyText, 
+                (projROI.width - hud.stringWidth(scoreFont, trophyText)) / 2, 
                 trophyY + trophySize + 30);
         }
     }
@@ -762,16 +705,16 @@ void CFeedingGameController::drawLevelCompleteScreen()
 
     // Título com sombra
     string title = "FASE " + ofToString(currentLevel - 1) + " SUPERADA!";
-    float titleW = gameFont.stringWidth(title);
+    float titleW = hud.stringWidth(gameFont, title);
     float titleX = (projROI.width - titleW) / 2;
 
     // Sombra do título (para legibilidade)
     ofSetColor(0, 0, 0, 220);
-    gameFont.drawString(title, titleX + 3, textBoxY + 3);
+    hud.drawString(gameFont, title, titleX + 3, textBoxY + 3);
 
     // Título principal com cor vibrante (amarelo para combinar com tema de comida)
     ofSetColor(255, 255, 0);
-    gameFont.drawString(title, titleX, textBoxY);
+    hud.drawString(gameFont, title, titleX, textBoxY);
 
     // Linha divisória decorativa sutil
     ofSetColor(255, 200, 0, 80);
@@ -780,41 +723,41 @@ void CFeedingGameController::drawLevelCompleteScreen()
 
     // Informações sobre próxima fase
     string prepare = "Prepare-se para:";
-    float prepareW = scoreFont.stringWidth(prepare);
+    float prepareW = hud.stringWidth(scoreFont, prepare);
     float prepareX = (projROI.width - prepareW) / 2;
 
     // Sombra
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(prepare, prepareX + 2, textBoxY + 151);
+    hud.drawString(scoreFont, prepare, prepareX + 2, textBoxY + 151);
 
     // Texto principal
     ofSetColor(255, 255, 0);
-    scoreFont.drawString(prepare, prepareX, textBoxY + 150);
+    hud.drawString(scoreFont, prepare, prepareX, textBoxY + 150);
 
     // Detalhes da próxima fase
     string foodTarget = "- " + ofToString(nextConfig.targetFood) + " Alimentos para coletar";
-    float foodTargetW = scoreFont.stringWidth(foodTarget);
+    float foodTargetW = hud.stringWidth(scoreFont, foodTarget);
     float foodTargetX = (projROI.width - foodTargetW) / 2;
 
     // Sombra
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(foodTarget, foodTargetX + 2, textBoxY + 201);
+    hud.drawString(scoreFont, foodTarget, foodTargetX + 2, textBoxY + 201);
 
     // Texto principal
     ofSetColor(255, 255, 200);
-    scoreFont.drawString(foodTarget, foodTargetX, textBoxY + 200);
+    hud.drawString(scoreFont, foodTarget, foodTargetX, textBoxY + 200);
 
     string fishCount = "- " + ofToString(nextConfig.initialFish) + " peixes famintos";
-    float fishCountW = scoreFont.stringWidth(fishCount);
+    float fishCountW = hud.stringWidth(scoreFont, fishCount);
     float fishCountX = (projROI.width - fishCountW) / 2;
 
     // Sombra
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(fishCount, fishCountX + 2, textBoxY + 251);
+    hud.drawString(scoreFont, fishCount, fishCountX + 2, textBoxY + 251);
 
     // Texto principal
     ofSetColor(200, 200, 255);
-    scoreFont.drawString(fishCount, fishCountX, textBoxY + 250);
+    hud.drawString(scoreFont, fishCount, fishCountX, textBoxY + 250);
 
     ofPopStyle();
 
@@ -826,18 +769,18 @@ void CFeedingGameController::drawLevelCompleteScreen()
     ofDrawRectangle(0, projROI.height - 70, projROI.width, 70);
 
     // Calcula e desenha contador regressivo
-    float timeLeft = levelTransitionDuration - (ofGetElapsedTimef() - levelTransitionStartTime);
+    float timeLeft = levelTransitionDuration - (FrameClock::getElapsedTimef() - levelTransitionStartTime);
     string countdown = "Fase seguinte em: " + ofToString((int)timeLeft) + "s";
-    float countdownW = scoreFont.stringWidth(countdown);
+    float countdownW = hud.stringWidth(scoreFont, countdown);
     float countdownX = (projROI.width - countdownW) / 2;
 
     // Sombra do contador
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(countdown, countdownX + 1, projROI.height - 21);
+    hud.drawString(scoreFont, countdown, countdownX + 1, projROI.height - 21);
 
     // Contador principal
     ofSetColor(255, 255, 255);
-    scoreFont.drawString(countdown, countdownX, projROI.height - 22);
+    hud.drawString(scoreFont, countdown, countdownX, projROI.height - 22);
 
     ofPopStyle();
 
@@ -862,41 +805,14 @@ void CFeedingGameController::drawVictoryScreen()
     ofPushStyle();
 
     // Confete
-    for (const auto& p : confettiParticles) {
-        ofPushMatrix();
-        ofTranslate(p.position);
-        ofRotate(p.rotation);
-
-        if (confettiImage.isAllocated()) {
-            ofSetColor(p.color);
-            confettiImage.draw(-p.size / 2, -p.size / 2, p.size, p.size);
-        }
-        else {
-            // Fallback: quadrado colorido
-            ofSetColor(p.color, 200);
-            ofDrawRectangle(-p.size / 2, -p.size / 2, p.size, p.size);
-        }
-
-        ofPopMatrix();
-    }
+    confettiParticles.draw(confettiImage, 1, 200.0 / 255);
 
     // Estrelas
-    for (const auto& star : starEffects) {
-        if (starsImage.isAllocated()) {
-            ofSetColor(255, 255, 255, star.alpha * 0.8);
-            starsImage.draw(star.position - ofVec2f(star.size / 2, star.size / 2),
-                star.size, star.size);
-        }
-        else {
-            // Fallback: círculo amarelo
-            ofSetColor(255, 255, 0, star.alpha * 0.8);
-            ofDrawCircle(star.position, star.size / 2);
-        }
-    }
+    starEffects.draw(starsImage, 0.8, 0.8);
 
     // Fogos de artifício animados
     if (fireworksImage.isAllocated()) {
-        float time = ofGetElapsedTimef();
+        float time = FrameClock::getElapsedTimef();
         for (int i = 0; i < 5; i++) {
             float x = 100 + i * 200;
             float y = 80 + 50 * sin(time * 2 + i); // Movimento vertical
@@ -929,18 +845,18 @@ void CFeedingGameController::drawVictoryScreen()
 
     // Título com efeito de pulso
     string title = "EXCELENTE!";
-    float titleW = gameFont.stringWidth(title);
+    float titleW = hud.stringWidth(gameFont, title);
     float titleX = (projROI.width - titleW) / 2;
 
-    float pulse = 0.5 + 0.5 * sin(ofGetElapsedTimef() * 3); // Valor oscilante 0-1
+    float pulse = 0.5 + 0.5 * sin(FrameClock::getElapsedTimef() * 3); // Valor oscilante 0-1
 
     // Sombra para melhor legibilidade
     ofSetColor(0, 0, 0, 220);
-    gameFont.drawString(title, titleX + 3, textBoxY + 3);
+    hud.drawString(gameFont, title, titleX + 3, textBoxY + 3);
 
     // Título principal com efeito de pulso amarelo (tema comida)
     ofSetColor(255, 255 * pulse, 0);
-    gameFont.drawString(title, titleX, textBoxY);
+    hud.drawString(gameFont, title, titleX, textBoxY);
 
     // Linha decorativa
     ofSetColor(255, 200, 0, 100);
@@ -949,16 +865,16 @@ void CFeedingGameController::drawVictoryScreen()
 
     // Mensagem de conclusão
     string completed = "Todas as " + ofToString(maxLevels) + " fases finalizadas!";
-    float completedW = scoreFont.stringWidth(completed);
+    float completedW = hud.stringWidth(scoreFont, completed);
     float completedX = (projROI.width - completedW) / 2;
 
     // Sombra
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(completed, completedX + 2, textBoxY + 72);
+    hud.drawString(scoreFont, completed, completedX + 2, textBoxY + 72);
 
     // Texto principal
     ofSetColor(255, 255, 200);
-    scoreFont.drawString(completed, completedX, textBoxY + 70);
+    hud.drawString(scoreFont, completed, completedX, textBoxY + 70);
 
     ofPopStyle();
 
@@ -966,18 +882,18 @@ void CFeedingGameController::drawVictoryScreen()
     ofPushStyle();
 
     // Calcula e desenha contador
-    float timeLeft = resultsDisplayTime - (ofGetElapsedTimef() - resultsStartTime);
+    float timeLeft = resultsDisplayTime - (FrameClock::getElapsedTimef() - resultsStartTime);
     string countdown = "Fim de jogo em: " + ofToString((int)timeLeft) + "s";
-    float countdownW = scoreFont.stringWidth(countdown);
+    float countdownW = hud.stringWidth(scoreFont, countdown);
     float countdownX = (projROI.width - countdownW) / 2;
 
     // Sombra do contador
     ofSetColor(0, 0, 0, 220);
-    scoreFont.drawString(countdown, countdownX + 1, projROI.height - 21);
+    hud.drawString(scoreFont, countdown, countdownX + 1, projROI.height - 21);
 
     // Contador principal
     ofSetColor(255, 255, 255);
-    scoreFont.drawString(countdown, countdownX, projROI.height - 22);
+    hud.drawString(scoreFont, countdown, countdownX, projROI.height - 22);
 
     ofPopStyle();
 
@@ -992,36 +908,36 @@ void CFeedingGameController::drawTryAgainScreen()
 
     // Título centralizado
     string title = "GAME OVER";
-    float titleW = gameFont.stringWidth(title);
+    float titleW = hud.stringWidth(gameFont, title);
     float titleX = (projROI.width - titleW) / 2;
 
     ofSetColor(255, 100, 100); // Vermelho claro
-    gameFont.drawString(title, titleX, 150);
+    hud.drawString(gameFont, title, titleX, 150);
 
     // Mensagem da fase centralizada
     string levelFailed = "Fase " + ofToString(currentLevel) + " Fracassada!";
-    float levelFailedW = scoreFont.stringWidth(levelFailed);
+    float levelFailedW = hud.stringWidth(scoreFont, levelFailed);
     float levelFailedX = (projROI.width - levelFailedW) / 2;
 
     ofSetColor(255, 255, 255); // Branco
-    scoreFont.drawString(levelFailed, levelFailedX, 250);
+    hud.drawString(scoreFont, levelFailed, levelFailedX, 250);
 
     // Mensagem motivacional
     string motivation = "Vamos Iniciar Novamente!";
-    float motivationW = scoreFont.stringWidth(motivation);
+    float motivationW = hud.stringWidth(scoreFont, motivation);
     float motivationX = (projROI.width - motivationW) / 2;
 
     ofSetColor(255, 255, 0); // Amarelo
-    scoreFont.drawString(motivation, motivationX, 350);
+    hud.drawString(scoreFont, motivation, motivationX, 350);
 
     // Contador centralizado
-    float timeLeft = resultsDisplayTime - (ofGetElapsedTimef() - resultsStartTime);
+    float timeLeft = resultsDisplayTime - (FrameClock::getElapsedTimef() - resultsStartTime);
     string countdown = "Fim de jogo em: " + ofToString((int)timeLeft) + "s";
-    float countdownW = scoreFont.stringWidth(countdown);
+    float countdownW = hud.stringWidth(scoreFont, countdown);
     float countdownX = (projROI.width - countdownW) / 2;
 
     ofSetColor(255, 255, 255, 150); // Branco semi-transparente
-    scoreFont.drawString(countdown, countdownX, projROI.height - 50);
+    hud.drawString(scoreFont, countdown, countdownX, projROI.height - 50);
 
     fboGame.end();
 }
@@ -1083,7 +999,7 @@ bool CFeedingGameController::StartGame()
     if (currentState != STATE_IDLE) return false;
 
     currentState = STATE_INTRO;
-    introStartTime = ofGetElapsedTimef();
+    introStartTime = FrameClock::getElapsedTimef();
 
     // RESETA SISTEMA DE NÍVEIS
     currentLevel = 1;
@@ -1101,6 +1017,16 @@ bool CFeedingGameController::isIdle()
     return currentState == STATE_IDLE;
 }
 
+bool CFeedingGameController::isProjectorLayerActive()
+{
+    return currentState != STATE_IDLE;
+}
+
+unsigned int CFeedingGameController::getProjectorLayerVersion()
+{
+    return projectorLayerVersion;
+}
+
 bool CFeedingGameController::isInIntro()
 {
     return currentState == STATE_INTRO;
@@ -1111,7 +1037,7 @@ void CFeedingGameController::startFromIntro()
     // Transição do estado INTRO para PLAYING
     if (currentState == STATE_INTRO) {
         currentState = STATE_PLAYING;
-        gameStartTime = ofGetElapsedTimef();
+        gameStartTime = FrameClock::getElapsedTimef();
         levelStartTime = gameStartTime;
         lastFoodSpawnTime = gameStartTime;
         spawnInitialFish(); // Cria peixes iniciais
@@ -1194,6 +1120,8 @@ bool CFeedingGameController::setRandomFishLocation(ofVec2f &location)
         count++;
         float x = ofRandom(fishROI.getLeft(), fishROI.getRight());
         float y = ofRandom(fishROI.getTop(), fishROI.getBottom());
+        // Ignora posições fora da área de areia (paredes da caixa)
+        if (!kinectProjector->isInsideKinectROI(x, y)) continue;
         bool insideWater = kinectProjector->elevationAtKinectCoord(x, y) < 0;
         
         if (insideWater) {
@@ -1222,6 +1150,8 @@ bool CFeedingGameController::setRandomFoodLocation(ofVec2f &location)
         count++;
         float x = ofRandom(foodROI.getLeft(), foodROI.getRight());
         float y = ofRandom(foodROI.getTop(), foodROI.getBottom());
+        // Ignora posições fora da área de areia (paredes da caixa)
+        if (!kinectProjector->isInsideKinectROI(x, y)) continue;
         bool insideWater = kinectProjector->elevationAtKinectCoord(x, y) < 0;
         
         if (insideWater) {
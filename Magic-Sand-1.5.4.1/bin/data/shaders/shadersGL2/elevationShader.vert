@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #version 120
 
 varying float depthfrag;
+varying float insideMask; // Always inside: the CPU mesh only has triangles in the sand area
 
 uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture
 uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
@@ -36,6 +37,8 @@ uniform vec4 basePlaneEq; // Base plane equation
 
 void main()
 {
+    insideMask = 1.0;
+
     vec4 position = gl_Vertex;
     vec2 texcoord = gl_MultiTexCoord0.xy;
     // copy position so we can work with it.
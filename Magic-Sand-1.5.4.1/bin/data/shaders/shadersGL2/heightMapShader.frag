@@ -25,18 +25,35 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #version 120
 
 varying float depthfrag;
+varying float elevationfrag;
+varying float insideMask; // Interpolated sand area mask, below 1 on triangles touching the sandbox walls
 
 uniform sampler2DRect heightColorMapSampler;
 uniform sampler2DRect pixelCornerElevationSampler; // Sampler for the half pixel texture
 uniform float contourLineFactor;
 uniform int drawContourLines;
+uniform int singlePassContourLines; // Find the contour lines from the elevation derivatives instead of the half pixel texture
+uniform vec2 contourLineFboTransformation; // Transformation from elevation to normalized contourline fbo unit factor and offset
 
 void main()
 {
+    if (insideMask < 0.999)
+        discard;
+
     vec2 depthPos = vec2(depthfrag, 0.5);//depthvalue*texsize, 0.5);
     vec4 color =  texture2DRect(heightColorMapSampler, depthPos);	//colormap converted depth
 
-    if (drawContourLines == 1)
+    if (drawContourLines == 1 && singlePassContourLines == 1)
+    {
+        /* Contour line interval at the pixel center and its variation to the pixel corners from the screen-space derivatives: */
+        float contour=(elevationfrag-contourLineFboTransformation.y)/contourLineFboTransformation.x*contourLineFactor;
+        float halfSpan=0.5*(abs(dFdx(contour))+abs(dFdy(contour)));
+
+        /* The pixel is colored as a topographic contour line if a contour line crosses it: */
+        if(floor(contour-halfSpan)!=floor(contour+halfSpan))
+            color=vec4(0.0,0.0,0.0,1.0);
+    }
+    else if (drawContourLines == 1)
     {
         // Contour line computation
         /* Calculate the contour line interval containing each pixel corner by evaluating the half-pixel offset elevation texture: */
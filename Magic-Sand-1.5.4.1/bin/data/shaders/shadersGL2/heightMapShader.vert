@@ -25,6 +25,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #version 120
 
 varying float depthfrag;
+varying float elevationfrag; // Elevation for the single pass contour lines
+varying float insideMask; // Always inside: the CPU mesh only has triangles in the sand area
 
 uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture automatically set by binding
 
@@ -36,6 +38,8 @@ uniform vec4 basePlaneEq; // Base plane equation
 
 void main()
 {
+    insideMask = 1.0;
+
     vec4 position =gl_Vertex;
     vec2 texcoord = gl_MultiTexCoord0.xy;
     // copy position so we can work with it.
@@ -57,6 +61,7 @@ void main()
     /* Transform elevation to height color map texture coordinate: */
     float elevation = dot(basePlaneEq,vertexCcx);///vertexCc.w;
     depthfrag = elevation*heightColorMapTransformation.x+heightColorMapTransformation.y;
+    elevationfrag = elevation;
     
     /* Transform vertex to proj coordinates: */
     vec4 screenPos = kinectProjMatrix * vertexCcx;
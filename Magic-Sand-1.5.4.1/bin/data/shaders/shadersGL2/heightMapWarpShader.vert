@@ -0,0 +1,31 @@
+/***********************************************************************
+heightMapWarpShader - Shader vertex drawing the projector window quad
+for the projector space sand renderer.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 120
+
+varying vec2 projPos;
+
+void main()
+{
+    projPos = gl_Vertex.xy; // The quad vertices are in projector pixels
+	gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
@@ -0,0 +1,60 @@
+/***********************************************************************
+waterFluxShader - Shader fragment computing the outflows of
+each water cell through the virtual pipes to its four neighbours.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 120
+
+uniform sampler2DRect waterSampler; // r: water depth (mm), g: terrain elevation (mm)
+uniform sampler2DRect fluxSampler; // Outflows to the left, right, lower and upper cells (mm3/s)
+uniform vec2 gridRes; // Number of water cells
+uniform float timeStep; // Simulation time step (s)
+uniform float pipeFactor; // Gravity times cell length (mm2/s2)
+uniform float cellArea; // Cell area (mm2)
+uniform float fluxDamping; // Fraction of the flux kept from the previous step
+
+/* Water surface elevation of a neighbour cell, out of the grid cells never receive water: */
+float surfaceAt(vec2 cell)
+{
+    if (cell.x < 0.0 || cell.y < 0.0 || cell.x > gridRes.x || cell.y > gridRes.y)
+        return 1.0e9;
+    vec4 state = texture2DRect(waterSampler, cell);
+    return state.r + state.g;
+}
+
+void main()
+{
+    vec2 cell = gl_FragCoord.xy;
+    vec4 state = texture2DRect(waterSampler, cell);
+    float surface = state.r + state.g;
+
+    /* Accelerate the flow in each pipe by the difference of water surface elevation: */
+    vec4 neighbourSurface = vec4(surfaceAt(cell + vec2(-1.0, 0.0)), surfaceAt(cell + vec2(1.0, 0.0)),
+                                 surfaceAt(cell + vec2(0.0, -1.0)), surfaceAt(cell + vec2(0.0, 1.0)));
+    vec4 flux = max(vec4(0.0), texture2DRect(fluxSampler, cell) * fluxDamping + timeStep * pipeFactor * (surface - neighbourSurface));
+
+    /* A cell cannot give more water than it holds: */
+    float outflow = (flux.r + flux.g + flux.b + flux.a) * timeStep;
+    float volume = state.r * cellArea;
+    if (outflow > volume)
+        flux *= volume / outflow;
+
+	gl_FragColor = flux;
+}
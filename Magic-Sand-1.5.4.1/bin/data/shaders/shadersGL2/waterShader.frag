@@ -0,0 +1,37 @@
+/***********************************************************************
+waterShader - Shader fragment coloring the water with its depth.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 120
+
+varying float waterDepth;
+varying float insideMask;
+
+uniform float minWaterDepth; // Thinner water films are not drawn (mm)
+uniform float deepWaterDepth; // Depth at which the water gets its darkest color (mm)
+
+void main()
+{
+    if (insideMask < 0.999 || waterDepth < minWaterDepth)
+        discard;
+
+    float deep = clamp(waterDepth / deepWaterDepth, 0.0, 1.0);
+	gl_FragColor = vec4(mix(vec3(0.35, 0.7, 1.0), vec3(0.0, 0.15, 0.6), deep), mix(0.5, 0.85, deep));
+}
@@ -0,0 +1,87 @@
+/***********************************************************************
+waterUpdateShader - Shader fragment updating the water depth of
+each water cell from the pipe flows, the rain and the drain.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 120
+
+uniform sampler2DRect waterSampler; // r: water depth (mm), g: terrain elevation (mm)
+uniform sampler2DRect fluxSampler; // Outflows to the left, right, lower and upper cells (mm3/s)
+uniform sampler2DRect depthSampler; // Filtered kinect depth
+uniform sampler2DRect kinectROIMaskSampler; // Sand area mask: 1 inside the sand polygon, 0 outside
+
+uniform vec2 gridOrigin; // Kinect image position of the water grid (ROI corner)
+uniform float cellSize; // Kinect pixels per water cell
+uniform vec2 gridRes; // Number of water cells
+uniform float timeStep; // Simulation time step (s)
+uniform float cellArea; // Cell area (mm2)
+
+uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
+uniform mat4 kinectWorldMatrix; // Transformation from kinect image space to kinect world space
+uniform vec4 basePlaneEq; // Base plane equation
+
+uniform float rainRate; // Rain falling on the whole sand (mm/s)
+uniform float handRainRate; // Rain falling under the hands and objects held above the sand (mm/s)
+uniform float handRainElevation; // Elevation above which the kinect sees a hand instead of sand (mm)
+uniform float drainRate; // Water absorbed by the sand (mm/s)
+
+/* Elevation above the base plane of the sand under the center of the water cell: */
+float terrainElevation(vec2 kinectPos)
+{
+    float depth = texture2DRect(depthSampler, kinectPos).r * depthTransformation.x + depthTransformation.y;
+    vec4 vertexCc = kinectWorldMatrix * vec4(kinectPos - vec2(0.5, 0.5), depth, 1.0);  // Transposed multiplication (Row-major order VS col major order
+    vec4 vertexCcx = vertexCc * depth;
+    vertexCcx.w = 1.0;
+    return dot(basePlaneEq, vertexCcx);
+}
+
+void main()
+{
+    vec2 cell = gl_FragCoord.xy;
+    vec2 kinectPos = gridOrigin + cell * cellSize;
+    if (texture2DRect(kinectROIMaskSampler, kinectPos).r < 0.5)
+    {
+        gl_FragColor = vec4(0.0, 1.0e4, 0.0, 1.0); // Sandbox walls: high and dry
+        return;
+    }
+    float terrain = terrainElevation(kinectPos);
+
+    /* Net volume received through the pipes, the neighbours outside the grid give nothing: */
+    vec4 flux = texture2DRect(fluxSampler, cell);
+    float inflow = 0.0;
+    if (cell.x > 1.0)
+        inflow += texture2DRect(fluxSampler, cell + vec2(-1.0, 0.0)).g;
+    if (cell.x < gridRes.x - 1.0)
+        inflow += texture2DRect(fluxSampler, cell + vec2(1.0, 0.0)).r;
+    if (cell.y > 1.0)
+        inflow += texture2DRect(fluxSampler, cell + vec2(0.0, -1.0)).a;
+    if (cell.y < gridRes.y - 1.0)
+        inflow += texture2DRect(fluxSampler, cell + vec2(0.0, 1.0)).b;
+    float outflow = flux.r + flux.g + flux.b + flux.a;
+    float water = texture2DRect(waterSampler, cell).r + timeStep * (inflow - outflow) / cellArea;
+
+    /* Rain and drain: */
+    water += timeStep * rainRate;
+    if (terrain > handRainElevation)
+        water += timeStep * handRainRate;
+    water = max(0.0, water - timeStep * drainRate);
+
+	gl_FragColor = vec4(water, terrain, 0.0, 1.0);
+}
@@ -0,0 +1,110 @@
+/***********************************************************************
+elevationGridShader - Shader vertex generating the sand surface grid
+from an instanced triangle strip and computing elevation and vertex
+location for the contour line framebuffer.
+Copyright (c) 2025 GlT-Ricardo
+
+-- adapted from SurfaceRenderer by Oliver Kreylos
+Copyright (c) 2012-2015 Oliver Kreylos
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 150
+
+// these are for the programmable pipeline system and are passed in
+// by default from OpenFrameworks
+uniform mat4 modelViewMatrix;
+uniform mat4 projectionMatrix;
+uniform mat4 textureMatrix;
+uniform mat4 modelViewProjectionMatrix;
+
+in vec4 position;
+in vec4 color;
+in vec4 normal;
+in vec2 texcoord;
+// this is the end of the default functionality
+
+// this is something send to the fragment shader
+out float depthfrag;
+out float insideMask;
+
+uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture
+uniform sampler2DRect kinectROIMaskSampler; // Sand area mask: 1 inside the sand polygon, 0 outside
+uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
+uniform vec2 contourLineFboTransformation; // Transformation from elevation to normalized contourline fbo unit factor and offset
+
+uniform vec2 gridOrigin; // Kinect image position of the first grid vertex (ROI or terrain patch corner)
+uniform vec2 gridSize; // Index of the last grid column and number of grid rows
+uniform float gridStep; // Kinect pixels between two grid vertices (decimation factor)
+uniform vec2 gridEnd; // Kinect image position of the last grid vertex
+uniform vec4 edgeStep; // Vertex spacing on the left, right, top and bottom grid borders (coarser on borders shared with coarser patches)
+
+uniform mat4 kinectWorldMatrix; // Transformation from kinect image space to kinect world space
+uniform mat4 kinectProjMatrix; // Transformation from kinect world space to proj image space
+uniform vec4 basePlaneEq; // Base plane equation
+
+void main()
+{
+    /* Generate the grid vertex: the strip gives the column and the row offset, the instance gives the row: */
+    vec2 cell = vec2(min(position.x, gridSize.x), position.y + float(gl_InstanceID));
+    vec2 kinectPos = min(gridOrigin + cell * gridStep, gridEnd);
+
+    /* Snap the border vertices onto the vertices of coarser neighbour patches so the patches join without cracks: */
+    if (kinectPos.x == gridOrigin.x || kinectPos.x == gridEnd.x)
+    {
+        float borderStep = (kinectPos.x == gridOrigin.x) ? edgeStep.x : edgeStep.y;
+        if (kinectPos.y < gridEnd.y)
+            kinectPos.y = gridOrigin.y + floor((kinectPos.y - gridOrigin.y) / borderStep) * borderStep;
+    }
+    if (kinectPos.y == gridOrigin.y || kinectPos.y == gridEnd.y)
+    {
+        float borderStep = (kinectPos.y == gridOrigin.y) ? edgeStep.z : edgeStep.w;
+        if (kinectPos.x < gridEnd.x)
+            kinectPos.x = gridOrigin.x + floor((kinectPos.x - gridOrigin.x) / borderStep) * borderStep;
+    }
+    insideMask = texture(kinectROIMaskSampler, kinectPos + vec2(0.5, 0.5)).r;
+
+    vec4 pos = vec4(kinectPos - vec2(0.5, 0.5), 0.0, 1.0);
+    vec2 varyingtexcoord = pos.xy;
+
+    /* Set the vertex' depth image-space z coordinate from the texture: */
+    vec4 texel0 = texture(tex0, varyingtexcoord);
+    float depth1 = texel0.r;
+    float depth = depth1 * depthTransformation.x + depthTransformation.y;
+
+    pos.z = depth;
+    pos.w = 1;
+
+    /* Transform the vertex from depth image space to world space: */
+    vec4 vertexCc = kinectWorldMatrix * pos;  // Transposed multiplication (Row-major order VS col major order
+    vec4 vertexCcx = vertexCc * depth;
+    vertexCcx.w = 1;
+
+    /* Take into account baseplane orientation and location: */
+    float elevation = dot(basePlaneEq,vertexCcx);
+    depthfrag = (elevation-contourLineFboTransformation.y)/contourLineFboTransformation.x;
+
+    /* Transform vertex to proj coordinates: */
+    vec4 screenPos = kinectProjMatrix * vertexCcx;
+    vec4 projectedPoint = screenPos / screenPos.z;
+
+    projectedPoint.z = 0;
+    projectedPoint.w = 1;
+
+	gl_Position = modelViewProjectionMatrix * projectedPoint;
+}
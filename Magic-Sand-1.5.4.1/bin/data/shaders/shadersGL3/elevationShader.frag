@@ -25,9 +25,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 out vec4 outputColor;
 
 in float depthfrag;
+in float insideMask; // Interpolated sand area mask, below 1 on triangles touching the sandbox walls
 
 void main()
 {
+    if (insideMask < 0.999)
+        discard;
+
     outputColor = vec4(depthfrag, 0.0, 0.0, 1.0); // Write the elevation directly into the frame buffer
 }
 
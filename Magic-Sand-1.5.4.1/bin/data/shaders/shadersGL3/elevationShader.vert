@@ -40,6 +40,7 @@ in vec2 texcoord;
 // this is something we're creating for this shader
 out vec2 varyingtexcoord;
 out float depthfrag;
+out float insideMask; // Always inside: the CPU mesh only has triangles in the sand area
 
 uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture
 uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
@@ -51,6 +52,8 @@ uniform vec4 basePlaneEq; // Base plane equation
 
 void main()
 {
+    insideMask = 1.0;
+
     // copy position so we can work with it.
     vec4 pos = position;
     varyingtexcoord = pos.xy;//texcoord;
@@ -0,0 +1,86 @@
+/***********************************************************************
+gradientFieldShader - Shader fragment computing the sand gradient,
+slope and land mask of each kinect pixel for the simulation.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 150
+
+out vec4 outputColor;
+
+uniform sampler2DRect depthSampler; // Filtered kinect depth
+uniform sampler2DRect kinectROIMaskSampler; // Sand area mask: 1 inside the sand polygon, 0 outside
+
+uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
+uniform mat4 kinectWorldMatrix; // Transformation from kinect image space to kinect world space
+uniform vec4 basePlaneEq; // Base plane equation
+uniform float gradientSpan; // Kinect pixels between the pixel and the depth samples of the finite differences
+
+float depthAt(vec2 kinectPos)
+{
+    return texture(depthSampler, kinectPos).r * depthTransformation.x + depthTransformation.y;
+}
+
+/* Depth samples on the sandbox walls or in the holes of the depth frame (depth 0) are not used: */
+bool isValidSample(vec2 kinectPos, float depth)
+{
+    return depth > 0.0 && texture(kinectROIMaskSampler, kinectPos).r >= 0.5;
+}
+
+/* Depth difference per pixel along d, towards the rising sand. One sided next to an invalid
+   sample, zero when both samples are invalid: */
+float depthSlope(vec2 kinectPos, vec2 d, float depth)
+{
+    float before = depthAt(kinectPos - d);
+    float after = depthAt(kinectPos + d);
+    bool beforeValid = isValidSample(kinectPos - d, before);
+    bool afterValid = isValidSample(kinectPos + d, after);
+    if (beforeValid && afterValid)
+        return (before - after) / (2.0 * gradientSpan);
+    if (beforeValid)
+        return (before - depth) / gradientSpan;
+    if (afterValid)
+        return (depth - after) / gradientSpan;
+    return 0.0;
+}
+
+void main()
+{
+    /* The framebuffer has the kinect resolution: the fragment is the kinect pixel: */
+    vec2 kinectPos = gl_FragCoord.xy;
+    float depth = depthAt(kinectPos);
+    if (!isValidSample(kinectPos, depth))
+    {
+        outputColor = vec4(0.0); // Sandbox walls and holes: flat and dry
+        return;
+    }
+
+    /* Land where the sand is above the base plane: */
+    vec4 vertexCc = kinectWorldMatrix * vec4(kinectPos - vec2(0.5, 0.5), depth, 1.0);  // Transposed multiplication (Row-major order VS col major order
+    vec4 vertexCcx = vertexCc * depth;
+    vertexCcx.w = 1.0;
+    float land = dot(basePlaneEq, vertexCcx) > 0.0 ? 1.0 : 0.0;
+
+    /* Central differences of the depth, oriented like the CPU gradient field (towards the rising sand): */
+    vec2 dx = vec2(gradientSpan, 0.0);
+    vec2 dy = vec2(0.0, gradientSpan);
+    vec2 gradient = vec2(depthSlope(kinectPos, dx, depth), depthSlope(kinectPos, dy, depth));
+
+	outputColor = vec4(gradient, length(gradient), land);
+}
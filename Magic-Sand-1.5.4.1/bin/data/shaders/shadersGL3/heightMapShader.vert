@@ -39,6 +39,8 @@ in vec2 texcoord;
 
 // this is something send to the fragment shader
 out float depthfrag;
+out float elevationfrag; // Elevation for the single pass contour lines
+out float insideMask; // Always inside: the CPU mesh only has triangles in the sand area
 
 uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture automatically set by binding
 
@@ -50,6 +52,8 @@ uniform vec4 basePlaneEq; // Base plane equation
 
 void main()
 {
+    insideMask = 1.0;
+
     // copy position so we can work with it.
     vec4 pos = position;
 //    varyingtexcoord = pos.xy;//texcoord;
@@ -70,6 +74,7 @@ void main()
     /* Transform elevation to height color map texture coordinate: */
     float elevation = dot(basePlaneEq,vertexCcx);///vertexCc.w;
     depthfrag = elevation*heightColorMapTransformation.x+heightColorMapTransformation.y;
+    elevationfrag = elevation;
     
     /* Transform vertex to proj coordinates: */
     vec4 screenPos = kinectProjMatrix * vertexCcx;
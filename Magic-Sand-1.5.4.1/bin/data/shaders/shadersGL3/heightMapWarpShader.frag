@@ -0,0 +1,99 @@
+/***********************************************************************
+heightMapWarpShader - Shader fragment finding the sand seen by each
+projector pixel through the projector to kinect warp and computing its
+elevation color and contour lines.
+Copyright (c) 2025 GlT-Ricardo
+
+-- adapted from SurfaceRenderer by Oliver Kreylos
+Copyright (c) 2012-2015 Oliver Kreylos
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 150
+
+out vec4 outputColor;
+
+in vec2 projPos;
+
+const int maxRefinementSteps = 8; // Iterations moving the sample along the projector ray onto the sand surface
+const float depthTolerance = 1.0; // The iterations stop once the depth moves less than this (mm)
+
+uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture automatically set by binding
+uniform sampler2DRect projToKinectSampler; // Kinect pixel seen at depth z: xy + zw / z, one texel every warpMapStep projector pixels
+uniform sampler2DRect seaLevelInvDepthSampler; // 1 / depth of the base plane along the projector ray, same layout
+uniform sampler2DRect kinectROIMaskSampler; // Sand area mask: 1 inside the sand polygon, 0 outside
+uniform sampler2DRect heightColorMapSampler;
+
+uniform mat4 kinectWorldMatrix; // Transformation from kinect image space to kinect world space
+uniform vec2 heightColorMapTransformation; // Transformation from elevation to height color map texture coordinate factor and offset
+uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
+uniform vec4 basePlaneEq; // Base plane equation
+uniform vec2 contourLineFboTransformation; // Transformation from elevation to normalized contourline fbo unit factor and offset
+uniform float contourLineFactor;
+uniform int drawContourLines;
+uniform float warpMapStep; // Projector pixels between two texels of the warp textures
+
+void main()
+{
+    /* Texel i of the warp textures is projector pixel i * warpMapStep, the linear filtering interpolates in between: */
+    vec2 warpPos = (projPos - vec2(0.5, 0.5)) / warpMapStep + vec2(0.5, 0.5);
+    vec4 warp = texture(projToKinectSampler, warpPos);
+    float invDepth = texture(seaLevelInvDepthSampler, warpPos).r;
+    if (invDepth <= 0.0)
+        discard; // The projector ray does not meet the base plane
+
+    /* Start from the base plane and move along the projector ray to the depth of the sand seen by the kinect: */
+    vec2 kinectPos = warp.xy + warp.zw * invDepth;
+    float depth = 1.0 / invDepth;
+    for (int i = 0; i < maxRefinementSteps; i++)
+    {
+        float newDepth = texture(tex0, kinectPos + vec2(0.5, 0.5)).r * depthTransformation.x + depthTransformation.y;
+        if (newDepth <= 0.0)
+            break; // No depth measured there: keep the last sample
+        kinectPos = warp.xy + warp.zw / newDepth;
+        bool converged = abs(newDepth - depth) < depthTolerance;
+        depth = newDepth;
+        if (converged)
+            break;
+    }
+    if (texture(kinectROIMaskSampler, kinectPos + vec2(0.5, 0.5)).r < 0.5)
+        discard; // Sandbox walls
+
+    /* Transform the sample from depth image space to world space: */
+    vec4 vertexCc = kinectWorldMatrix * vec4(kinectPos, depth, 1.0);  // Transposed multiplication (Row-major order VS col major order
+    vec4 vertexCcx = vertexCc * depth;
+    vertexCcx.w = 1;
+
+    /* Transform elevation to height color map texture coordinate: */
+    float elevation = dot(basePlaneEq,vertexCcx);
+    vec2 depthPos = vec2(elevation*heightColorMapTransformation.x+heightColorMapTransformation.y, 0.5);
+    vec4 color = texture(heightColorMapSampler, depthPos);
+
+    if (drawContourLines == 1)
+    {
+        /* Contour line interval at the pixel center and its variation to the pixel corners from the screen-space derivatives: */
+        float contour=(elevation-contourLineFboTransformation.y)/contourLineFboTransformation.x*contourLineFactor;
+        float halfSpan=0.5*(abs(dFdx(contour))+abs(dFdy(contour)));
+
+        /* The pixel is colored as a topographic contour line if a contour line crosses it: */
+        if(floor(contour-halfSpan)!=floor(contour+halfSpan))
+            color=vec4(0.0,0.0,0.0,1.0);
+    }
+
+    outputColor = color;
+}
@@ -0,0 +1,79 @@
+/***********************************************************************
+vehicleShader - Shader vertex placing the template of a vehicle
+species for each instance.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+
+
+#version 150
+
+// these are for the programmable pipeline system and are passed in
+// by default from OpenFrameworks
+uniform mat4 modelViewMatrix;
+uniform mat4 projectionMatrix;
+uniform mat4 textureMatrix;
+uniform mat4 modelViewProjectionMatrix;
+
+in vec4 position;
+in vec4 color;
+in vec4 normal;
+in vec2 texcoord;
+// this is the end of the default functionality
+
+// Per instance attributes (see VehicleInstance)
+in vec4 instanceTransform; // Projector x, y, angle (rad), size
+in vec4 instanceShape; // Tail angle (rad), detail filled
+in vec4 instanceBodyColor;
+in vec4 instanceDetailColor;
+
+uniform float tailRoot; // x of the tail joint in the template
+
+out vec4 vertexColor;
+out float ringDistance; // Pixels to the rim of the outlined discs
+out float ringFlag; // 1 when the disc is outlined
+
+vec2 rotate(vec2 v, float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return vec2(c * v.x - s * v.y, s * v.x + c * v.y);
+}
+
+void main()
+{
+    /* The tail swings around its joint, its offsets with it: */
+    vec2 p = position.xy;
+    vec2 offset = normal.xy;
+    if (position.z > 0.5)
+    {
+        vec2 root = vec2(tailRoot, 0.0);
+        p = root + rotate(p - root, -instanceShape.x);
+        offset = rotate(offset, -instanceShape.x);
+    }
+
+    /* Scale, rotate and place the template, the offsets are in pixels: */
+    vec2 local = p * instanceTransform.w + offset;
+    vec2 projectorPos = instanceTransform.xy + rotate(local, instanceTransform.z);
+
+    vertexColor = mix(instanceBodyColor, instanceDetailColor, normal.z);
+    ringDistance = (texcoord.y - texcoord.x) * instanceTransform.w;
+    ringFlag = (texcoord.y > 0.0 && instanceShape.y < 0.5) ? 1.0 : 0.0;
+    gl_Position = modelViewProjectionMatrix * vec4(projectorPos, 0.0, 1.0);
+}
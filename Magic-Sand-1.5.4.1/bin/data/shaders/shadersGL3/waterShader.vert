@@ -0,0 +1,80 @@
+/***********************************************************************
+waterShader - Shader vertex generating the water grid from an
+instanced triangle strip and projecting the water depth on the sand.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#version 150
+
+// these are for the programmable pipeline system and are passed in
+// by default from OpenFrameworks
+uniform mat4 modelViewMatrix;
+uniform mat4 projectionMatrix;
+uniform mat4 textureMatrix;
+uniform mat4 modelViewProjectionMatrix;
+
+in vec4 position;
+in vec4 color;
+in vec4 normal;
+in vec2 texcoord;
+// this is the end of the default functionality
+
+out float waterDepth;
+out float insideMask;
+
+uniform sampler2DRect tex0; // Sampler for the depth image-space elevation texture automatically set by binding
+uniform sampler2DRect kinectROIMaskSampler; // Sand area mask: 1 inside the sand polygon, 0 outside
+uniform sampler2DRect waterSampler; // r: water depth (mm) of the water cells
+
+uniform vec2 gridOrigin; // Kinect image position of the first grid vertex (ROI corner)
+uniform vec2 gridSize; // Index of the last grid column and number of grid rows
+uniform float gridStep; // Kinect pixels between two grid vertices (water cell size)
+uniform vec2 gridEnd; // Kinect image position of the last grid vertex
+
+uniform mat4 kinectProjMatrix; // Transformation from kinect world space to proj image space
+uniform mat4 kinectWorldMatrix; // Transformation from kinect image space to kinect world space
+uniform vec2 depthTransformation; // Normalisation factor and offset applied by openframeworks
+
+void main()
+{
+    /* Generate the grid vertex: the strip gives the column and the row offset, the instance gives the row: */
+    vec2 cell = vec2(min(position.x, gridSize.x), position.y + float(gl_InstanceID));
+    vec2 kinectPos = min(gridOrigin + cell * gridStep, gridEnd);
+    insideMask = texture(kinectROIMaskSampler, kinectPos + vec2(0.5, 0.5)).r;
+    waterDepth = texture(waterSampler, (kinectPos - gridOrigin) / gridStep).r;
+
+    /* Set the vertex' depth image-space z coordinate from the texture: */
+    vec4 pos = vec4(kinectPos - vec2(0.5, 0.5), 0.0, 1.0);
+    float depth = texture(tex0, pos.xy).r * depthTransformation.x + depthTransformation.y;
+    pos.z = depth;
+
+    /* Transform the vertex from depth image space to world space: */
+    vec4 vertexCc = kinectWorldMatrix * pos;  // Transposed multiplication (Row-major order VS col major order
+    vec4 vertexCcx = vertexCc * depth;
+    vertexCcx.w = 1.0;
+
+    /* Transform vertex to proj coordinates: */
+    vec4 screenPos = kinectProjMatrix * vertexCcx;
+    vec4 projectedPoint = screenPos / screenPos.z;
+
+    projectedPoint.z = 0.0;
+    projectedPoint.w = 1.0;
+
+	gl_Position = modelViewProjectionMatrix * projectedPoint;
+}
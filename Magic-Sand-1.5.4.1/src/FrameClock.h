@@ -0,0 +1,42 @@
+/***********************************************************************
+FrameClock - Application time of the animations and timers, taken from
+the wall clock or advanced by a fixed step for the offscreen runs.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+
+//! Replacement of ofGetElapsedTimef and ofGetLastFrameTime for everything that changes the images
+/** By default it follows the wall clock. After setFixedStep each tick() advances the time by the
+    step, so an offscreen run gives the same images whatever the speed of the machine */
+class FrameClock {
+public:
+    static void setFixedStep(double step);
+    // To be called once per frame, at the start of the application update
+    static void tick();
+
+    static float getElapsedTimef();
+    static double getLastFrameTime();
+
+private:
+    static bool fixed;
+    static double fixedStep;
+    static double elapsed;
+};
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 
 #include "BoidGameController.h"
+#include "../FrameClock.h"
 
 #include <string>
 //#include <direct.h>
@@ -42,9 +43,10 @@ CBoidGameController::CBoidGameController()
 	}
 	GameDifficulty = 2;
 
-	LastTimeEvent = ofGetElapsedTimef();
+	LastTimeEvent = FrameClock::getElapsedTimef();
 	SetupGameSequence();
 	doFlippedDrawing = false;
+	projectorLayerVersion = 0;
 }
 
 CBoidGameController::~CBoidGameController()
@@ -68,41 +70,49 @@ void CBoidGameController::setup(std::shared_ptr<KinectProjector> const& k)
 	showMotherRabbit = false;
 	motherPlatformSize = 5;
 	doFlippedDrawing = kinectProjector->getProjectionFlipped();
+	vehicleRenderer.setup();
 
 	setupGui();
 }
 
 
 
-void CBoidGameController::updateBOIDS()
+void CBoidGameController::updateBOIDS(const SimulationClock& clock)
 {
 	// Set static varible that indicate if all BOIDS should be drawn flipped
 	Vehicle::setDrawFlipped(doFlippedDrawing);
 
 	if (kinectProjector->isImageStabilized()) {
-		for (auto & f : fish) {
-			f.applyBehaviours(showMotherFish, fish, dangerBOIDS);
-			f.update();
-		}
-		for (auto & r : rabbits) {
-			r.applyBehaviours(showMotherRabbit, rabbits);
-			r.update();
-		}
-		dangerBOIDS.clear();
-		for (auto & s : sharks) {
-			s.applyBehaviours(fish);
-			s.update();
-			dangerBOIDS.push_back(DangerousBOID(s.getLocation(), s.getVelocity(), s.getSize() * 4));
+		// The BOIDS move by fixed ticks so their speed does not depend on the frame rate
+		for (int tick = 0; tick < clock.getTicks(); tick++) {
+			flockGrid.build(fish);
+			for (auto & f : fish) {
+				f.applyBehaviours(showMotherFish, fish, flockGrid, dangerBOIDS);
+				f.update();
+			}
+			for (auto & r : rabbits) {
+				r.applyBehaviours(showMotherRabbit, rabbits);
+				r.update();
+			}
+			dangerBOIDS.clear();
+			for (auto & s : sharks) {
+				s.applyBehaviours(fish);
+				s.update();
+				dangerBOIDS.push_back(DangerousBOID(s.getLocation(), s.getVelocity(), s.getSize() * 4));
+			}
 		}
+		Vehicle::updateProjectorCoords(*kinectProjector, fish, clock.getAlpha());
+		Vehicle::updateProjectorCoords(*kinectProjector, rabbits, clock.getAlpha());
+		Vehicle::updateProjectorCoords(*kinectProjector, sharks, clock.getAlpha());
 		drawVehicles();
 	}
 }
 
 
 
-void CBoidGameController::update()
+void CBoidGameController::update(const SimulationClock& clock)
 {
-	float resultTime = ofGetElapsedTimef();
+	float resultTime = FrameClock::getElapsedTimef();
 
 
 
@@ -116,12 +126,13 @@ void CBoidGameController::update()
 		fboVehicles.begin();
 		ofClear(255, 255, 255, 0);
 
-		updateBOIDS();
+		updateBOIDS(clock);
 		ComputeScores();
 		DrawScoresOnFBO();
 		PlayAndShowCountDown(resultTime);
 
 		fboVehicles.end();
+		projectorLayerVersion++;
 	}
 	else if (sequence == GAME_STATE_SHOWINTERMIDEATERESULT)
 	{
@@ -131,14 +142,15 @@ void CBoidGameController::update()
 	{
 		// Do nothing in update
 	}
-	else if (sequence == GAME_STATE_IDLE)
+	else if (sequence == GAME_STATE_IDLE && isProjectorLayerActive())
 	{
 		fboVehicles.begin();
 		ofClear(255, 255, 255, 0);
 
-		updateBOIDS();
+		updateBOIDS(clock);
 
 		fboVehicles.end();
+		projectorLayerVersion++;
 	}
 
 	int DeltaTime = GameSequenceTimings[CurrentGameSequence];
@@ -213,13 +225,13 @@ void CBoidGameController::PlayAndShowCountDown(int resultTime)
 
 	std::string timeString = ofToString(timeleft);
 
-	double sW = scoreFont.stringWidth(timeString);
+	double sW = hud.stringWidth(scoreFont, timeString);
 	double sH = scoreFont.stringHeight(timeString);
 
 	double sx = projROI.x + (projROI.width / 2 - sW/2);
 	double sy = projROI.y + 70;
 
-	scoreFont.drawString(timeString, sx, sy);
+	hud.drawString(scoreFont, timeString, sx, sy);
 }
 
 void CBoidGameController::DrawScoresOnFBO()
@@ -236,13 +248,13 @@ void CBoidGameController::DrawScoresOnFBO()
 		"Skins: " + ofToString((int)Player1Skins) + "\n" +
 		"Score: " + ofToString((int)(Player1Skins + Player1Food));
 
-	double sW = scoreFontSmall.stringWidth(P1ScoreStr);
+	double sW = hud.stringWidth(scoreFontSmall, P1ScoreStr);
 	double sH = scoreFontSmall.stringHeight(P1ScoreStr);
 
 	double sx = projROI.x + (projROI.width / 4 - sW / 2);
 	double sy = projROI.y + 70;
 
-	scoreFontSmall.drawString(P1ScoreStr, sx, sy);
+	hud.drawString(scoreFontSmall, P1ScoreStr, sx, sy);
 
 	//std::string P2ScoreStr = "P2: " + ofToString((int)Player2Score);
 	std::string P2ScoreStr = 
@@ -256,13 +268,13 @@ void CBoidGameController::DrawScoresOnFBO()
 	//	"Score: " + ofToString((int)(Player2Skins + Player2Food));
 
 
-	sW = scoreFontSmall.stringWidth(P1ScoreStr);
+	sW = hud.stringWidth(scoreFontSmall, P1ScoreStr);
 	sH = scoreFontSmall.stringHeight(P1ScoreStr);
 
 	sx = projROI.x + (3 * projROI.width / 4 - sW / 2);
 	sy = projROI.y + 70;
 
-	scoreFontSmall.drawString(P2ScoreStr, sx, sy);
+	hud.drawString(scoreFontSmall, P2ScoreStr, sx, sy);
 
 	double xmid = kinectROI.x + kinectROI.width / 2;
 	double ymid = kinectROI.y + kinectROI.height / 2;
@@ -287,7 +299,7 @@ void CBoidGameController::DrawFinalScoresOnFBO()
 	Player2Score = Player2Skins + Player2Food;
 
 	std::string scorestr = "You won!";
-	double sW = nameFont.stringWidth(scorestr);
+	double sW = hud.stringWidth(nameFont, scorestr);
 	double sH = nameFont.stringHeight(scorestr);
 
 	double sy = projROI.y + (projROI.height / 2 - sH / 2);
@@ -303,7 +315,7 @@ void CBoidGameController::DrawFinalScoresOnFBO()
 
 	}
 
-	scoreFont.drawString(scorestr, sx, sy);
+	hud.drawString(scoreFont, scorestr, sx, sy);
 }
 
 void CBoidGameController::drawMainWindow(float x, float y, float width, float height) 
@@ -359,6 +371,7 @@ bool  CBoidGameController::InitiateGameSequence()
 		ofClear(255, 255, 255, 0);
 
 		fboVehicles.end();
+		projectorLayerVersion++;
 		fish.clear();
 		rabbits.clear();
 		sharks.clear();
@@ -424,9 +437,10 @@ bool  CBoidGameController::InitiateGameSequence()
 		DrawFinalScoresOnFBO();
 
 		fboVehicles.end();
+		projectorLayerVersion++;
 	}
 
-	LastTimeEvent = ofGetElapsedTimef();
+	LastTimeEvent = FrameClock::getElapsedTimef();
 	return true;
 }
 
@@ -465,6 +479,7 @@ bool CBoidGameController::CreateSplashScreen()
 	splashScreen.draw(xs, ys, sWn, sHn);
 
 	fboVehicles.end();
+	projectorLayerVersion++;
 	return true;
 }
 
@@ -497,6 +512,7 @@ bool CBoidGameController::StartSeekMotherGame()
 	ofClear(255, 255, 255, 0);
 
 	fboVehicles.end();
+	projectorLayerVersion++;
 	fish.clear();
 	rabbits.clear();
 	sharks.clear();
@@ -521,6 +537,7 @@ void CBoidGameController::setProjectorRes(ofVec2f& PR)
 	fboVehicles.begin();
 	ofClear(0, 0, 0, 255);
 	fboVehicles.end();
+	projectorLayerVersion++;
 }
 
 void CBoidGameController::setKinectRes(ofVec2f& KR)
@@ -685,6 +702,8 @@ bool CBoidGameController::setRandomVehicleLocation(ofRectangle area, bool liveIn
 		count++;
 		float x = ofRandom(area.getLeft(), area.getRight());
 		float y = ofRandom(area.getTop(), area.getBottom());
+		if (!kinectProjector->isInsideKinectROI(x, y)) // Not on the sandbox walls
+			continue;
 		bool insideWater = kinectProjector->elevationAtKinectCoord(x, y) < 0;
 		if ((insideWater && liveInWater) || (!insideWater && !liveInWater)) {
 			location = ofVec2f(x, y);
@@ -702,15 +721,9 @@ void CBoidGameController::drawVehicles()
 		drawMotherFish();
 	if (showMotherRabbit)
 		drawMotherRabbit();
-	for (auto & f : fish) {
-		f.draw();
-	}
-	for (auto & r : rabbits) {
-		r.draw();
-	}
-	for (auto & s : sharks) {
-		s.draw();
-	}
+	vehicleRenderer.draw(fish);
+	vehicleRenderer.draw(rabbits);
+	vehicleRenderer.draw(sharks);
 	//fboVehicles.end();
 }
 
@@ -837,6 +850,16 @@ bool CBoidGameController::isIdle()
 	return(GameSequence[CurrentGameSequence] == GAME_STATE_IDLE);
 }
 
+bool CBoidGameController::isProjectorLayerActive()
+{
+	return !isIdle() || !fish.empty() || !rabbits.empty() || !sharks.empty();
+}
+
+unsigned int CBoidGameController::getProjectorLayerVersion()
+{
+	return projectorLayerVersion;
+}
+
 void CBoidGameController::onButtonEvent(ofxDatGuiButtonEvent e) {
 	if (e.target->is("Remove all animals")) {
 		fish.clear();
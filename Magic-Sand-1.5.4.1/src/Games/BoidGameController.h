@@ -7,6 +7,10 @@ Copyright (c) 2016-2017 Thomas Wolf and Rasmus R. Paulsen (people.compute.dtu.dk
 #define _BoidGameController_h_
 
 #include "vehicle.h"
+#include "SimulationClock.h"
+#include "VehicleRenderer.h"
+#include "FlockGrid.h"
+#include "HudLayer.h"
 #include "../KinectProjector/KinectProjector.h"
 
 class CBoidGameController
@@ -16,13 +20,16 @@ public:
 	virtual ~CBoidGameController();
 
 	void setup(std::shared_ptr<KinectProjector> const& k);
-	void update();
+	void update(const SimulationClock& clock);
 	void drawProjectorWindow();
 	void drawMainWindow(float x, float y, float width, float height);
 
 	bool StartGame(int difficulty);
 	bool StartSeekMotherGame();
 	bool isIdle();
+	// Projector layer hooks for the compositor: the layer is skipped when idle without animals
+	bool isProjectorLayerActive();
+	unsigned int getProjectorLayerVersion();
 
 	void setProjectorRes(ofVec2f& PR);
 	void setKinectRes(ofVec2f& KR);
@@ -37,7 +44,7 @@ private:
 	void onToggleEvent(ofxDatGuiToggleEvent e);
 	void onSliderEvent(ofxDatGuiSliderEvent e);
 	void UpdateGUI();
-	void updateBOIDS();
+	void updateBOIDS(const SimulationClock& clock);
 	void PlayAndShowCountDown(int resultTime);
 	void DrawScoresOnFBO();
 	void DrawFinalScoresOnFBO();
@@ -65,6 +72,7 @@ private:
 	ofTrueTypeFont scoreFont;
 	ofTrueTypeFont scoreFontSmall;
 	ofTrueTypeFont nameFont;
+	HudLayer hud;
 	std::string ScoreText;
 	std::string HiScoreText;
 
@@ -90,12 +98,15 @@ private:
 
 	// FBOs
 	ofFbo fboVehicles;
+	unsigned int projectorLayerVersion;
 
 	// Animals
 	std::vector<Fish> fish;
 	std::vector<Rabbit> rabbits;
 	std::vector<Shark> sharks;
+	FlockGrid flockGrid; // Neighbour queries of the fish, built at each tick
 	std::vector<DangerousBOID> dangerBOIDS;
+	VehicleRenderer vehicleRenderer;
 
 	// Mothers
 	ofPoint motherFish;
@@ -0,0 +1,166 @@
+/***********************************************************************
+FlockGrid.cpp - Uniform grid for the neighbour queries of the fish
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "FlockGrid.h"
+#include <cfloat>
+
+// Bound of the grid size, for fish spread far away from each other
+static const int maxCells = 64 * 1024;
+
+FlockGrid::FlockGrid()
+	: cellSize(1),
+	originX(0),
+	originY(0),
+	cols(0),
+	rows(0),
+	maxSize(0)
+{
+}
+
+void FlockGrid::build(const std::vector<Fish>& fish)
+{
+	int n = fish.size();
+	fishCell.resize(n);
+	fishSlot.resize(n);
+	x.resize(n);
+	y.resize(n);
+	vx.resize(n);
+	vy.resize(n);
+	fishSize.resize(n);
+	if (n == 0)
+	{
+		cellStart.clear();
+		return;
+	}
+
+	// Extent of the school and widest interaction radius
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	maxSize = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const ofPoint& p = fish[i].getLocation();
+		minX = min(minX, p.x);
+		maxX = max(maxX, p.x);
+		minY = min(minY, p.y);
+		maxY = max(maxY, p.y);
+		maxSize = max(maxSize, float(fish[i].getSize()));
+	}
+	cellSize = max(10 + maxSize, 3 * maxSize);
+	while ((int(((maxX - minX) / cellSize) + 1) * int(((maxY - minY) / cellSize) + 1)) > maxCells)
+		cellSize *= 2;
+	originX = minX;
+	originY = minY;
+	cols = int((maxX - minX) / cellSize) + 1;
+	rows = int((maxY - minY) / cellSize) + 1;
+
+	// Counting sort of the fish by cell
+	cellStart.assign(cols * rows + 1, 0);
+	for (int i = 0; i < n; i++)
+	{
+		const ofPoint& p = fish[i].getLocation();
+		fishCell[i] = cellRow(p.y) * cols + cellColumn(p.x);
+		cellStart[fishCell[i] + 1]++;
+	}
+	for (int c = 0; c < cols * rows; c++)
+		cellStart[c + 1] += cellStart[c];
+	cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < n; i++)
+	{
+		int k = cellFill[fishCell[i]]++;
+		fishSlot[i] = k;
+		const ofPoint& p = fish[i].getLocation();
+		const ofPoint& v = fish[i].getVelocity();
+		x[k] = p.x;
+		y[k] = p.y;
+		vx[k] = v.x;
+		vy[k] = v.y;
+		fishSize[k] = fish[i].getSize();
+	}
+}
+
+FlockGrid::Neighbours FlockGrid::sumNeighbours(int self, const ofPoint& p, float size, float neighbourDist) const
+{
+	Neighbours sums;
+	sums.separation.set(0, 0);
+	sums.separationCount = 0;
+	sums.velocity.set(0, 0);
+	sums.position.set(0, 0);
+	sums.count = 0;
+	if (cellStart.empty())
+		return sums;
+
+	float radius = max(neighbourDist, 1.5f * (size + maxSize));
+	int x0 = cellColumn(p.x - radius);
+	int x1 = cellColumn(p.x + radius);
+	int y0 = cellRow(p.y - radius);
+	int y1 = cellRow(p.y + radius);
+	int selfSlot = (self >= 0 && self < int(fishSlot.size())) ? fishSlot[self] : -1;
+	for (int row = y0; row <= y1; row++)
+	{
+		// The cells x0..x1 of the row are one range of the sorted arrays
+		int k0 = cellStart[row * cols + x0];
+		int k1 = cellStart[row * cols + x1 + 1];
+		if (selfSlot >= k0 && selfSlot < k1)
+		{
+			accumulate(k0, selfSlot, p.x, p.y, size, neighbourDist * neighbourDist, sums);
+			accumulate(selfSlot + 1, k1, p.x, p.y, size, neighbourDist * neighbourDist, sums);
+		}
+		else
+			accumulate(k0, k1, p.x, p.y, size, neighbourDist * neighbourDist, sums);
+	}
+	return sums;
+}
+
+void FlockGrid::accumulate(int k0, int k1, float px, float py, float size, float neighbourDist2, Neighbours& sums) const
+{
+	// Branchless loop on squared distances over the arrays, so that the compiler can vectorize it
+	const float* xs = x.data();
+	const float* ys = y.data();
+	const float* vxs = vx.data();
+	const float* vys = vy.data();
+	const float* sizes = fishSize.data();
+	float separationX = 0, separationY = 0, separationCount = 0;
+	float velocityX = 0, velocityY = 0, positionX = 0, positionY = 0, count = 0;
+	for (int k = k0; k < k1; k++)
+	{
+		float dx = px - xs[k];
+		float dy = py - ys[k];
+		float d2 = dx * dx + dy * dy;
+		float separation = 1.5f * (size + sizes[k]);
+		float tooClose = (d2 > 0 && d2 < separation * separation) ? 1.0f : 0.0f;
+		float neighbour = (d2 > 0 && d2 < neighbourDist2) ? 1.0f : 0.0f;
+		// normalized (dx, dy) / distance = (dx, dy) / distance^2
+		float weight = tooClose / max(d2, FLT_MIN);
+		separationX += dx * weight;
+		separationY += dy * weight;
+		separationCount += tooClose;
+		velocityX += neighbour * vxs[k];
+		velocityY += neighbour * vys[k];
+		positionX += neighbour * xs[k];
+		positionY += neighbour * ys[k];
+		count += neighbour;
+	}
+	sums.separation += ofVec2f(separationX, separationY);
+	sums.separationCount += separationCount;
+	sums.velocity += ofVec2f(velocityX, velocityY);
+	sums.position += ofVec2f(positionX, positionY);
+	sums.count += count;
+}
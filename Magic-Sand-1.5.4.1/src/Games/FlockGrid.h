@@ -0,0 +1,83 @@
+/***********************************************************************
+FlockGrid.h - Uniform grid for the neighbour queries of the fish
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef _FlockGrid_h_
+#define _FlockGrid_h_
+
+#include "ofMain.h"
+#include "vehicle.h"
+
+//! Uniform grid over the kinect coordinates holding a snapshot of the fish sorted by cell
+/** Built once per simulation tick with a counting sort. The positions, velocities and sizes
+    are copied in cell order in separate arrays, so the cells of a grid row are one contiguous
+    range. The cells are as large as the widest interaction radius of the fish (align and
+    cohesion: 10 + size, separation: 1.5 x the sum of the sizes), so a query reads the 3 x 3
+    cells around a fish instead of the whole school. All the fish of a tick see the school as
+    it was at the start of the tick */
+class FlockGrid
+{
+public:
+	//! Sums over the neighbours of a fish, for the three flocking effects
+	struct Neighbours
+	{
+		ofVec2f separation; // Sum of the (fish - neighbour) / distance^2 of the too close neighbours
+		float separationCount;
+		ofVec2f velocity; // Sums of the velocities and positions of the neighbours
+		ofVec2f position;
+		float count;
+	};
+
+	FlockGrid();
+
+	void build(const std::vector<Fish>& fish);
+
+	// Neighbours of fish self at p: the fish closer than neighbourDist for the alignment and
+	// cohesion, closer than 1.5 x (size + their size) for the separation. Fish at the very
+	// same place as p are ignored, like the fish itself
+	Neighbours sumNeighbours(int self, const ofPoint& p, float size, float neighbourDist) const;
+
+private:
+	void accumulate(int k0, int k1, float px, float py, float size, float neighbourDist2, Neighbours& sums) const;
+
+	int cellColumn(float px) const
+	{
+		return ofClamp(int((px - originX) / cellSize), 0, cols - 1);
+	}
+	int cellRow(float py) const
+	{
+		return ofClamp(int((py - originY) / cellSize), 0, rows - 1);
+	}
+
+	float cellSize;
+	float originX, originY;
+	int cols, rows;
+	float maxSize;
+	std::vector<int> fishCell; // Cell of each fish
+	std::vector<int> fishSlot; // Index of each fish in the sorted arrays
+	std::vector<int> cellStart; // First sorted index of each cell, plus the total
+	std::vector<int> cellFill; // Next free index of each cell during the sort
+	// Snapshot of the fish, in cell order
+	std::vector<float> x, y;
+	std::vector<float> vx, vy;
+	std::vector<float> fishSize;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/***********************************************************************
+HudLayer.cpp - Cached text drawing for the game HUDs
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "HudLayer.h"
+
+// Space left around each text in the atlas
+static const float atlasPadding = 2;
+// Number of cached widths kept before the cache is emptied (scores make new texts)
+static const size_t maxCachedWidths = 1024;
+
+static bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+HudLayer::HudLayer(int sAtlasWidth, int sAtlasHeight)
+	: atlasWidth(sAtlasWidth),
+	atlasHeight(sAtlasHeight),
+	shelfX(0),
+	shelfY(0),
+	shelfHeight(0),
+	atlasGeneration(0)
+{
+}
+
+void HudLayer::clear()
+{
+	labels.clear();
+	digitStrips.clear();
+	widths.clear();
+	shelfX = 0;
+	shelfY = 0;
+	shelfHeight = 0;
+	atlasGeneration++;
+	if (atlas.isAllocated())
+	{
+		atlas.begin();
+		ofClear(255, 255, 255, 0);
+		atlas.end();
+	}
+}
+
+float HudLayer::stringWidth(ofTrueTypeFont& font, const std::string& text)
+{
+	TextKey key(&font, text);
+	auto it = widths.find(key);
+	if (it != widths.end())
+		return it->second;
+	if (widths.size() >= maxCachedWidths)
+		widths.clear();
+	float width = font.stringWidth(text);
+	widths[key] = width;
+	return width;
+}
+
+void HudLayer::drawString(ofTrueTypeFont& font, const std::string& text, float x, float y)
+{
+	if (text.empty())
+		return;
+	size_t newline = text.find('\n');
+	if (newline != std::string::npos)
+	{
+		// One line after the other, spaced as ofTrueTypeFont does
+		drawString(font, text.substr(0, newline), x, y);
+		drawString(font, text.substr(newline + 1), x, y + font.getLineHeight());
+		return;
+	}
+
+	// Runs of digits from the strip, the other runs as labels
+	float penX = x;
+	size_t start = 0;
+	while (start < text.size())
+	{
+		if (isDigit(text[start]))
+		{
+			DigitStrip& strip = getDigitStrip(font);
+			while (start < text.size() && isDigit(text[start]))
+			{
+				const Label& digit = strip.digits[text[start] - '0'];
+				drawLabel(digit, penX, y);
+				penX += digit.advance;
+				start++;
+			}
+		}
+		else
+		{
+			size_t end = start;
+			while (end < text.size() && !isDigit(text[end]))
+				end++;
+			const Label& label = getLabel(font, text.substr(start, end - start));
+			drawLabel(label, penX, y);
+			penX += label.advance;
+			start = end;
+		}
+	}
+}
+
+HudLayer::Label& HudLayer::getLabel(ofTrueTypeFont& font, const std::string& text)
+{
+	TextKey key(&font, text);
+	auto it = labels.find(key);
+	if (it != labels.end())
+		return it->second;
+	Label label = rasterise(font, text);
+	return labels[key] = label;
+}
+
+HudLayer::DigitStrip& HudLayer::getDigitStrip(ofTrueTypeFont& font)
+{
+	auto it = digitStrips.find(&font);
+	if (it != digitStrips.end())
+		return it->second;
+
+	// The ten digits are rasterised together so that they sit side by side on one shelf,
+	// again if the atlas was emptied in the middle of the strip
+	DigitStrip strip;
+	int generation;
+	do
+	{
+		generation = atlasGeneration;
+		for (int d = 0; d < 10; d++)
+			strip.digits[d] = rasterise(font, std::string(1, char('0' + d)));
+	} while (generation != atlasGeneration);
+	return digitStrips[&font] = strip;
+}
+
+HudLayer::Label HudLayer::rasterise(ofTrueTypeFont& font, const std::string& text)
+{
+	Label label;
+	label.bounds = font.getStringBoundingBox(text, 0, 0);
+	// Pen move measured against a reference glyph, as stringWidth only covers the ink
+	ofRectangle withBar = font.getStringBoundingBox(text + "|", 0, 0);
+	ofRectangle bar = font.getStringBoundingBox("|", 0, 0);
+	label.advance = withBar.getRight() - bar.getRight();
+
+	if (label.bounds.width <= 0 || label.bounds.height <= 0)
+		return label;
+
+	if (!atlas.isAllocated())
+	{
+		atlas.allocate(atlasWidth, atlasHeight, GL_RGBA);
+		atlas.begin();
+		ofClear(255, 255, 255, 0);
+		atlas.end();
+	}
+
+	float w = ceil(label.bounds.width) + 2 * atlasPadding;
+	float h = ceil(label.bounds.height) + 2 * atlasPadding;
+	if (w > atlasWidth || h > atlasHeight)
+	{
+		ofLogWarning("HudLayer") << "rasterise(): text too large for the atlas: " << text;
+		return label;
+	}
+	if (shelfX + w > atlasWidth)
+	{
+		shelfX = 0;
+		shelfY += shelfHeight;
+		shelfHeight = 0;
+	}
+	if (shelfY + h > atlasHeight)
+	{
+		// Atlas full: start again, the texts in use are rasterised again on their next draw
+		ofLogVerbose("HudLayer") << "rasterise(): atlas full, emptying it";
+		std::map<TextKey, float> keptWidths;
+		keptWidths.swap(widths);
+		clear();
+		widths.swap(keptWidths);
+	}
+
+	label.atlasRect.set(shelfX + atlasPadding, shelfY + atlasPadding, ceil(label.bounds.width), ceil(label.bounds.height));
+	shelfX += w;
+	shelfHeight = max(shelfHeight, h);
+
+	// White text whose alpha is kept as is in the atlas, the colour comes at draw time
+	atlas.begin();
+	ofPushStyle();
+	ofEnableAlphaBlending();
+	glBlendFuncSeparate(GL_ONE, GL_ZERO, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	ofSetColor(255);
+	font.drawString(text, label.atlasRect.x - label.bounds.x, label.atlasRect.y - label.bounds.y);
+	ofPopStyle();
+	atlas.end();
+	return label;
+}
+
+void HudLayer::drawLabel(const Label& label, float x, float y)
+{
+	if (label.atlasRect.width <= 0)
+		return;
+	atlas.getTexture().drawSubsection(x + label.bounds.x, y + label.bounds.y, label.atlasRect.width, label.atlasRect.height,
+		label.atlasRect.x, label.atlasRect.y);
+}
@@ -0,0 +1,75 @@
+/***********************************************************************
+HudLayer.h - Cached text drawing for the game HUDs
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef _HudLayer_h_
+#define _HudLayer_h_
+
+#include "ofMain.h"
+#include <map>
+
+//! Drop-in for ofTrueTypeFont::drawString and stringWidth that rasterises each text once
+/** The texts are rasterised in white in a texture atlas and drawn as textured quads tinted
+    by the current colour. A text is split in runs of digits and of other characters: the
+    other runs are cached labels ("Tempo: ", "s"), the digits come from a strip of the ten
+    digits rasterised once per font, so a changing timer or score adds no rasterisation.
+    Texts with several lines are drawn line by line. The atlas is emptied when it is full */
+class HudLayer
+{
+public:
+	HudLayer(int atlasWidth = 2048, int atlasHeight = 1024);
+
+	// Same as ofTrueTypeFont::stringWidth, cached per text
+	float stringWidth(ofTrueTypeFont& font, const std::string& text);
+	// Same placement as ofTrueTypeFont::drawString: x is the pen start, y the baseline
+	void drawString(ofTrueTypeFont& font, const std::string& text, float x, float y);
+	// Forget all the cached texts (after a font is reloaded)
+	void clear();
+
+private:
+	struct Label
+	{
+		ofRectangle atlasRect; // Area of the atlas, empty for blank texts
+		ofRectangle bounds; // Bounding box relative to the pen start on the baseline
+		float advance; // Pen move after the text
+	};
+	struct DigitStrip
+	{
+		Label digits[10];
+	};
+	typedef std::pair<ofTrueTypeFont*, std::string> TextKey;
+
+	Label& getLabel(ofTrueTypeFont& font, const std::string& text);
+	DigitStrip& getDigitStrip(ofTrueTypeFont& font);
+	Label rasterise(ofTrueTypeFont& font, const std::string& text);
+	void drawLabel(const Label& label, float x, float y);
+
+	int atlasWidth, atlasHeight;
+	ofFbo atlas;
+	// Shelf packing of the atlas
+	float shelfX, shelfY, shelfHeight;
+	int atlasGeneration; // Incremented each time the atlas is emptied
+
+	std::map<TextKey, Label> labels;
+	std::map<ofTrueTypeFont*, DigitStrip> digitStrips;
+	std::map<TextKey, float> widths;
+};
+
+#endif
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 
 #include "MapGameController.h"
+#include "../FrameClock.h"
 
 #include <string>
 //#include <direct.h>
@@ -50,9 +51,12 @@ CMapGameController::CMapGameController()
 	}
 
 	CheckedForIsland = 0;
-	LastTimeEvent = ofGetElapsedTimef();;
+	LastTimeEvent = FrameClock::getElapsedTimef();;
 	doShowMatchResultContourLines = true;
 	SetupGameSequence();
+	projectorLayerVersion = 0;
+	layerGameSequence = CurrentGameSequence;
+	layerShowScore = ShowScore;
 }
 
 CMapGameController::~CMapGameController()
@@ -90,7 +94,7 @@ void CMapGameController::setup(std::shared_ptr<KinectProjector> const& k)
 
 void CMapGameController::update()
 {
-	float resultTime = ofGetElapsedTimef();
+	float resultTime = FrameClock::getElapsedTimef();
 
 	if (ShowScore)
 	{
@@ -131,6 +135,12 @@ void CMapGameController::update()
 			InitiateGameSequence();
 		}
 	}
+
+	// The static screens are only composed again when they change
+	if (sequence == GAME_STATE_PLAYANDSHOWCOUNTDOWN || CurrentGameSequence != layerGameSequence || ShowScore != layerShowScore)
+		projectorLayerVersion++;
+	layerGameSequence = CurrentGameSequence;
+	layerShowScore = ShowScore;
 }
 
 void CMapGameController::PlayAndShowCountDown(int resultTime)
@@ -151,13 +161,13 @@ void CMapGameController::PlayAndShowCountDown(int resultTime)
 
 	std::string timeString = ofToString(timeleft);
 
-	double sW = scoreFont.stringWidth(timeString);
+	double sW = hud.stringWidth(scoreFont, timeString);
 	double sH = scoreFont.stringHeight(timeString);
 
 	double sx = projROI.x + (projROI.width - sW - 70);
 	double sy = projROI.y + 70;
 
-	scoreFont.drawString(timeString, sx, sy);
+	hud.drawString(scoreFont, timeString, sx, sy);
 
 	//if (GameSequence[CurrentGameSequence+1] == GAME_STATE_SHOWINTERMIDEATERESULT || 
 	//	GameSequence[CurrentGameSequence + 1] == GAME_STATE_SHOWFINALRESULT)
@@ -183,13 +193,13 @@ void CMapGameController::PlayAndShowCountDown(int resultTime)
 	if (timeleft < 4)
 	{
 		std::string warningString = "Hands Off!";
-		double sW = nameFont.stringWidth(warningString);
+		double sW = hud.stringWidth(nameFont, warningString);
 		double sH = nameFont.stringHeight(warningString);
 
 		double sx = projROI.x + (projROI.width / 2 - sW / 2);
 		double sy = projROI.y + (projROI.height / 2 - sH / 2);
 
-		nameFont.drawString(warningString, sx, sy);
+		hud.drawString(nameFont, warningString, sx, sy);
 	}
 
 	fboProjWindow.end();
@@ -209,6 +219,7 @@ void CMapGameController::DrawScoresOnFBO()
 	DrawScoreTexts();
 
 	fboProjWindow.end();
+	projectorLayerVersion++;
 }
 
 void CMapGameController::DrawScoreTexts()
@@ -313,7 +324,8 @@ bool  CMapGameController::InitiateGameSequence()
 		std::cout << "Final result shown" << std::endl;
 	}
 
-	LastTimeEvent = ofGetElapsedTimef();
+	LastTimeEvent = FrameClock::getElapsedTimef();
+	projectorLayerVersion++;
 	return true;
 }
 
@@ -618,7 +630,7 @@ bool CMapGameController::ButtonPressed()
 	eGameState sequence = GameSequence[CurrentGameSequence];
 	if (sequence == GAME_STATE_PLAYANDSHOWCOUNTDOWN)
 	{
-		float resultTime = ofGetElapsedTimef();
+		float resultTime = FrameClock::getElapsedTimef();
 
 		int DeltaTime = GameSequenceTimings[CurrentGameSequence];
 		int timeleft = DeltaTime - (resultTime - LastTimeEvent);
@@ -683,7 +695,7 @@ void CMapGameController::RealTimeTestMe()
 		return;
 
 	ShowScore = true;
-	LastTimeEvent = ofGetElapsedTimef();
+	LastTimeEvent = FrameClock::getElapsedTimef();
 }
 
 void CMapGameController::DebugTestMe()
@@ -715,6 +727,16 @@ bool CMapGameController::isIdle()
 	return(GameSequence[CurrentGameSequence] == GAME_STATE_IDLE);
 }
 
+bool CMapGameController::isProjectorLayerActive()
+{
+	return ShowScore || !isIdle();
+}
+
+unsigned int CMapGameController::getProjectorLayerVersion()
+{
+	return projectorLayerVersion;
+}
+
 
 void CMapGameController::setProjectorRes(ofVec2f& PR)
 {
@@ -977,16 +999,17 @@ bool CMapGameController::ConnectedComponentAnalysis()
 	MatchResultContours.clear();
 
 	// Store contours in projector coordinates
-	for (int i = 0; i < contours[maxID].size(); i++)
+	int n = contours[maxID].size();
+	std::vector<float> cx(n), cy(n), px(n), py(n);
+	for (int i = 0; i < n; i++)
 	{
-		cv::Point pc = contours[maxID][i];
-		pc.x += kinectROI.x;
-		pc.y += kinectROI.y;
-
-		ofVec2f tp = kinectProjector->kinectCoordToProjCoord(pc.x, pc.y);
-		//tp.y = projRes.y - tp.y;
-
-		MatchResultContours.push_back(tp);
+		cx[i] = contours[maxID][i].x + kinectROI.x;
+		cy[i] = contours[maxID][i].y + kinectROI.y;
+	}
+	kinectProjector->kinectCoordsToProjCoords(n, cx.data(), cy.data(), nullptr, px.data(), py.data());
+	for (int i = 0; i < n; i++)
+	{
+		MatchResultContours.push_back(ofVec2f(px[i], py[i]));
 	}
 
 	return true;
@@ -1745,14 +1768,17 @@ bool CMapGameController::ComputeProjectorMap()
 				  
 	// landmarks in projector coordinates
 	std::vector<cv::Point2f> LMsProj(nLMS);
+	std::vector<float> x(nLMS), y(nLMS), px(nLMS), py(nLMS);
 	for (int i = 0; i < nLMS; i++)
 	{
-		float x = LMDepthImage[i].x;
-		float y = LMDepthImage[i].y;
-
-		ofVec2f tp = kinectProjector->kinectCoordToProjCoord(x, y);
-		LMsProj[i].x = tp.x;
-		LMsProj[i].y = tp.y;
+		x[i] = LMDepthImage[i].x;
+		y[i] = LMDepthImage[i].y;
+	}
+	kinectProjector->kinectCoordsToProjCoords(nLMS, x.data(), y.data(), nullptr, px.data(), py.data());
+	for (int i = 0; i < nLMS; i++)
+	{
+		LMsProj[i].x = px[i];
+		LMsProj[i].y = py[i];
 	}
 
 
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "ReferenceMapHandler.h"
 #include "../KinectProjector/KinectProjector.h"
 #include "SandboxScoreTracker.h"
+#include "HudLayer.h"
 
 //! Controller for the mapper game
 /**  */
@@ -61,6 +62,10 @@ class CMapGameController
 		void DebugTestMe();
 				
 		bool isIdle();
+
+		// Projector layer hooks for the compositor: the layer only changes with the countdown and the game screens
+		bool isProjectorLayerActive();
+		unsigned int getProjectorLayerVersion();
 		
 		void setProjectorRes(ofVec2f& PR);
 
@@ -166,6 +171,7 @@ class CMapGameController
 
 		ofTrueTypeFont scoreFont;
 		ofTrueTypeFont nameFont;
+		HudLayer hud;
 		std::string ScoreText;
 		std::string HiScoreText;
 
@@ -208,6 +214,11 @@ class CMapGameController
 		std::vector<int> GameSequenceTimings;
 		int CurrentGameSequence;
 
+		// Bumped each time fboProjWindow or the drawn screen changes
+		unsigned int projectorLayerVersion;
+		int layerGameSequence;
+		bool layerShowScore;
+
 		void SetupGameSequence();
 		bool ComputeWhereInSequence(int &currentStep, int &totalSteps);
 
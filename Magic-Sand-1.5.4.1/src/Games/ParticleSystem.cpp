@@ -0,0 +1,196 @@
+/***********************************************************************
+ParticleSystem.cpp - Particles of the celebration effects of the games
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "ParticleSystem.h"
+#include "../FrameClock.h"
+
+ParticleSystem::ParticleSystem()
+	: gravity(0),
+	damping(1),
+	wrap(false),
+	wrapTop(0),
+	wrapBottom(0),
+	wrapLeft(0),
+	wrapRight(0),
+	useFallbackColor(false),
+	fallbackCircles(false)
+{
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	mesh.setUsage(GL_STREAM_DRAW);
+}
+
+void ParticleSystem::clear()
+{
+	x.clear();
+	y.clear();
+	vx.clear();
+	vy.clear();
+	rotation.clear();
+	rotationSpeed.clear();
+	particleSize.clear();
+	alpha.clear();
+	pulseSpeed.clear();
+	color.clear();
+}
+
+void ParticleSystem::reserve(int count)
+{
+	x.reserve(count);
+	y.reserve(count);
+	vx.reserve(count);
+	vy.reserve(count);
+	rotation.reserve(count);
+	rotationSpeed.reserve(count);
+	particleSize.reserve(count);
+	alpha.reserve(count);
+	pulseSpeed.reserve(count);
+	color.reserve(count);
+}
+
+void ParticleSystem::add(ofVec2f position, ofVec2f velocity, ofColor c, float s, float r, float rs, float a, float ps)
+{
+	x.push_back(position.x);
+	y.push_back(position.y);
+	vx.push_back(velocity.x);
+	vy.push_back(velocity.y);
+	rotation.push_back(r);
+	rotationSpeed.push_back(rs);
+	particleSize.push_back(s);
+	alpha.push_back(a);
+	pulseSpeed.push_back(ps);
+	color.push_back(c);
+}
+
+void ParticleSystem::setPhysics(float sgravity, float sdamping)
+{
+	gravity = sgravity;
+	damping = sdamping;
+}
+
+void ParticleSystem::setWrap(float top, float bottom, float left, float right)
+{
+	wrap = true;
+	wrapTop = top;
+	wrapBottom = bottom;
+	wrapLeft = left;
+	wrapRight = right;
+}
+
+void ParticleSystem::setFallback(ofColor c, bool circles)
+{
+	useFallbackColor = true;
+	fallbackColor = c;
+	fallbackCircles = circles;
+}
+
+void ParticleSystem::update()
+{
+	int n = size();
+	for (int i = 0; i < n; i++)
+	{
+		x[i] += vx[i];
+		y[i] += vy[i];
+	}
+	for (int i = 0; i < n; i++)
+		rotation[i] += rotationSpeed[i];
+	for (int i = 0; i < n; i++)
+	{
+		vx[i] *= damping;
+		vy[i] = (vy[i] + gravity) * damping;
+	}
+	if (wrap)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			if (y[i] > wrapBottom)
+			{
+				y[i] = wrapTop;
+				x[i] = ofRandom(wrapLeft, wrapRight);
+			}
+		}
+	}
+	float currentTime = FrameClock::getElapsedTimef();
+	for (int i = 0; i < n; i++)
+	{
+		if (pulseSpeed[i] != 0)
+			alpha[i] = 150 + 105 * sin(currentTime * pulseSpeed[i]);
+	}
+}
+
+void ParticleSystem::draw(ofImage& image, float alphaScale, float fallbackAlphaScale, float minY)
+{
+	bool textured = image.isAllocated();
+	float scale = textured ? alphaScale : fallbackAlphaScale;
+	int n = size();
+
+	if (!textured && fallbackCircles)
+	{
+		ofPushStyle();
+		ofFill();
+		for (int i = 0; i < n; i++)
+		{
+			if (y[i] <= minY)
+				continue;
+			ofSetColor(useFallbackColor ? fallbackColor : color[i], alpha[i] * scale);
+			ofDrawCircle(x[i], y[i], particleSize[i] / 2);
+		}
+		ofPopStyle();
+		return;
+	}
+
+	// Quad corners and texture coordinates of the two triangles of each particle
+	static const float cornerX[6] = { -0.5, 0.5, 0.5, -0.5, 0.5, -0.5 };
+	static const float cornerY[6] = { -0.5, -0.5, 0.5, -0.5, 0.5, 0.5 };
+	ofVec2f texSize(1, 1);
+	if (textured)
+		texSize = image.getTexture().getCoordFromPercent(1, 1);
+
+	auto & vertices = mesh.getVertices();
+	auto & texCoords = mesh.getTexCoords();
+	auto & colors = mesh.getColors();
+	vertices.clear();
+	texCoords.clear();
+	colors.clear();
+	for (int i = 0; i < n; i++)
+	{
+		if (y[i] <= minY)
+			continue;
+		float angle = ofDegToRad(rotation[i]);
+		float c = cos(angle) * particleSize[i];
+		float s = sin(angle) * particleSize[i];
+		ofFloatColor vertexColor = textured || !useFallbackColor ? color[i] : fallbackColor;
+		vertexColor.a = alpha[i] * scale / 255;
+		for (int k = 0; k < 6; k++)
+		{
+			vertices.push_back(ofVec3f(x[i] + c * cornerX[k] - s * cornerY[k], y[i] + s * cornerX[k] + c * cornerY[k], 0));
+			texCoords.push_back(ofVec2f((cornerX[k] + 0.5) * texSize.x, (cornerY[k] + 0.5) * texSize.y));
+			colors.push_back(vertexColor);
+		}
+	}
+	if (vertices.empty())
+		return;
+
+	if (textured)
+		image.getTexture().bind();
+	mesh.draw();
+	if (textured)
+		image.getTexture().unbind();
+}
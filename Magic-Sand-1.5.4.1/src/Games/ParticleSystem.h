@@ -0,0 +1,77 @@
+/***********************************************************************
+ParticleSystem.h - Particles of the celebration effects of the games
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef _ParticleSystem_h_
+#define _ParticleSystem_h_
+
+#include "ofMain.h"
+#include <cfloat>
+
+//! Textured particles (confetti, stars) stored as a structure of arrays
+/** update() runs each loop over one attribute array, and draw() writes all the particles
+    in one mesh of textured quads drawn with a single call. Particles with a pulse speed
+    have an alpha pulsing with the time, the others are opaque */
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+
+	void clear();
+	void reserve(int count);
+	void add(ofVec2f position, ofVec2f velocity, ofColor color, float size, float rotation = 0, float rotationSpeed = 0, float alpha = 255, float pulseSpeed = 0);
+
+	// Velocity added (gravity) and velocity factor (damping) applied at each update
+	void setPhysics(float gravity, float damping);
+	// Particles falling below bottom go back to top at a random x between left and right
+	void setWrap(float top, float bottom, float left, float right);
+	// Colour of the particles when the image is missing, and shape (circles instead of squares)
+	void setFallback(ofColor color, bool circles);
+
+	// One animation step (the effects move once per frame)
+	void update();
+	// Particles with y above minY, the alphas scaled by alphaScale (fallbackAlphaScale without image)
+	void draw(ofImage& image, float alphaScale, float fallbackAlphaScale, float minY = -FLT_MAX);
+
+	int size() const
+	{
+		return x.size();
+	}
+
+private:
+	std::vector<float> x, y;
+	std::vector<float> vx, vy;
+	std::vector<float> rotation, rotationSpeed;
+	std::vector<float> particleSize;
+	std::vector<float> alpha, pulseSpeed;
+	std::vector<ofColor> color;
+
+	float gravity;
+	float damping;
+	bool wrap;
+	float wrapTop, wrapBottom, wrapLeft, wrapRight;
+	bool useFallbackColor;
+	ofColor fallbackColor;
+	bool fallbackCircles;
+
+	ofVboMesh mesh;
+};
+
+#endif
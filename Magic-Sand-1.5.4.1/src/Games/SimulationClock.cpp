@@ -0,0 +1,53 @@
+/***********************************************************************
+SimulationClock.cpp - Fixed rate clock for the game simulations
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "SimulationClock.h"
+#include <cmath>
+
+SimulationClock::SimulationClock(float tickRate, int smaxTicksPerFrame)
+	: tickLength(1 / tickRate),
+	maxTicksPerFrame(smaxTicksPerFrame),
+	accumulator(0),
+	ticks(0)
+{
+}
+
+void SimulationClock::advance(float frameTime)
+{
+	if (frameTime < 0)
+		frameTime = 0;
+	accumulator += frameTime;
+	ticks = (int)floor(accumulator / tickLength);
+	if (ticks > maxTicksPerFrame)
+	{
+		// Long frame (window dragged, calibration, loading): drop the late time
+		ticks = maxTicksPerFrame;
+		accumulator = 0;
+		return;
+	}
+	accumulator -= ticks * tickLength;
+}
+
+void SimulationClock::reset()
+{
+	accumulator = 0;
+	ticks = 0;
+}
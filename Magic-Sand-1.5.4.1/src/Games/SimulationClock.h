@@ -0,0 +1,60 @@
+/***********************************************************************
+SimulationClock.h - Fixed rate clock for the game simulations
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef _SimulationClock_h_
+#define _SimulationClock_h_
+
+//! Fixed rate clock shared by the game controllers
+/** The render frame rate changes with the machine load and the projector vsync, so the
+    BOIDS are not moved once per frame. Each frame advance() adds the frame time to an
+    accumulator and gives the number of fixed ticks to simulate; the time left in the
+    accumulator is the interpolation factor between the last two simulated states */
+class SimulationClock
+{
+public:
+	SimulationClock(float tickRate = 60, int maxTicksPerFrame = 5);
+
+	void advance(float frameTime);
+	void reset();
+
+	// Number of simulation ticks to run this frame
+	int getTicks() const
+	{
+		return ticks;
+	}
+	// Position of the rendered frame between the previous (0) and the last (1) simulated state
+	float getAlpha() const
+	{
+		return accumulator / tickLength;
+	}
+	float getTickLength() const
+	{
+		return tickLength;
+	}
+
+private:
+	float tickLength; // s
+	int maxTicksPerFrame; // Above this the simulation slows down instead of stalling the frame
+	float accumulator;
+	int ticks;
+};
+
+#endif
@@ -24,11 +24,13 @@ SOFTWARE.
 ***********************************************************************/
 
 #include "SurvivalGameController.h"
+#include "../FrameClock.h"
 
 CSurvivalGameController::CSurvivalGameController()
 {
 	// Inicializa o estado atual do jogo como ocioso
 	currentState = STATE_IDLE;
+	projectorLayerVersion = 0;
 
 	// SISTEMA DE NÍVEIS
 	// Define o nível atual, máximo de níveis, status de conclusão e máximo de tubarões
@@ -193,7 +195,7 @@ void CSurvivalGameController::goToNextLevel()
 	if (currentLevel > maxLevels) {
 		// JOGO COMPLETO - TODOS NÍVEIS CONCLUÍDOS
 		currentState = STATE_SHOWING_RESULTS;
-		resultsStartTime = ofGetElapsedTimef();
+		resultsStartTime = FrameClock::getElapsedTimef();
 		victory = true;
 		// Gerar efeitos de vitória final
 		generateVictoryEffects();
@@ -202,7 +204,7 @@ void CSurvivalGameController::goToNextLevel()
 
 	// VAI PARA TELA DE LEVEL COMPLETE
 	currentState = STATE_LEVEL_COMPLETE;
-	levelTransitionStartTime = ofGetElapsedTimef();
+	levelTransitionStartTime = FrameClock::getElapsedTimef();
 	// Resetar flag para gerar novos efeitos
 	levelCompleteEffectsGenerated = false;
 }
@@ -210,6 +212,7 @@ void CSurvivalGameController::goToNextLevel()
 void CSurvivalGameController::setup(std::shared_ptr<KinectProjector> const& k)
 {
 	kinectProjector = k; // Armazena referência ao KinectProjector
+	vehicleRenderer.setup(); // Geometria dos animais e shader de instâncias
 
 						 // Configura fontes para texto
 	gameFont.load("verdana.ttf", 42);   // Fonte para títulos
@@ -218,20 +221,18 @@ void CSurvivalGameController::setup(std::shared_ptr<KinectProjector> const& k)
 	resetGame(); // Inicializa o jogo
 }
 
-void CSurvivalGameController::update()
+void CSurvivalGameController::update(const SimulationClock& clock)
 {
-	// Estado ocioso - apenas limpa o FBO
+	// Estado ocioso - a camada não é desenhada pelo compositor, nada a fazer
+	// (todos os outros estados limpam o FBO antes de desenhar)
 	if (currentState == STATE_IDLE) {
-		fboGame.begin();
-		ofClear(0, 0, 0, 0); // Limpa com transparência total
-		ofSetColor(0, 0, 0, 0);
-		fboGame.end();
 		return;
 	}
+	projectorLayerVersion++;
 
 	// Estado de introdução - verifica se tempo acabou
 	if (currentState == STATE_INTRO) {
-		float currentTime = ofGetElapsedTimef();
+		float currentTime = FrameClock::getElapsedTimef();
 		if (currentTime - introStartTime > introDisplayTime) {
 			startFromIntro(); // Começa o jogo após introdução
 		}
@@ -240,7 +241,7 @@ void CSurvivalGameController::update()
 
 	// Estado de jogo ativo
 	if (currentState == STATE_PLAYING) {
-		float currentTime = ofGetElapsedTimef();
+		float currentTime = FrameClock::getElapsedTimef();
 		float levelElapsedTime = currentTime - levelStartTime;
 
 		// VERIFICA SE NÍVEL FOI COMPLETADO (tempo esgotado)
@@ -267,7 +268,7 @@ void CSurvivalGameController::update()
 		}
 
 		// Update do estado do jogo
-		updateGameState();
+		updateGameState(clock);
 
 		// Renderiza cena do jogo no FBO
 		fboGame.begin();
@@ -277,12 +278,8 @@ void CSurvivalGameController::update()
 		drawGameInfo();
 
 		// Desenha animais na cena
-		for (auto &f : fish) {
-			f.draw(); // Desenha cada peixe
-		}
-		for (auto &s : sharks) {
-			s.draw(); // Desenha cada tubarão
-		}
+		vehicleRenderer.draw(fish); // Desenha todos os peixes
+		vehicleRenderer.draw(sharks); // Desenha todos os tubarões
 		fboGame.end();
 	}
 
@@ -291,20 +288,20 @@ void CSurvivalGameController::update()
 		// Atualizar efeitos visuais (confete, estrelas, etc.)
 		updateVisualEffects();
 
-		float currentTime = ofGetElapsedTimef();
+		float currentTime = FrameClock::getElapsedTimef();
 		// Verifica se tempo de transição acabou
 		if (currentTime - levelTransitionStartTime > levelTransitionDuration) {
 			// PREPARA PRÓXIMO NÍVEL
 			applyLevelConfig(currentLevel);
 			levelCompleted = false;
-			levelStartTime = ofGetElapsedTimef();
+			levelStartTime = FrameClock::getElapsedTimef();
 
 			// RESETA ANIMAIS PARA NOVO NÍVEL
 			spawnInitialFish(); // Cria novos peixes
 			sharks.clear();     // Remove todos tubarões
 			dangerBOIDS.clear(); // Limpa perigos
 			sharksSpawned = 0;  // Reseta contador de tubarões
-			lastSharkSpawnTime = ofGetElapsedTimef();
+			lastSharkSpawnTime = FrameClock::getElapsedTimef();
 
 			// Limpar efeitos visuais
 			clearVisualEffects();
@@ -322,7 +319,7 @@ void CSurvivalGameController::update()
 			updateVisualEffects();
 		}
 
-		float currentTime = ofGetElapsedTimef();
+		float currentTime = FrameClock::getElapsedTimef();
 		// Verifica se tempo de exibição acabou
 		if (currentTime - resultsStartTime > resultsDisplayTime) {
 			resetGame(); // Reinicia o jogo
@@ -330,27 +327,35 @@ void CSurvivalGameController::update()
 	}
 }
 
-void CSurvivalGameController::updateGameState()
+void CSurvivalGameController::updateGameState(const SimulationClock& clock)
 {
 	// Só atualiza estado se a imagem do Kinect estiver estável
 	if (kinectProjector->isImageStabilized()) {
-		// Update fish - aplica comportamentos e atualiza posição
-		for (auto &f : fish) {
-			f.applyBehaviours(false, fish, dangerBOIDS);
-			f.update();
-		}
+		// Passos fixos de simulação: a velocidade dos animais não depende do frame rate
+		for (int tick = 0; tick < clock.getTicks(); tick++) {
+			// Update fish - aplica comportamentos e atualiza posição
+			// (grade de vizinhança reconstruída a cada passo)
+			flockGrid.build(fish);
+			for (auto &f : fish) {
+				f.applyBehaviours(false, fish, flockGrid, dangerBOIDS);
+				f.update();
+			}
 
-		// Update sharks - aplica comportamentos e atualiza posição
-		dangerBOIDS.clear();
-		for (auto &s : sharks) {
-			s.applyBehaviours(fish);
-			s.update();
-			// Adiciona tubarão como perigo para os peixes evitarem
-			dangerBOIDS.push_back(DangerousBOID(s.getLocation(), s.getVelocity(), s.getSize() * 4));
-		}
+			// Update sharks - aplica comportamentos e atualiza posição
+			dangerBOIDS.clear();
+			for (auto &s : sharks) {
+				s.applyBehaviours(fish);
+				s.update();
+				// Adiciona tubarão como perigo para os peixes evitarem
+				dangerBOIDS.push_back(DangerousBOID(s.getLocation(), s.getVelocity(), s.getSize() * 4));
+			}
 
-		// Verifica colisões entre peixes e tubarões
-		checkFishSurvival();
+			// Verifica colisões entre peixes e tubarões
+			checkFishSurvival();
+		}
+		// Desenha entre os dois últimos passos
+		Vehicle::updateProjectorCoords(*kinectProjector, fish, clock.getAlpha());
+		Vehicle::updateProjectorCoords(*kinectProjector, sharks, clock.getAlpha());
 	}
 }
 
@@ -411,7 +416,7 @@ void CSurvivalGameController::spawnShark()
 
 void CSurvivalGameController::drawGameInfo()
 {
-	float currentTime = ofGetElapsedTimef();
+	float currentTime = FrameClock::getElapsedTimef();
 	float levelElapsedTime = currentTime - levelStartTime;
 	float levelTimeLeft = levelDuration - levelElapsedTime;
 
@@ -430,10 +435,10 @@ void CSurvivalGameController::drawGameInfo()
 	//   LINHA 1: CENTRALIZAR FASE
 	// ===========================================
 	float yLine1 = 80; // Altura da primeira linha
-	float wLevel = gameFont.stringWidth(levelStr);
+	float wLevel = hud.stringWidth(gameFont, levelStr);
 	float xLevel = (ofGetWidth() - wLevel) / 2; // Centraliza horizontalmente
 
-	gameFont.drawString(levelStr, xLevel, yLine1);
+	hud.drawString(gameFont, levelStr, xLevel, yLine1);
 
 	// ===========================================
 	//   LINHA 2: TEMPO, PEIXES E TUBARÕES LADO A LADO
@@ -442,22 +447,22 @@ void CSurvivalGameController::drawGameInfo()
 	float spacing = 60; // Espaçamento entre elementos
 
 						// Calcula larguras dos textos
-	float wTime = scoreFont.stringWidth(timeStr);
-	float wFish = scoreFont.stringWidth(fishStr);
-	float wShark = scoreFont.stringWidth(sharkStr);
+	float wTime = hud.stringWidth(scoreFont, timeStr);
+	float wFish = hud.stringWidth(scoreFont, fishStr);
+	float wShark = hud.stringWidth(scoreFont, sharkStr);
 
 	// Calcula posicionamento para centralizar grupo
 	float totalWidth = wTime + wFish + wShark + spacing * 2;
 	float startX = (ofGetWidth() - totalWidth) / 2;
 
 	// Desenhar Tempo
-	scoreFont.drawString(timeStr, startX, yLine2);
+	hud.drawString(scoreFont, timeStr, startX, yLine2);
 
 	// Desenhar Peixes
-	scoreFont.drawString(fishStr, startX + wTime + spacing, yLine2);
+	hud.drawString(scoreFont, fishStr, startX + wTime + spacing, yLine2);
 
 	// Desenhar Tubarões
-	scoreFont.drawString(sharkStr, startX + wTime + wFish + spacing * 2, yLine2);
+	hud.drawString(scoreFont, sharkStr, startX + wTime + wFish + spacing * 2, yLine2);
 
 	// Linha divisória opcional (visual)
 	ofSetColor(255, 255, 255, 50); // Branco semi-transparente
@@ -478,32 +483,32 @@ void CSurvivalGameController::drawIntroScreen()
 
 		// Título centralizado
 		string title = "JOGO DE SOBREVIVENCIA";
-		float titleW = gameFont.stringWidth(title);
+		float titleW = hud.stringWidth(gameFont, title);
 		float titleX = (projROI.width - titleW) / 2;
 
 		ofSetColor(255, 255, 255); // Branco
-		gameFont.drawString(title, titleX, 100);
+		hud.drawString(gameFont, title, titleX, 100);
 
 		// Informações sobre o jogo
 		string line1 = "Complete " + ofToString(maxLevels) + " fases!";
-		float line1W = scoreFont.stringWidth(line1);
+		float line1W = hud.stringWidth(scoreFont, line1);
 		float line1X = (projROI.width - line1W) / 2;
-		scoreFont.drawString(line1, line1X, 180);
+		hud.drawString(scoreFont, line1, line1X, 180);
 
 		string line2 = "Proteja os peixes dos tubaroes.";
-		float line2W = scoreFont.stringWidth(line2);
+		float line2W = hud.stringWidth(scoreFont, line2);
 		float line2X = (projROI.width - line2W) / 2;
-		scoreFont.drawString(line2, line2X, 230);
+		hud.drawString(scoreFont, line2, line2X, 230);
 	}
 
 	// Contador regressivo - Centralizado
-	float timeLeft = introDisplayTime - (ofGetElapsedTimef() - introStartTime);
+	float timeLeft = introDisplayTime - (FrameClock::getElapsedTimef() - introStartTime);
 	string countdown = "O jogo inicia em: " + ofToString((int)timeLeft) + "s";
-	float countdownW = scoreFont.stringWidth(countdown);
+	float countdownW = hud.stringWidth(scoreFont, countdown);
 	float countdownX = (projROI.width - countdownW) / 2;
 
 	ofSetColor(0, 0, 0); // Preto
-	scoreFont.drawString(countdown, countdownX, projROI.height - 100);
+	hud.drawString(scoreFont, countdown, countdownX, projROI.height - 100);
 
 	fboGame.end();
 }
@@ -511,11 +516,12 @@ void CSurvivalGameController::drawIntroScreen()
 void CSurvivalGameController::generateConfettiEffects()
 {
 	confettiParticles.clear(); // Limpa partículas existentes
+	confettiParticles.setPhysics(0.1, 0.99); // Gravidade e resistência do ar
+	confettiParticles.setWrap(-50, projROI.height + 50, 0, projROI.width); // Ao sair por baixo, volta ao topo
 
-	int particleCount = 150; // Quantidade de confetes
+	int particleCount = 1500; // Quantidade de confetes
+	confettiParticles.reserve(particleCount);
 	for (int i = 0; i < particleCount; i++) {
-		ConfettiParticle p;
-
 		// Define posição inicial aleatória
 		float spawnX = ofRandom(0, projROI.width);
 		float spawnY;
@@ -528,35 +534,30 @@ void CSurvivalGameController::generateConfettiEffects()
 			spawnY = ofRandom(-100, projROI.height * 0.3);
 		}
 
-		p.position.set(spawnX, spawnY);
-		p.velocity.set(ofRandom(-1, 1), ofRandom(1, 3)); // Velocidade mais lenta
-
-														 // Escolhe cor aleatória para o confete
+		ofColor color;
+		// Escolhe cor aleatória para o confete
 		int colorType = ofRandom(5);
 		switch (colorType) {
-		case 0: p.color = ofColor(255, 100, 100); break;  // Vermelho suave
-		case 1: p.color = ofColor(100, 255, 100); break;  // Verde suave
-		case 2: p.color = ofColor(100, 100, 255); break;  // Azul suave
-		case 3: p.color = ofColor(255, 255, 100); break; // Amarelo suave
-		case 4: p.color = ofColor(200, 200, 255); break; // Branco azulado
+		case 0: color = ofColor(255, 100, 100); break;  // Vermelho suave
+		case 1: color = ofColor(100, 255, 100); break;  // Verde suave
+		case 2: color = ofColor(100, 100, 255); break;  // Azul suave
+		case 3: color = ofColor(255, 255, 100); break; // Amarelo suave
+		case 4: color = ofColor(200, 200, 255); break; // Branco azulado
 		}
 
-		p.size = ofRandom(8, 15); // Tamanho menor
-		p.rotation = ofRandom(0, 360);
-		p.rotationSpeed = ofRandom(-3, 3); // Rotação mais lenta
-
-		confettiParticles.push_back(p); // Adiciona à lista
+		// Velocidade mais lenta, tamanho menor e rotação mais lenta
+		confettiParticles.add(ofVec2f(spawnX, spawnY), ofVec2f(ofRandom(-1, 1), ofRandom(1, 3)), color,
+			ofRandom(8, 15), ofRandom(0, 360), ofRandom(-3, 3));
 	}
 }
 
 void CSurvivalGameController::generateStarEffects()
 {
 	starEffects.clear(); // Limpa estrelas existentes
+	starEffects.setFallback(ofColor(255, 255, 0), true); // Sem imagem: círculos amarelos
 
 	int starCount = 15;
 	for (int i = 0; i < starCount; i++) {
-		StarEffect star;
-
 		// Posicionar estrelas nas bordas, evitando o centro
 		float posX, posY;
 		if (ofRandom(1.0) < 0.5) {
@@ -570,12 +571,9 @@ void CSurvivalGameController::generateStarEffects()
 			posY = ofRandom(1.0) < 0.5 ? ofRandom(0, 80) : ofRandom(projROI.height - 200, projROI.height - 100);
 		}
 
-		star.position.set(posX, posY);
-		star.size = ofRandom(starMinSize, starMaxSize); // Tamanho aleatório
-		star.alpha = ofRandom(80, 180); // Transparência variável
-		star.pulseSpeed = ofRandom(0.3, 1.5); // Velocidade de pulsação
-
-		starEffects.push_back(star); // Adiciona à lista
+		// Tamanho aleatório, transparência variável e velocidade de pulsação
+		starEffects.add(ofVec2f(posX, posY), ofVec2f(0, 0), ofColor(255), ofRandom(starMinSize, starMaxSize),
+			0, 0, ofRandom(80, 180), ofRandom(0.3, 1.5));
 	}
 }
 
@@ -584,17 +582,13 @@ void CSurvivalGameController::generateVictoryEffects()
 	// Gerar confete básico
 	generateConfettiEffects();
 
-	// Adicionar mais confete especial para vitória
-	for (int i = 0; i < 100; i++) {
-		ConfettiParticle p;
-		p.position.set(ofRandom(0, projROI.width),
-			ofRandom(0, projROI.height));
-		p.velocity.set(ofRandom(-3, 3), ofRandom(-3, 3));
-		p.color = ofColor(ofRandom(200, 255), ofRandom(200, 255), 50); // Dourado
-		p.size = ofRandom(15, 30); // Maior que confete normal
-		p.rotation = ofRandom(0, 360);
-		p.rotationSpeed = ofRandom(-8, 8); // Rotação mais rápida
-		confettiParticles.push_back(p);
+	// Adicionar mais confete especial para vitória: maior que o confete normal, rotação mais rápida
+	int particleCount = 1000;
+	confettiParticles.reserve(confettiParticles.size() + particleCount);
+	for (int i = 0; i < particleCount; i++) {
+		ofColor color = ofColor(ofRandom(200, 255), ofRandom(200, 255), 50); // Dourado
+		confettiParticles.add(ofVec2f(ofRandom(0, projROI.width), ofRandom(0, projROI.height)), ofVec2f(ofRandom(-3, 3), ofRandom(-3, 3)), color,
+			ofRandom(15, 30), ofRandom(0, 360), ofRandom(-8, 8));
 	}
 
 	// Gerar estrelas
@@ -604,30 +598,11 @@ void CSurvivalGameController::generateVictoryEffects()
 
 void CSurvivalGameController::updateVisualEffects()
 {
-	// Atualizar partículas de confete
-	for (auto& p : confettiParticles) {
-		p.position += p.velocity; // Move partícula
-		p.rotation += p.rotationSpeed; // Rotaciona
-
-									   // Gravidade - puxa para baixo
-		p.velocity.y += 0.1;
-
-		// Reduz velocidade com resistência do ar
-		p.velocity *= 0.99;
-
-		// Se sair da parte inferior da tela, resetar para o topo
-		if (p.position.y > projROI.height + 50) {
-			p.position.y = -50;
-			p.position.x = ofRandom(0, projROI.width);
-		}
-	}
+	// Atualizar partículas de confete (movimento, rotação, gravidade, retorno ao topo)
+	confettiParticles.update();
 
 	// Atualizar estrelas piscantes (efeito de pulsação)
-	float currentTime = ofGetElapsedTimef();
-	for (auto& star : starEffects) {
-		// Usa seno para criar efeito de pulsação
-		star.alpha = 150 + 105 * sin(currentTime * star.pulseSpeed);
-	}
+	starEffects.update();
 }
 
 void CSurvivalGameController::clearVisualEffects()
@@ -658,44 +633,11 @@ void CSurvivalGameController::drawLevelCompleteScreen()
 	// CAMADA 1: EFEITOS DE FUNDO (mais suaves)
 	ofPushStyle();
 
-	// Confete de fundo (mais transparente)
-	for (const auto& p : confettiParticles) {
-		if (p.position.y > projROI.height * 0.4) { // Só desenha na parte inferior
-			ofPushMatrix();
-			ofTranslate(p.position); // Move para posição da partícula
-			ofRotate(p.rotation);    // Rotaciona
-
-			if (confettiImage.isAllocated()) {
-				ofSetColor(p.color, 100); // Cor com transparência
-				confettiImage.draw(-p.size / 2, -p.size / 2, p.size, p.size);
-			}
-			else {
-				// Fallback: quadrado colorido
-				ofSetColor(p.color, 80);
-				ofDrawRectangle(-p.size / 2, -p.size / 2, p.size, p.size);
-			}
-
-			ofPopMatrix();
-		}
-	}
+	// Confete de fundo (mais transparente), só desenha na parte inferior
+	confettiParticles.draw(confettiImage, 100.0 / 255, 80.0 / 255, projROI.height * 0.4);
 
-	// Estrelas aumentadas (apenas nas bordas)
-	for (const auto& star : starEffects) {
-		// Verifica se está nas bordas da tela
-		if (star.position.x < 100 || star.position.x > projROI.width - 100 ||
-			star.position.y < 100 || star.position.y > projROI.height - 200) {
-			if (starsImage.isAllocated()) {
-				ofSetColor(255, 255, 255, star.alpha * 0.6);
-				starsImage.draw(star.position - ofVec2f(star.size / 2, star.size / 2),
-					star.size, star.size);
-			}
-			else {
-				// Fallback: círculo amarelo
-				ofSetColor(255, 255, 0, star.alpha * 0.6);
-				ofDrawCircle(star.position, star.size / 2);
-			}
-		}
-	}
+	// Estrelas aumentadas (geradas apenas nas bordas)
+	starEffects.draw(starsImage, 0.6, 0.6);
 	ofPopStyle();
 
 	// CAMADA 2: troféu DA FASE COMPLETADA
@@ -731,8 +673,8 @@ void CSurvivalGameController::drawLevelCompleteScreen()
 		// Texto da troféu (opcional)
 		if (!trophyText.empty()) {
 			ofSetColor(255, 255, 200);
-			scoreFont.drawString(trophyText,
-				(projROI.width - scoreFont.stringWidth(trophyText)) / 2,
+			hud.drawString(scoreFont, trophyText,
+				(projROI.width - hud.stringWidth(scoreFont, trophyText)) / 2,
 				trophyY + trophySize + 30);
 		}
 	}
@@ -751,16 +693,16 @@ void CSurvivalGameController::drawLevelCompleteScreen()
 
 	// Título com sombra
 	string title = "FASE " + ofToString(currentLevel - 1) + " SUPERADA!";
-	float titleW = gameFont.stringWidth(title);
+	float titleW = hud.stringWidth(gameFont, title);
 	float titleX = (projROI.width - titleW) / 2;
 
 	// Sombra do título (para legibilidade)
 	ofSetColor(0, 0, 0, 220);
-	gameFont.drawString(title, titleX + 3, textBoxY + 3);
+	hud.drawString(gameFont, title, titleX + 3, textBoxY + 3);
 
 	// Título principal com cor vibrante
 	ofSetColor(0, 255, 255);
-	gameFont.drawString(title, titleX, textBoxY);
+	hud.drawString(gameFont, title, titleX, textBoxY);
 
 	// Linha divisória decorativa sutil
 	ofSetColor(0, 255, 255, 80);
@@ -769,41 +711,41 @@ void CSurvivalGameController::drawLevelCompleteScreen()
 
 	// Informações sobre próxima fase
 	string prepare = "Prepare-se para:";
-	float prepareW = scoreFont.stringWidth(prepare);
+	float prepareW = hud.stringWidth(scoreFont, prepare);
 	float prepareX = (projROI.width - prepareW) / 2;
 
 	// Sombra
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(prepare, prepareX + 2, textBoxY + 151);
+	hud.drawString(scoreFont, prepare, prepareX + 2, textBoxY + 151);
 
 	// Texto principal
 	ofSetColor(255, 255, 0);
-	scoreFont.drawString(prepare, prepareX, textBoxY + 150);
+	hud.drawString(scoreFont, prepare, prepareX, textBoxY + 150);
 
 	// Detalhes da próxima fase
 	string fishProtect = "- " + ofToString(nextConfig.initialFish) + " peixes para proteger";
-	float fishProtectW = scoreFont.stringWidth(fishProtect);
+	float fishProtectW = hud.stringWidth(scoreFont, fishProtect);
 	float fishProtectX = (projROI.width - fishProtectW) / 2;
 
 	// Sombra
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(fishProtect, fishProtectX + 2, textBoxY + 201);
+	hud.drawString(scoreFont, fishProtect, fishProtectX + 2, textBoxY + 201);
 
 	// Texto principal
 	ofSetColor(200, 255, 200);
-	scoreFont.drawString(fishProtect, fishProtectX, textBoxY + 200);
+	hud.drawString(scoreFont, fishProtect, fishProtectX, textBoxY + 200);
 
 	string maxSharks = "- " + ofToString(nextConfig.maxSharks) + " predadores";
-	float maxSharksW = scoreFont.stringWidth(maxSharks);
+	float maxSharksW = hud.stringWidth(scoreFont, maxSharks);
 	float maxSharksX = (projROI.width - maxSharksW) / 2;
 
 	// Sombra
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(maxSharks, maxSharksX + 2, textBoxY + 251);
+	hud.drawString(scoreFont, maxSharks, maxSharksX + 2, textBoxY + 251);
 
 	// Texto principal
 	ofSetColor(200, 200, 255);
-	scoreFont.drawString(maxSharks, maxSharksX, textBoxY + 250);
+	hud.drawString(scoreFont, maxSharks, maxSharksX, textBoxY + 250);
 
 	ofPopStyle();
 
@@ -819,18 +761,18 @@ void CSurvivalGameController::drawLevelCompleteScreen()
 	ofDrawLine(0, projROI.height - 70, projROI.width, projROI.height - 70);
 
 	// Calcula e desenha contador regressivo
-	float timeLeft = levelTransitionDuration - (ofGetElapsedTimef() - levelTransitionStartTime);
+	float timeLeft = levelTransitionDuration - (FrameClock::getElapsedTimef() - levelTransitionStartTime);
 	string countdown = "Fase seguinte em: " + ofToString((int)timeLeft) + "s";
-	float countdownW = scoreFont.stringWidth(countdown);
+	float countdownW = hud.stringWidth(scoreFont, countdown);
 	float countdownX = (projROI.width - countdownW) / 2;
 
 	// Sombra do contador
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(countdown, countdownX + 1, projROI.height - 21);
+	hud.drawString(scoreFont, countdown, countdownX + 1, projROI.height - 21);
 
 	// Contador principal
 	ofSetColor(255, 255, 255);
-	scoreFont.drawString(countdown, countdownX, projROI.height - 22);
+	hud.drawString(scoreFont, countdown, countdownX, projROI.height - 22);
 
 	ofPopStyle();
 
@@ -855,41 +797,14 @@ void CSurvivalGameController::drawVictoryScreen()
 	ofPushStyle();
 
 	// Confete
-	for (const auto& p : confettiParticles) {
-		ofPushMatrix();
-		ofTranslate(p.position);
-		ofRotate(p.rotation);
-
-		if (confettiImage.isAllocated()) {
-			ofSetColor(p.color);
-			confettiImage.draw(-p.size / 2, -p.size / 2, p.size, p.size);
-		}
-		else {
-			// Fallback: quadrado colorido
-			ofSetColor(p.color, 200);
-			ofDrawRectangle(-p.size / 2, -p.size / 2, p.size, p.size);
-		}
-
-		ofPopMatrix();
-	}
+	confettiParticles.draw(confettiImage, 1, 200.0 / 255);
 
 	// Estrelas
-	for (const auto& star : starEffects) {
-		if (starsImage.isAllocated()) {
-			ofSetColor(255, 255, 255, star.alpha * 0.8);
-			starsImage.draw(star.position - ofVec2f(star.size / 2, star.size / 2),
-				star.size, star.size);
-		}
-		else {
-			// Fallback: círculo amarelo
-			ofSetColor(255, 255, 0, star.alpha * 0.8);
-			ofDrawCircle(star.position, star.size / 2);
-		}
-	}
+	starEffects.draw(starsImage, 0.8, 0.8);
 
 	// Fogos de artifício animados
 	if (fireworksImage.isAllocated()) {
-		float time = ofGetElapsedTimef();
+		float time = FrameClock::getElapsedTimef();
 		for (int i = 0; i < 5; i++) {
 			float x = 100 + i * 200;
 			float y = 80 + 50 * sin(time * 2 + i); // Movimento vertical
@@ -922,31 +837,31 @@ void CSurvivalGameController::drawVictoryScreen()
 
 	// Título com efeito de pulso
 	string title = "EXCELENTE!";
-	float titleW = gameFont.stringWidth(title);
+	float titleW = hud.stringWidth(gameFont, title);
 	float titleX = (projROI.width - titleW) / 2;
 
-	float pulse = 0.5 + 0.5 * sin(ofGetElapsedTimef() * 3); // Valor oscilante 0-1
+	float pulse = 0.5 + 0.5 * sin(FrameClock::getElapsedTimef() * 3); // Valor oscilante 0-1
 
 															// Sombra para melhor legibilidade
 	ofSetColor(0, 0, 0, 220);
-	gameFont.drawString(title, titleX + 2, textBoxY + 2);
+	hud.drawString(gameFont, title, titleX + 2, textBoxY + 2);
 
 	// Título principal com efeito de pulso verde
 	ofSetColor(0, 255 * pulse, 0);
-	gameFont.drawString(title, titleX, textBoxY);
+	hud.drawString(gameFont, title, titleX, textBoxY);
 
 	// Mensagem de conclusão
 	string completed = "Todas as " + ofToString(maxLevels) + " fases finalizadas!";
-	float completedW = scoreFont.stringWidth(completed);
+	float completedW = hud.stringWidth(scoreFont, completed);
 	float completedX = (projROI.width - completedW) / 2;
 
 	// Sombra
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(completed, completedX + 2, textBoxY + 72);
+	hud.drawString(scoreFont, completed, completedX + 2, textBoxY + 72);
 
 	// Texto principal
 	ofSetColor(255, 255, 200);
-	scoreFont.drawString(completed, completedX, textBoxY + 70);
+	hud.drawString(scoreFont, completed, completedX, textBoxY + 70);
 
 	ofPopStyle();
 
@@ -958,18 +873,18 @@ void CSurvivalGameController::drawVictoryScreen()
 	ofDrawRectangle(0, projROI.height - 70, projROI.width, 70);
 
 	// Calcula e desenha contador
-	float timeLeft = resultsDisplayTime - (ofGetElapsedTimef() - resultsStartTime);
+	float timeLeft = resultsDisplayTime - (FrameClock::getElapsedTimef() - resultsStartTime);
 	string countdown = "Fim de jogo em: " + ofToString((int)timeLeft) + "s";
-	float countdownW = scoreFont.stringWidth(countdown);
+	float countdownW = hud.stringWidth(scoreFont, countdown);
 	float countdownX = (projROI.width - countdownW) / 2;
 
 	// Sombra do contador
 	ofSetColor(0, 0, 0, 220);
-	scoreFont.drawString(countdown, countdownX + 1, projROI.height - 21);
+	hud.drawString(scoreFont, countdown, countdownX + 1, projROI.height - 21);
 
 	// Contador principal
 	ofSetColor(255, 255, 255);
-	scoreFont.drawString(countdown, countdownX, projROI.height - 22);
+	hud.drawString(scoreFont, countdown, countdownX, projROI.height - 22);
 
 	ofPopStyle();
 
@@ -984,36 +899,36 @@ void CSurvivalGameController::drawDefeatScreen()
 
 							// Título centralizado
 	string title = "GAME OVER";
-	float titleW = gameFont.stringWidth(title);
+	float titleW = hud.stringWidth(gameFont, title);
 	float titleX = (projROI.width - titleW) / 2;
 
 	ofSetColor(255, 100, 100); // Vermelho claro
-	gameFont.drawString(title, titleX, 150);
+	hud.drawString(gameFont, title, titleX, 150);
 
 	// Mensagem da fase centralizada
 	string levelFailed = "Fase " + ofToString(currentLevel) + " Fracassada";
-	float levelFailedW = scoreFont.stringWidth(levelFailed);
+	float levelFailedW = hud.stringWidth(scoreFont, levelFailed);
 	float levelFailedX = (projROI.width - levelFailedW) / 2;
 
 	ofSetColor(255, 255, 255); // Branco
-	scoreFont.drawString(levelFailed, levelFailedX, 250);
+	hud.drawString(scoreFont, levelFailed, levelFailedX, 250);
 
 	// Mensagem motivacional
 	string motivation = "Vamos Iniciar Novamente!!";
-	float motivationW = scoreFont.stringWidth(motivation);
+	float motivationW = hud.stringWidth(scoreFont, motivation);
 	float motivationX = (projROI.width - motivationW) / 2;
 
 	ofSetColor(255, 255, 0); // Amarelo
-	scoreFont.drawString(motivation, motivationX, 350);
+	hud.drawString(scoreFont, motivation, motivationX, 350);
 
 	// Contador centralizado
-	float timeLeft = resultsDisplayTime - (ofGetElapsedTimef() - resultsStartTime);
+	float timeLeft = resultsDisplayTime - (FrameClock::getElapsedTimef() - resultsStartTime);
 	string countdown = "Fim de jogo em: " + ofToString((int)timeLeft) + "s";
-	float countdownW = scoreFont.stringWidth(countdown);
+	float countdownW = hud.stringWidth(scoreFont, countdown);
 	float countdownX = (projROI.width - countdownW) / 2;
 
 	ofSetColor(255, 255, 255, 150); // Branco semi-transparente
-	scoreFont.drawString(countdown, countdownX, projROI.height - 50);
+	hud.drawString(scoreFont, countdown, countdownX, projROI.height - 50);
 
 	fboGame.end();
 }
@@ -1074,7 +989,7 @@ bool CSurvivalGameController::StartGame()
 	if (currentState != STATE_IDLE) return false;
 
 	currentState = STATE_INTRO;
-	introStartTime = ofGetElapsedTimef();
+	introStartTime = FrameClock::getElapsedTimef();
 
 	// RESETA SISTEMA DE NÍVEIS
 	currentLevel = 1;
@@ -1092,6 +1007,16 @@ bool CSurvivalGameController::isIdle()
 	return currentState == STATE_IDLE;
 }
 
+bool CSurvivalGameController::isProjectorLayerActive()
+{
+	return currentState != STATE_IDLE;
+}
+
+unsigned int CSurvivalGameController::getProjectorLayerVersion()
+{
+	return projectorLayerVersion;
+}
+
 bool CSurvivalGameController::isInIntro()
 {
 	return currentState == STATE_INTRO;
@@ -1102,7 +1027,7 @@ void CSurvivalGameController::startFromIntro()
 	// Transição do estado INTRO para PLAYING
 	if (currentState == STATE_INTRO) {
 		currentState = STATE_PLAYING;
-		gameStartTime = ofGetElapsedTimef();
+		gameStartTime = FrameClock::getElapsedTimef();
 		levelStartTime = gameStartTime;
 		lastSharkSpawnTime = gameStartTime;
 		spawnInitialFish(); // Cria peixes iniciais
@@ -1186,6 +1111,8 @@ bool CSurvivalGameController::setRandomFishLocation(ofVec2f &location)
 		count++;
 		float x = ofRandom(fishROI.getLeft(), fishROI.getRight());
 		float y = ofRandom(fishROI.getTop(), fishROI.getBottom());
+		// Ignora posições fora da área de areia (paredes da caixa)
+		if (!kinectProjector->isInsideKinectROI(x, y)) continue;
 		bool insideWater = kinectProjector->elevationAtKinectCoord(x, y) < 0;
 
 		if (insideWater) {
@@ -27,6 +27,11 @@ SOFTWARE.
 #define _SurvivalGameController_h_
 
 #include "vehicle.h"
+#include "SimulationClock.h"
+#include "VehicleRenderer.h"
+#include "ParticleSystem.h"
+#include "HudLayer.h"
+#include "FlockGrid.h"
 #include "../KinectProjector/KinectProjector.h"
 
 class CSurvivalGameController
@@ -38,13 +43,15 @@ public:
 
     // Métodos de ciclo de vida do jogo
     void setup(std::shared_ptr<KinectProjector> const& k); // Configura dependências
-    void update();                                          // Atualiza lógica do jogo a cada frame
+    void update(const SimulationClock& clock);              // Atualiza lógica do jogo a cada frame
     void drawProjectorWindow();                             // Renderiza para janela do projetor
     void drawMainWindow(float x, float y, float width, float height); // Renderiza para janela principal
 
     // Controle de fluxo do jogo
     bool StartGame();       // Inicia o jogo (retorna true se bem-sucedido)
     bool isIdle();          // Verifica se jogo está no estado IDLE
+    bool isProjectorLayerActive();          // Camada do projetor ativa (fora do estado IDLE)
+    unsigned int getProjectorLayerVersion(); // Muda a cada atualização que redesenha o FBO
     bool isInIntro();       // Verifica se jogo está no estado INTRO
     void startFromIntro();  // Transiciona de INTRO para PLAYING
     void goBackToIdle();    // Retorna ao estado IDLE (reinício)
@@ -114,14 +121,18 @@ private:
     // Animais do jogo
     std::vector<Fish> fish;                   // Vetor de peixes controláveis
     std::vector<Shark> sharks;                // Vetor de tubarões inimigos
+    FlockGrid flockGrid;                      // Grade de vizinhança dos peixes
     std::vector<DangerousBOID> dangerBOIDS;   // Vetor de perigos para comportamentos
 
     // Sistema de renderização
     ofFbo fboGame;          // Frame Buffer Object para renderização off-screen
+    unsigned int projectorLayerVersion; // Versão do conteúdo da camada do projetor
+    VehicleRenderer vehicleRenderer; // Desenha todos os animais de uma espécie numa só chamada
 
     // Fontes para texto
     ofTrueTypeFont gameFont;   // Fonte para títulos principais
     ofTrueTypeFont scoreFont;  // Fonte para informações de jogo
+    HudLayer hud;              // Textos das fontes rasterizados uma única vez
 
     // Sistema de imagens
     ofImage splashScreen;     // Imagem da tela de introdução/splash
@@ -135,25 +146,9 @@ private:
     ofImage goldtrophyImage;    // Textura de troféu ouro (nível 3)
     ofImage fireworksImage;    // Textura de fogos de artifício
 
-    // Sistema de partículas para efeitos de confete
-    struct ConfettiParticle {
-        ofVec2f position;       // Posição atual da partícula
-        ofVec2f velocity;       // Velocidade e direção
-        ofColor color;          // Cor do confete
-        float size;             // Tamanho em pixels
-        float rotation;         // Rotação atual em graus
-        float rotationSpeed;    // Velocidade de rotação
-    };
-    std::vector<ConfettiParticle> confettiParticles; // Lista de partículas ativas
-
-    // Sistema de efeitos de estrelas piscantes
-    struct StarEffect {
-        ofVec2f position;       // Posição da estrela
-        float size;             // Tamanho da estrela
-        float alpha;            // Valor alpha atual (transparência)
-        float pulseSpeed;       // Velocidade da animação de pulsação
-    };
-    std::vector<StarEffect> starEffects; // Lista de estrelas ativas
+    // Sistemas de partículas (estrutura de vetores, desenho em lote) para confete e estrelas
+    ParticleSystem confettiParticles; // Partículas de confete ativas
+    ParticleSystem starEffects;       // Estrelas piscantes ativas
 
     // CONTROLES DE TAMANHO E POSIÇÃO
     float starMinSize;      // Tamanho mínimo para estrelas
@@ -171,7 +166,7 @@ private:
     void goToNextLevel();               // Avança para o próximo nível
     void spawnInitialFish();            // Spawna peixes iniciais do nível
     void spawnShark();                  // Spawna um novo tubarão
-    void updateGameState();             // Atualiza estado dos animais e colisões
+    void updateGameState(const SimulationClock& clock); // Atualiza estado dos animais e colisões (em passos fixos)
     void checkFishSurvival();           // Verifica colisões peixe-tubarão
     void drawGameInfo();                // Renderiza HUD com informações
     void drawIntroScreen();             // Renderiza tela de introdução
@@ -0,0 +1,270 @@
+/***********************************************************************
+VehicleRenderer.cpp - Batched drawing of the BOIDS with instancing
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "VehicleRenderer.h"
+#include <cfloat>
+
+static const int initialCapacity = 256;
+static const int discResolution = 16;
+
+// Template vertex attributes:
+// vertex: x, y scaled by the instance size, z = 1 for the vertices of the tail
+// normal: x, y offset in pixels (not scaled), z = 0 for the body colour, 1 for the detail colour
+// texcoord: distance to the centre and radius of the outlined discs, 0 elsewhere
+static void addTemplateVertex(ofMesh& mesh, ofVec2f p, float tailRoot, ofVec2f offset, float part, ofVec2f disc = ofVec2f(0, 0))
+{
+	mesh.addVertex(ofVec3f(p.x, p.y, p.x < tailRoot - 1e-4 ? 1 : 0));
+	mesh.addNormal(ofVec3f(offset.x, offset.y, part));
+	mesh.addTexCoord(disc);
+}
+
+static std::vector<ofVec2f> getLoop(const ofPolyline& polyline)
+{
+	std::vector<ofVec2f> loop;
+	for (auto & v : polyline.getVertices())
+	{
+		ofVec2f p(v.x, v.y);
+		if (loop.empty() || p.squareDistance(loop.back()) > 1e-8)
+			loop.push_back(p);
+	}
+	while (loop.size() > 1 && loop.front().squareDistance(loop.back()) < 1e-8)
+		loop.pop_back();
+	return loop;
+}
+
+// Outline of constant width in pixels, as the lines drawn with ofSetLineWidth
+static void addOutline(ofMesh& mesh, const std::vector<ofVec2f>& loop, float halfWidth, float tailRoot)
+{
+	int n = loop.size();
+	std::vector<ofVec2f> offsets(n);
+	for (int i = 0; i < n; i++)
+	{
+		ofVec2f d1 = (loop[i] - loop[(i + n - 1) % n]).normalize();
+		ofVec2f d2 = (loop[(i + 1) % n] - loop[i]).normalize();
+		ofVec2f n1(-d1.y, d1.x);
+		ofVec2f n2(-d2.y, d2.x);
+		ofVec2f miter = n1 + n2;
+		miter = miter.lengthSquared() > 1e-8 ? miter.normalize() : n1;
+		offsets[i] = miter * (halfWidth / max(miter.dot(n1), 0.25f));
+	}
+	for (int i = 0; i < n; i++)
+	{
+		int j = (i + 1) % n;
+		addTemplateVertex(mesh, loop[i], tailRoot, offsets[i], 0);
+		addTemplateVertex(mesh, loop[i], tailRoot, -offsets[i], 0);
+		addTemplateVertex(mesh, loop[j], tailRoot, offsets[j], 0);
+		addTemplateVertex(mesh, loop[j], tailRoot, offsets[j], 0);
+		addTemplateVertex(mesh, loop[i], tailRoot, -offsets[i], 0);
+		addTemplateVertex(mesh, loop[j], tailRoot, -offsets[j], 0);
+	}
+}
+
+static void addFan(ofMesh& mesh, ofVec2f centre, const std::vector<ofVec2f>& loop, float tailRoot)
+{
+	int n = loop.size();
+	for (int i = 0; i < n; i++)
+	{
+		addTemplateVertex(mesh, centre, tailRoot, ofVec2f(0, 0), 0);
+		addTemplateVertex(mesh, loop[i], tailRoot, ofVec2f(0, 0), 0);
+		addTemplateVertex(mesh, loop[(i + 1) % n], tailRoot, ofVec2f(0, 0), 0);
+	}
+}
+
+// Ellipse of radii rx, ry (scaled) around the offset (pixels). Outlined discs are filled per instance
+static void addDisc(ofMesh& mesh, ofVec2f offset, float rx, float ry, bool outlined)
+{
+	float rim = outlined ? rx : 0;
+	float noTail = -FLT_MAX;
+	for (int i = 0; i < discResolution; i++)
+	{
+		float a0 = TWO_PI * i / discResolution;
+		float a1 = TWO_PI * (i + 1) / discResolution;
+		addTemplateVertex(mesh, ofVec2f(0, 0), noTail, offset, 1, ofVec2f(0, rim));
+		addTemplateVertex(mesh, ofVec2f(rx * cos(a0), ry * sin(a0)), noTail, offset, 1, ofVec2f(rim, rim));
+		addTemplateVertex(mesh, ofVec2f(rx * cos(a1), ry * sin(a1)), noTail, offset, 1, ofVec2f(rim, rim));
+	}
+}
+
+// Outline of the fish and shark bodies (see Fish::draw) for a unit size and a straight tail
+static ofPolyline getFishOutline(float tailSize, float fishLength, float fishHead)
+{
+	float tailangle = 0;
+	ofPolyline fish;
+	fish.curveTo(ofPoint(-fishLength - tailSize*cos(tailangle + 0.8), tailSize*sin(tailangle + 0.8)));
+	fish.curveTo(ofPoint(-fishLength - tailSize*cos(tailangle + 0.8), tailSize*sin(tailangle + 0.8)));
+	fish.curveTo(ofPoint(-fishLength, 0));
+	fish.curveTo(ofPoint(0, -fishHead));
+	fish.curveTo(ofPoint(fishHead, 0));
+	fish.curveTo(ofPoint(0, fishHead));
+	fish.curveTo(ofPoint(-fishLength, 0));
+	fish.curveTo(ofPoint(-fishLength - tailSize*cos(tailangle - 0.8), tailSize*sin(tailangle - 0.8)));
+	fish.curveTo(ofPoint(-fishLength - tailSize*cos(tailangle - 0.8), tailSize*sin(tailangle - 0.8)));
+	fish.close();
+	return fish;
+}
+
+static ofMesh createFishTemplate(float outlineWidth)
+{
+	float tailRoot = -2;
+	ofMesh mesh;
+	addOutline(mesh, getLoop(getFishOutline(1, 2, 1)), outlineWidth, tailRoot);
+	addDisc(mesh, ofVec2f(0, 0), 0.5, 0.5, true);
+	return mesh;
+}
+
+static ofMesh createSharkTemplate()
+{
+	float tailRoot = -4;
+	ofVec2f root(tailRoot, 0);
+	std::vector<ofVec2f> loop = getLoop(getFishOutline(2, 4, 2));
+
+	// The outline crosses itself at the tail joint: fill the body and the tail separately
+	int first = -1, last = -1;
+	for (int i = 0; i < loop.size(); i++)
+	{
+		if (loop[i].squareDistance(root) < 1e-6)
+		{
+			if (first < 0)
+				first = i;
+			last = i;
+		}
+	}
+	ofMesh mesh;
+	if (first < 0 || first == last)
+	{
+		ofLogVerbose("VehicleRenderer") << "createSharkTemplate(): tail joint not found, filling the whole outline";
+		addFan(mesh, ofVec2f(0, 0), loop, tailRoot);
+	}
+	else
+	{
+		std::vector<ofVec2f> body(loop.begin() + first, loop.begin() + last + 1);
+		std::vector<ofVec2f> tail(loop.begin() + last, loop.end());
+		tail.insert(tail.end(), loop.begin(), loop.begin() + first + 1);
+		ofVec2f centre(0, 0);
+		for (auto & p : body)
+			centre += p;
+		addFan(mesh, centre / body.size(), body, tailRoot);
+		addFan(mesh, root, tail, tailRoot);
+	}
+	// Stomach (see Shark::draw): the offsets are not scaled with the shark
+	addDisc(mesh, ofVec2f(3, 8), 0.75, 0.25, false);
+	addDisc(mesh, ofVec2f(3, -8), 0.75, 0.25, false);
+	return mesh;
+}
+
+static ofMesh createRabbitTemplate()
+{
+	// Head of Rabbit::draw, drawn at a fixed size
+	float sc = 2.5;
+	ofPath head;
+	head.curveTo(ofPoint(-10, 0*sc));
+	head.curveTo(ofPoint(-1, 1.5*sc));
+	head.curveTo(ofPoint(-1, 1.5*sc));
+	head.curveTo(ofPoint(-0.5 * sc, 1.5*sc));
+	head.curveTo(ofPoint(-5 * sc, 5.5*sc));
+	head.curveTo(ofPoint(0, 5.5*sc));
+	head.curveTo(ofPoint(5 * sc, 0));
+	head.curveTo(ofPoint(0, -5.5*sc));
+	head.curveTo(ofPoint(-5 * sc, -5.5*sc));
+	head.curveTo(ofPoint(-0.5 * sc, -1.5*sc));
+	head.curveTo(ofPoint(-1, -1.5*sc));
+	head.curveTo(ofPoint(-1, -1.5*sc));
+	head.curveTo(ofPoint(-10, 0 * sc));
+	head.close();
+
+	const ofMesh& tessellation = head.getTessellation();
+	ofMesh mesh;
+	float noTail = -FLT_MAX;
+	if (tessellation.hasIndices())
+	{
+		for (auto index : tessellation.getIndices())
+		{
+			ofVec3f v = tessellation.getVertex(index);
+			addTemplateVertex(mesh, ofVec2f(v.x, v.y), noTail, ofVec2f(0, 0), 0);
+		}
+	}
+	else
+	{
+		for (auto & v : tessellation.getVertices())
+			addTemplateVertex(mesh, ofVec2f(v.x, v.y), noTail, ofVec2f(0, 0), 0);
+	}
+	return mesh;
+}
+
+VehicleRenderer::VehicleRenderer()
+	: shaderLoaded(false),
+	outlineWidth(2.5)
+{
+}
+
+bool VehicleRenderer::setup()
+{
+	string shaderDir = ofIsGLProgrammableRenderer() ? "shaders/shadersGL3/" : "shaders/shadersGL2/";
+	ofLogVerbose("VehicleRenderer") << "setup(): Loading " << shaderDir << "vehicleShader";
+	shaderLoaded = vehicleShader.load(shaderDir + "vehicleShader");
+	if (!shaderLoaded)
+	{
+		ofLogVerbose("VehicleRenderer") << "setup(): vehicleShader not loaded, the vehicles are drawn one by one";
+		return false;
+	}
+	setupBatch(fishBatch, createFishTemplate(outlineWidth), -2);
+	setupBatch(sharkBatch, createSharkTemplate(), -4);
+	setupBatch(rabbitBatch, createRabbitTemplate(), -FLT_MAX);
+	return true;
+}
+
+void VehicleRenderer::setupBatch(Batch& batch, const ofMesh& mesh, float tailRoot)
+{
+	batch.numVertices = mesh.getNumVertices();
+	batch.tailRoot = tailRoot;
+	batch.vbo.setMesh(mesh, GL_STATIC_DRAW);
+
+	// The buffer keeps its name when it grows, so the attributes are only set here
+	batch.capacity = initialCapacity;
+	batch.instanceBuffer.allocate(batch.capacity * sizeof(VehicleInstance), GL_STREAM_DRAW);
+	int stride = sizeof(VehicleInstance);
+	const char* names[] = { "instanceTransform", "instanceShape", "instanceBodyColor", "instanceDetailColor" };
+	int offsets[] = { offsetof(VehicleInstance, transform), offsetof(VehicleInstance, shape), offsetof(VehicleInstance, bodyColor), offsetof(VehicleInstance, detailColor) };
+	for (int i = 0; i < 4; i++)
+	{
+		int location = vehicleShader.getAttributeLocation(names[i]);
+		batch.vbo.setAttributeBuffer(location, batch.instanceBuffer, 4, stride, offsets[i]);
+		batch.vbo.setAttributeDivisor(location, 1);
+	}
+	ofLogVerbose("VehicleRenderer") << "setupBatch(): template of " << batch.numVertices << " vertices";
+}
+
+void VehicleRenderer::drawInstances(Batch& batch)
+{
+	int count = batch.instances.size();
+	if (count > batch.capacity)
+	{
+		batch.capacity = max(count, 2 * batch.capacity);
+		batch.instanceBuffer.allocate(batch.capacity * sizeof(VehicleInstance), GL_STREAM_DRAW);
+	}
+	batch.instanceBuffer.updateData(0, count * sizeof(VehicleInstance), batch.instances.data());
+
+	vehicleShader.begin();
+	vehicleShader.setUniform1f("tailRoot", batch.tailRoot);
+	vehicleShader.setUniform1f("outlineWidth", outlineWidth);
+	batch.vbo.drawInstanced(GL_TRIANGLES, 0, batch.numVertices, count);
+	vehicleShader.end();
+}
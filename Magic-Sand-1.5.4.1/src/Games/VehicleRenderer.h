@@ -0,0 +1,96 @@
+/***********************************************************************
+VehicleRenderer.h - Batched drawing of the BOIDS with instancing
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef _VehicleRenderer_h_
+#define _VehicleRenderer_h_
+
+#include "ofMain.h"
+#include "vehicle.h"
+
+//! Draws all the vehicles of a species with one instanced draw call
+/** The shape of each species is tessellated once at setup, for a unit size and a straight tail.
+    Each frame the vehicles only write their VehicleInstance (position, angle, size, tail angle
+    and colours) in a buffer, and the vertex shader places, scales and bends the template.
+    When the shader can not be loaded the vehicles are drawn one by one with their draw() */
+class VehicleRenderer
+{
+public:
+	VehicleRenderer();
+
+	bool setup();
+	bool isReady() const
+	{
+		return shaderLoaded;
+	}
+
+	void draw(std::vector<Fish>& fish)
+	{
+		drawBatch(fishBatch, fish);
+	}
+	void draw(std::vector<Shark>& sharks)
+	{
+		drawBatch(sharkBatch, sharks);
+	}
+	void draw(std::vector<Rabbit>& rabbits)
+	{
+		drawBatch(rabbitBatch, rabbits);
+	}
+
+private:
+	struct Batch
+	{
+		ofVbo vbo; // Template of the species
+		int numVertices;
+		float tailRoot; // x of the tail joint in the template
+		ofBufferObject instanceBuffer;
+		int capacity; // Instances allocated in instanceBuffer
+		std::vector<VehicleInstance> instances;
+	};
+
+	template<class T> void drawBatch(Batch& batch, std::vector<T>& vehicles)
+	{
+		if (vehicles.empty())
+			return;
+		if (!isReady())
+		{
+			for (auto & v : vehicles)
+				v.draw();
+			return;
+		}
+		batch.instances.resize(vehicles.size());
+		for (size_t i = 0; i < vehicles.size(); i++)
+			vehicles[i].getInstance(batch.instances[i]);
+		drawInstances(batch);
+	}
+
+	void setupBatch(Batch& batch, const ofMesh& mesh, float tailRoot);
+	void drawInstances(Batch& batch);
+
+	bool shaderLoaded;
+	ofShader vehicleShader;
+	float outlineWidth; // Half width of the outlines (pixels)
+
+	Batch fishBatch;
+	Batch sharkBatch;
+	Batch rabbitBatch;
+};
+
+#endif
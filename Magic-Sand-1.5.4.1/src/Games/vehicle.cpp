@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 ***********************************************************************/
 
 #include "vehicle.h"
+#include "FlockGrid.h"
+#include "../FrameClock.h"
 
 // Default value of static variable
 bool Vehicle::DrawFlipped = false;
@@ -32,6 +34,9 @@ Vehicle::Vehicle(std::shared_ptr<KinectProjector> const& k, ofPoint slocation, o
     globalVelocityChange.set(0, 0);
     velocity.set(0.0, 0.0);
     angle = 0;
+    previousLocation = location;
+    previousAngle = 0;
+    drawAngle = 0;
     wandertheta = 0;
     mother = false;
     motherLocation = smotherLocation;
@@ -40,25 +45,21 @@ Vehicle::Vehicle(std::shared_ptr<KinectProjector> const& k, ofPoint slocation, o
 }
 
 void Vehicle::updateBeachDetection(){
-    // Find sandbox gradients and elevations in the next 10 steps of vehicle v, update vehicle variables
-    ofPoint futureLocation;
-    futureLocation = location;
+    // The beach is near if the shore can be reached within the next 10 steps of vehicle v
+    // The signed distance to the shore is positive on land, so it is reversed for the water animals
+    float shoreDist = kinectProjector->shoreDistanceAtKinectCoord(location.x, location.y);
+    if (liveInWater)
+        shoreDist *= -1;
+    float speed = velocity.length();
     beachSlope = ofVec2f(0);
-    beach = false;
-    int i = 1;
-    while (i < 10 && !beach)
+    beach = shoreDist <= 0 || shoreDist < 9 * speed;
+    if (beach)
     {
-        bool overwater = kinectProjector->elevationAtKinectCoord(futureLocation.x, futureLocation.y) > 0;
-        if ((overwater && liveInWater) || (!overwater && !liveInWater))
-        {
-            beach = true;
-            beachDist = i;
-            beachSlope = kinectProjector->gradientAtKinectCoord(futureLocation.x,futureLocation.y);
-            if (liveInWater)
-                beachSlope *= -1;
-        }
-        futureLocation += velocity; // Go to next future location step
-        i++;
+        beachDist = (shoreDist > 0) ? 1 + shoreDist / speed : 1; // In steps
+        // Escape away from the shore
+        beachSlope = kinectProjector->shoreGradientAtKinectCoord(location.x, location.y);
+        if (liveInWater)
+            beachSlope *= -1;
     }
 }
 
@@ -216,8 +217,10 @@ int Vehicle::GetTimeStamp()
 	return now->tm_sec + now->tm_min * 60 + now->tm_hour * 3600;
 }
 
+// One fixed simulation tick. projectorCoord is updated for all the vehicles at once by updateProjectorCoords
 void Vehicle::update(){
-    projectorCoord = kinectProjector->kinectCoordToProjCoord(location.x, location.y);
+    previousLocation = location;
+    previousAngle = angle;
     if (!mother || velocity.lengthSquared() != 0)
     {
         velocity += globalVelocityChange;
@@ -235,6 +238,16 @@ void Vehicle::update(){
     }
 }
 
+float Vehicle::getTailAngle(){
+    float nv = 0.5;//velocity.lengthSquared()/10; // Tail movement amplitude
+    float fact = 50+250*velocity.length()/topSpeed;
+    return nv/25 * (abs(((int)(FrameClock::getElapsedTimef()*fact) % 100) - 50)-25);
+}
+
+float Vehicle::getDrawAngle(){
+    return DrawFlipped ? 180+drawAngle : drawAngle;
+}
+
 
 //==============================================================
 // Derived class Fish
@@ -361,101 +374,41 @@ ofPoint Fish::fleeEffect(std::vector<DangerousBOID>& dangers)
 }
 
 
-ofPoint Fish::separateEffect(vector<Fish>& vehicles)
-{
-	//    float desiredseparation = r*2;
-	ofPoint velocityChange;
-	int count = 0;
-	ofPoint diff;
-	vector<Fish>::iterator other;
-	for (other = vehicles.begin(); other < vehicles.end(); other++)
-	{
-		desiredseparation = (size + other->size) * 1.5;
-
-		float d = (location - other->getLocation()).length();
-		if ((d > 0) && (d < desiredseparation)) {
-			diff = location - other->getLocation();
-			diff.normalize();
-			diff /= d;
-			velocityChange += diff;
-			count++;
-		}
-	}
-	if (count > 0) {
-		velocityChange /= count;
-		velocityChange.normalize();
-		velocityChange *= topSpeed;
-
-		velocityChange -= velocity;
-		velocityChange.limit(maxVelocityChange);
-	}
-	return velocityChange;
-}
-
-//// For every nearby boid in the system, calculate the average velocity
-ofPoint Fish::alignEffect(std::vector<Fish>& vehicles)
+// Separation, alignment and cohesion from a single pass over the neighbours
+void Fish::flockingEffects(std::vector<Fish>& vehicles, const FlockGrid& grid)
 {
 	//float neighbordist = 25;
 	float neighbordist = 10 + size;
-	ofPoint velocityChange;
-
-	int count = 0;
-	vector<Fish>::iterator other;
-	for (other = vehicles.begin(); other < vehicles.end(); other++)
-	{
-		float d = (location - other->getLocation()).length();
+	FlockGrid::Neighbours neighbours = grid.sumNeighbours(this - &vehicles[0], location, size, neighbordist);
 
-		if ((d > 0) && (d < neighbordist)) 
-		{
-			velocityChange += other->velocity;
-			count++;
-		}
-	}
-	if (count > 0) {
-		velocityChange /= count;
+	// Steer at top speed in the given direction
+	auto steer = [this](ofPoint direction) {
+		ofPoint velocityChange = direction;
 		velocityChange.normalize();
 		velocityChange *= topSpeed;
 
 		velocityChange -= velocity;
 		velocityChange.limit(maxVelocityChange);
-	}
-	return velocityChange;
-}
+		return velocityChange;
+	};
 
+	separateF = ofPoint();
+	if (neighbours.separationCount > 0)
+		separateF = steer(neighbours.separation / neighbours.separationCount);
 
-ofPoint Fish::cohesionEffect(std::vector<Fish>& vehicles)
-{
-	//float neighbordist = 25;
-	float neighbordist = 10 + size;
-	ofPoint velocityChange;
-	ofPoint desired;
-
-	int count = 0;
-	vector<Fish>::iterator other;
-	for (other = vehicles.begin(); other < vehicles.end(); other++)
+	// For every nearby boid in the system, the average velocity and the average location
+	alignF = ofPoint();
+	cohesionF = ofPoint();
+	if (neighbours.count > 0)
 	{
-		float d = (location - other->getLocation()).length();
-
-		if ((d > 0) && (d < neighbordist))
-		{
-			desired += other->location;
-			count++;
-		}
+		alignF = steer(neighbours.velocity / neighbours.count);
+		ofPoint desired = neighbours.position / neighbours.count;
+		cohesionF = steer(desired - location);
 	}
-	if (count > 0) {
-		desired /= count;
-		velocityChange = desired - location;
-		velocityChange.normalize();
-		velocityChange *= topSpeed;
-
-		velocityChange -= velocity;
-		velocityChange.limit(maxVelocityChange);
-	}
-	return velocityChange;
 }
 
 
-void Fish::applyBehaviours(bool seekMother, std::vector<Fish>& vehicles, std::vector<DangerousBOID>& dangers){
+void Fish::applyBehaviours(bool seekMother, std::vector<Fish>& vehicles, const FlockGrid& grid, std::vector<DangerousBOID>& dangers){
 	int currentAge = getCurrentAge();
 	if (currentAge > DeathAge)
 	{
@@ -464,9 +417,9 @@ void Fish::applyBehaviours(bool seekMother, std::vector<Fish>& vehicles, std::ve
 	UpdateAgeAndSize();
 	updateBeachDetection();
 
-	alignF = 0.5 * alignEffect(vehicles);
-	cohesionF = 0.2 * cohesionEffect(vehicles);
-	separateF = separateEffect(vehicles);
+	flockingEffects(vehicles, grid);
+	alignF *= 0.5;
+	cohesionF *= 0.2;
     seekF = ofVec2f(0);
     if (seekMother)
         seekF = seekMotherEffect();
@@ -510,20 +463,15 @@ void Fish::draw()
 {
     ofPushMatrix();
     ofTranslate(projectorCoord);
-	if (DrawFlipped)
-		ofRotate(180+angle);
-	else
-		ofRotate(angle);
+	ofRotate(getDrawAngle());
 
     // Compute tail angle
-    float nv = 0.5;//velocity.lengthSquared()/10; // Tail movement amplitude
-    float fact = 50+250*velocity.length()/topSpeed;
-    float tailangle = nv/25 * (abs(((int)(ofGetElapsedTimef()*fact) % 100) - 50)-25);
+    float tailangle = getTailAngle();
     
     // Color of the fish
-    nv = 140;
-    fact = 10;
-    float hsb = nv/50 * (abs(((int)(ofGetElapsedTimef()*fact) % 100) - 50));
+    float nv = 140;
+    float fact = 10;
+    float hsb = nv/50 * (abs(((int)(FrameClock::getElapsedTimef()*fact) % 100) - 50));
     
     // Fish scale
     float sc = size;
@@ -583,6 +531,16 @@ void Fish::draw()
     ofPopMatrix();
 }
 
+void Fish::getInstance(VehicleInstance& instance)
+{
+    instance.transform.set(projectorCoord.x, projectorCoord.y, ofDegToRad(getDrawAngle()), size);
+    // The fish is drawn in black, its dot is filled when it is with its mother, dying, the oldest or fleeing
+    bool filled = DeathAge - getCurrentAge() < 10 || isOldest || isFleeing || mother;
+    instance.shape.set(getTailAngle(), filled ? 1 : 0, 0, 0);
+    instance.bodyColor = ofFloatColor(0, 0, 0);
+    instance.detailColor = ofFloatColor(0, 0, 0);
+}
+
 void Fish::setSizeAndSpeed(double sz)
 {
 	size = sz;
@@ -735,10 +693,7 @@ void Rabbit::draw()//, std::vector<ofVec2f> forces)
 {
     ofPushMatrix();
     ofTranslate(projectorCoord);
-	if (DrawFlipped)
-		ofRotate(180 + angle);
-	else
-		ofRotate(angle);
+	ofRotate(getDrawAngle());
 
     // Rabbit scale
     float sc = 2.5;
@@ -753,8 +708,8 @@ void Rabbit::draw()//, std::vector<ofVec2f> forces)
     {
         float nv = 255;
         int fact = 50;
-        float et = ofGetElapsedTimef();
-        float hsb = nv/50 * (abs(((int)(ofGetElapsedTimef()*fact) % 100) - 50));
+        float et = FrameClock::getElapsedTimef();
+        float hsb = nv/50 * (abs(((int)(FrameClock::getElapsedTimef()*fact) % 100) - 50));
         c1.setHsb((int)hsb, 255, 255); // rainbow
         c2.setHsb(255-(int)hsb, 255, 255);
     }
@@ -837,6 +792,20 @@ void Rabbit::draw()//, std::vector<ofVec2f> forces)
     ofPopMatrix();
 }
 
+void Rabbit::getInstance(VehicleInstance& instance)
+{
+    instance.transform.set(projectorCoord.x, projectorCoord.y, ofDegToRad(getDrawAngle()), 1);
+    instance.shape.set(0, 1, 0, 0);
+    ofColor c2 = ofColor(0, 0, 0);
+    if (mother)
+    {
+        float hsb = 255.0/50 * (abs(((int)(FrameClock::getElapsedTimef()*50) % 100) - 50));
+        c2.setHsb(255-(int)hsb, 255, 255);
+    }
+    instance.bodyColor = c2;
+    instance.detailColor = c2;
+}
+
 
 void Shark::setup()
 {
@@ -1067,19 +1036,11 @@ void Shark::draw()
 {
 	ofPushMatrix();
 	ofTranslate(projectorCoord);
-	if (DrawFlipped)
-		ofRotate(180 + angle);
-	else
-		ofRotate(angle);
+	ofRotate(getDrawAngle());
 
 	// Compute tail angle
-	float nv = 0.5;//velocity.lengthSquared()/10; // Tail movement amplitude
-	float fact = 50 + 250 * velocity.length() / topSpeed;
-	float tailangle = nv / 25 * (abs(((int)(ofGetElapsedTimef()*fact) % 100) - 50) - 25);
+	float tailangle = getTailAngle();
 
-	// Color of the fish
-	nv = 140;
-	fact = 10;
 	//float hsb = nv / 50 * (abs(((int)(ofGetElapsedTimef()*fact) % 100) - 50));
 
 	// Fish scale (muda a cor e as dimenses do peixe)
@@ -1136,6 +1097,15 @@ void Shark::draw()
 	ofPopMatrix();
 }
 
+void Shark::getInstance(VehicleInstance& instance)
+{
+	instance.transform.set(projectorCoord.x, projectorCoord.y, ofDegToRad(getDrawAngle()), size);
+	instance.shape.set(getTailAngle(), 1, 0, 0);
+	instance.bodyColor = ofColor(255, 127, 0);
+	// Red stomach when hunting
+	instance.detailColor = isHunting ? ofColor(255, 0, 0) : ofColor(0, 0, 0);
+}
+
 ofPoint Shark::wanderEffect()
 {
 	ofPoint velocityChange, desired;
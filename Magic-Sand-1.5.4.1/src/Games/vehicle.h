@@ -26,6 +26,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "../KinectProjector/KinectProjector.h"
 
+class FlockGrid;
+
 // We can not interchange info from Fish to Sharks and from Sharks to Fish at the same time. This class is used as an intermediate
 class DangerousBOID
 {
@@ -38,6 +40,15 @@ public:
 	double size;
 };
 
+// Per instance data of the batched drawing of the vehicles (see VehicleRenderer)
+struct VehicleInstance
+{
+	ofVec4f transform; // Projector x, y, drawing angle (rad), size
+	ofVec4f shape; // Tail angle (rad), detail filled (1) or outlined (0)
+	ofFloatColor bodyColor;
+	ofFloatColor detailColor;
+};
+
 
 // A vehicle is basically a BOID. 
 /*
@@ -52,6 +63,8 @@ public:
     virtual void setup() = 0;
  //   virtual void applyBehaviours(bool seekMother, std::vector<Vehicle> vehicles) = 0;
     virtual void draw() = 0;
+    // Fill the instance drawn by VehicleRenderer, matching draw()
+    virtual void getInstance(VehicleInstance& instance) = 0;
     
     void update();
     
@@ -88,6 +101,29 @@ public:
 	{
 		DrawFlipped = df;
 	};
+
+	// Convert the location of all the vehicles to projector coordinates in one batch
+	// alpha interpolates the drawn location and angle between the last two simulation ticks
+	template<class T> static void updateProjectorCoords(KinectProjector& kinectProjector, std::vector<T>& vehicles, float alpha = 1)
+	{
+		int n = vehicles.size();
+		std::vector<float> x(n), y(n), px(n), py(n);
+		for (int i = 0; i < n; i++)
+		{
+			ofPoint drawLocation = vehicles[i].previousLocation.getInterpolated(vehicles[i].location, alpha);
+			x[i] = drawLocation.x;
+			y[i] = drawLocation.y;
+		}
+		kinectProjector.kinectCoordsToProjCoords(n, x.data(), y.data(), nullptr, px.data(), py.data());
+		for (int i = 0; i < n; i++)
+		{
+			Vehicle& v = vehicles[i];
+			v.projectorCoord.set(px[i], py[i]);
+			float angleChange = v.angle - v.previousAngle;
+			angleChange += (angleChange > 180) ? -360 : (angleChange < -180) ? 360 : 0;
+			v.drawAngle = v.previousAngle + alpha * angleChange;
+		}
+	}
     
 protected:
     void updateBeachDetection();
@@ -98,6 +134,8 @@ protected:
     ofPoint slopesEffect();
     virtual ofPoint wanderEffect();
     void applyVelocityChange(const ofPoint & force);
+    float getTailAngle();
+    float getDrawAngle();
     
     std::shared_ptr<KinectProjector> kinectProjector;
 
@@ -108,6 +146,9 @@ protected:
     ofPoint globalVelocityChange;
     ofVec2f currentForce;
     float angle; // direction of the drawing
+    ofPoint previousLocation; // State before the last simulation tick, for the interpolated drawing
+    float previousAngle;
+    float drawAngle;
 	float size; // Size of vehicle
 
     ofVec2f separateF ;
@@ -164,16 +205,17 @@ public:
 	void UpdateAgeAndSize();
 	int getCurrentAge();
 	void reSpawn(vector<Fish>& vehicles);
-	void applyBehaviours(bool seekMother, std::vector<Fish>& vehicles, std::vector<DangerousBOID>& dangers);
+	// grid: the vehicles sorted by cell at the start of the tick (neighbour queries)
+	void applyBehaviours(bool seekMother, std::vector<Fish>& vehicles, const FlockGrid& grid, std::vector<DangerousBOID>& dangers);
     void draw();
+    void getInstance(VehicleInstance& instance);
     
 	void setSizeAndSpeed(double sz);
 
 private:
 
-	ofPoint separateEffect(std::vector<Fish>& vehicles);
-	ofPoint alignEffect(std::vector<Fish>& vehicles);
-	ofPoint cohesionEffect(std::vector<Fish>& vehicles);
+	// Sets separateF, alignF and cohesionF
+	void flockingEffects(std::vector<Fish>& vehicles, const FlockGrid& grid);
 		
     ofPoint wanderEffect();
 	ofPoint fleeEffect(std::vector<DangerousBOID>& dangers);
@@ -190,6 +232,7 @@ public:
 	void locatePray(std::vector<Fish>& vehicles);
 	
 	void draw();
+	void getInstance(VehicleInstance& instance);
 
 private:
 
@@ -221,6 +264,7 @@ public:
     void setup();
     void applyBehaviours(bool seekMother, std::vector<Rabbit>& vehicles);
     void draw();
+    void getInstance(VehicleInstance& instance);
 
 private:
     ofPoint wanderEffect();
@@ -0,0 +1,161 @@
+/***********************************************************************
+ChessboardDetector - Worker thread finding the calibration chessboard
+in the temporally filtered kinect colour images.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "ChessboardDetector.h"
+
+ChessboardDetector::ChessboardDetector()
+{
+}
+
+ChessboardDetector::~ChessboardDetector()
+{
+	stop();
+	waitForThread(true);
+}
+
+void ChessboardDetector::start()
+{
+	startThread(true);
+}
+
+void ChessboardDetector::stop()
+{
+	requests.close();
+	results.close();
+}
+
+void ChessboardDetector::threadedFunction()
+{
+	ChessboardDetectionRequest request;
+	while (requests.receive(request))
+	{
+		results.send(detect(request));
+	}
+}
+
+ChessboardDetectionResult ChessboardDetector::detect(ChessboardDetectionRequest& request)
+{
+	ChessboardDetectionResult result;
+	result.id = request.id;
+	result.frameFilter = request.frameFilter;
+	result.found = false;
+	result.foundInSearchROI = false;
+
+	// Temporal filtering of the frames acquired for this chessboard position
+	unsigned char* filteredImage = nullptr;
+	if (request.filteringType == 0)
+		filteredImage = request.frameFilter->getMedianFilteredImage();
+	else if (request.filteringType == 1)
+		filteredImage = request.frameFilter->getAverageFilteredColImage();
+
+	if (filteredImage == nullptr)
+	{
+		ofLogVerbose("ChessboardDetector") << "detect(): temporal filter buffer not filled";
+		return result;
+	}
+
+	ofPixels grayImage;
+	grayImage.setFromPixels(filteredImage, request.width, request.height, 1);
+
+	// First search around the expected chessboard location
+	result.image = grayImage;
+	stretchContrast(result.image, request.searchROI);
+	result.found = findChessboard(result.image, request.searchROI, request.patternSize, result.corners);
+	result.foundInSearchROI = result.found;
+
+	// Then in the whole sand area
+	if (!result.found && request.searchROI != request.kinectROI)
+	{
+		ofLogVerbose("ChessboardDetector") << "detect(): chessboard not found in " << request.searchROI << " searching the kinect ROI";
+		result.image = grayImage;
+		stretchContrast(result.image, request.kinectROI);
+		result.found = findChessboard(result.image, request.kinectROI, request.patternSize, result.corners);
+	}
+	return result;
+}
+
+void ChessboardDetector::stretchContrast(ofPixels& image, ofRectangle ROI)
+{
+	unsigned char *imgD = image.getData();
+	int width = image.getWidth();
+	int height = image.getHeight();
+	unsigned char minV = 255;
+	unsigned char maxV = 0;
+
+	// Find min and max values inside ROI
+	for (int y = ROI.getMinY(); y < ROI.getMaxY(); y++)
+	{
+		for (int x = ROI.getMinX(); x < ROI.getMaxX(); x++)
+		{
+			unsigned char val = imgD[y * width + x];
+			if (val > maxV)
+				maxV = val;
+			if (val < minV)
+				minV = val;
+		}
+	}
+	ofLogVerbose("ChessboardDetector") << "stretchContrast(): Min " << (int)minV << " max " << (int)maxV;
+	if (maxV <= minV)
+		return;
+
+	double scale = 255.0 / (maxV - minV);
+	for (int idx = 0; idx < width * height; idx++)
+	{
+		double newVal = (imgD[idx] - minV) * scale;
+		newVal = std::min(newVal, 255.0);
+		newVal = std::max(newVal, 0.0);
+		imgD[idx] = (unsigned char)newVal;
+	}
+}
+
+bool ChessboardDetector::findChessboard(ofPixels& image, ofRectangle ROI, cv::Size patternSize, vector<cv::Point2f>& corners)
+{
+	cv::Mat cvGrayImage = ofxCv::toCv(image);
+	cv::Rect tempROI((int)ROI.x, (int)ROI.y, (int)ROI.width, (int)ROI.height);
+	tempROI &= cv::Rect(0, 0, cvGrayImage.cols, cvGrayImage.rows);
+	if (tempROI.width < patternSize.width || tempROI.height < patternSize.height)
+		return false;
+	cv::Mat cvGrayROI = cvGrayImage(tempROI);
+
+	int chessFlags = 0;
+	bool foundChessboard = findChessboardCorners(cvGrayROI, patternSize, corners, chessFlags);
+
+	if (!foundChessboard)
+	{
+		chessFlags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_FAST_CHECK;
+		foundChessboard = findChessboardCorners(cvGrayROI, patternSize, corners, chessFlags);
+	}
+
+	if (!foundChessboard)
+		return false;
+
+	for (int i = 0; i < corners.size(); i++)
+	{
+		corners[i].x += tempROI.x;
+		corners[i].y += tempROI.y;
+	}
+
+	// Sub pixel refinement of the corners
+	cornerSubPix(cvGrayImage, corners, cv::Size(2, 2), cv::Size(-1, -1),   // Rasmus: changed search size to 2 from 11 - since this caused false findings
+		cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
+	return true;
+}
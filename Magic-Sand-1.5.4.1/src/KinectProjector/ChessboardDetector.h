@@ -0,0 +1,75 @@
+/***********************************************************************
+ChessboardDetector - Worker thread finding the calibration chessboard
+in the temporally filtered kinect colour images.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+
+#include "TemporalFrameFilter.h"
+
+// A chessboard search asked by the calibration state machine
+struct ChessboardDetectionRequest
+{
+	int id;
+	std::shared_ptr<CTemporalFrameFilter> frameFilter; // Frames acquired for the current chessboard - owned by the worker until the result is sent
+	int filteringType; // 0: Median, 1: average
+	int width, height;
+	ofRectangle kinectROI; // Used if the chessboard is not found in the search ROI
+	ofRectangle searchROI; // Expected location of the chessboard in the kinect image
+	cv::Size patternSize;
+};
+
+struct ChessboardDetectionResult
+{
+	int id;
+	std::shared_ptr<CTemporalFrameFilter> frameFilter; // Handed back to the caller
+	bool found;
+	bool foundInSearchROI;
+	vector<cv::Point2f> corners; // Sub pixel chessboard corners in kinect image coordinates
+	ofPixels image; // Contrast stretched image the chessboard was searched in
+};
+
+//! Finds the calibration chessboard outside the main thread
+/** Requests and results are exchanged through thread channels so the GUI and the
+    kinect grabber keep running during the temporal filtering and the search */
+class ChessboardDetector : public ofThread
+{
+	public:
+		ChessboardDetector();
+		~ChessboardDetector();
+
+		void start();
+		void stop();
+
+		ofThreadChannel<ChessboardDetectionRequest> requests;
+		ofThreadChannel<ChessboardDetectionResult> results;
+
+	private:
+		void threadedFunction() override;
+
+		ChessboardDetectionResult detect(ChessboardDetectionRequest& request);
+
+		// Stretch the image values to 0..255 using the min and max found inside ROI
+		void stretchContrast(ofPixels& image, ofRectangle ROI);
+
+		bool findChessboard(ofPixels& image, ofRectangle ROI, cv::Size patternSize, vector<cv::Point2f>& corners);
+};
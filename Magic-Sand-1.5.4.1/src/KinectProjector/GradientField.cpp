@@ -0,0 +1,110 @@
+/***********************************************************************
+GradientField - Gradient, slope and land mask of the sand computed on
+the GPU and read back asynchronously for the simulation.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "GradientField.h"
+
+GradientField::GradientField()
+:shaderLoaded(false),
+writeIndex(0),
+pendingCopies(0),
+readBackRequested(false),
+width(0),
+height(0),
+gradientSpan(1){
+}
+
+bool GradientField::loadShader(string shaderDir){
+    ofLogVerbose("GradientField") << "loadShader(): Loading " << shaderDir << "gradientFieldShader";
+    shaderLoaded = fieldShader.load(shaderDir+"gradientFieldShader");
+    return shaderLoaded;
+}
+
+void GradientField::setup(int swidth, int sheight, int sgradientSpan){
+    width = swidth;
+    height = sheight;
+    gradientSpan = std::max(1, sgradientSpan);
+    fieldFbo.allocate(width, height, GL_RGBA32F);
+    fieldFbo.begin();
+    ofClear(0, 0, 0, 0);
+    fieldFbo.end();
+    for (int i = 0; i < 2; i++)
+        pbo[i].allocate(width*height*4*sizeof(float), GL_STREAM_READ);
+    clear();
+    ofLogVerbose("GradientField") << "setup(): " << width << "x" << height << " field, gradient span " << gradientSpan;
+}
+
+void GradientField::setKinectROIMask(const ofPixels& kinectROIMask){
+    if (!kinectROIMask.isAllocated())
+        return;
+    maskTexture.loadData(kinectROIMask);
+}
+
+void GradientField::clear(){
+    field.clear();
+    pendingCopies = 0;
+}
+
+void GradientField::update(ofTexture& depthTexture, const ofMatrix4x4& transposedKinectWorldMatrix, ofVec2f depthTransformation, ofVec4f basePlaneEq){
+    if (!isReady())
+        return;
+
+    // The land mask is stored in the alpha channel: no blending in the pass
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    fieldFbo.begin();
+    fieldShader.begin();
+    fieldShader.setUniformTexture("depthSampler", depthTexture, 1);
+    fieldShader.setUniformTexture("kinectROIMaskSampler", maskTexture, 2);
+    fieldShader.setUniform2f("depthTransformation", depthTransformation);
+    fieldShader.setUniformMatrix4f("kinectWorldMatrix", transposedKinectWorldMatrix);
+    fieldShader.setUniform4f("basePlaneEq", basePlaneEq);
+    fieldShader.setUniform1f("gradientSpan", gradientSpan);
+    ofDrawRectangle(0, 0, width, height);
+    fieldShader.end();
+    fieldFbo.end();
+    ofPopStyle();
+
+    // No CPU user since the last update: the field stays on the GPU
+    if (!readBackRequested)
+    {
+        pendingCopies = 0;
+        return;
+    }
+    readBackRequested = false;
+
+    // Queue the copy of this frame, then map the copy queued at the previous update: it is done by now
+    fieldFbo.getTexture().copyTo(pbo[writeIndex]);
+    writeIndex = 1-writeIndex;
+    if (pendingCopies == 0)
+    {
+        pendingCopies = 1;
+        return;
+    }
+    if (!field.isAllocated())
+        field.allocate(width, height, 4);
+    const float* data = pbo[writeIndex].map<float>(GL_READ_ONLY);
+    if (data != nullptr)
+    {
+        memcpy(field.getData(), data, width*height*4*sizeof(float));
+        pbo[writeIndex].unmap();
+    }
+}
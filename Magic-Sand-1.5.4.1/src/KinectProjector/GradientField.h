@@ -0,0 +1,82 @@
+/***********************************************************************
+GradientField - Gradient, slope and land mask of the sand computed on
+the GPU and read back asynchronously for the simulation.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+
+//! Per kinect pixel gradient, slope and land mask of the filtered depth frame
+/** One shader pass writes the field in a float framebuffer at the kinect resolution, where it
+    stays for the GPU users (getTexture()). The field is only read back to the CPU while someone
+    asks for it (requestReadBack() before each update): it is then copied to a pixel buffer object
+    that is mapped at the next update, so the CPU reads the field of the previous frame without
+    waiting for the GPU. Without requests there is no copy at all */
+class GradientField {
+public:
+    GradientField();
+
+    bool loadShader(string shaderDir);
+    void setup(int width, int height, int gradientSpan);
+    void setKinectROIMask(const ofPixels& kinectROIMask);
+    // The CPU field is wanted: read back the fields of the next updates
+    void requestReadBack(){
+        readBackRequested = true;
+    }
+    // Compute the field of the depth frame and, if requested, read back the field of the previous frame
+    void update(ofTexture& depthTexture, const ofMatrix4x4& transposedKinectWorldMatrix, ofVec2f depthTransformation, ofVec4f basePlaneEq);
+    // Forget the read back field (the CPU gradient field is used until the next read back)
+    void clear();
+
+    bool isReady(){
+        return shaderLoaded && fieldFbo.isAllocated() && maskTexture.isAllocated();
+    }
+    bool hasField(){
+        return field.isAllocated();
+    }
+    // Depth gradient (mm/pixel) towards the rising sand, in the same convention as the grabber gradient field
+    ofVec2f gradientAt(int x, int y){
+        const float* texel = field.getData() + 4*(y*width + x);
+        return ofVec2f(texel[0], texel[1]);
+    }
+    float slopeAt(int x, int y){
+        return field.getData()[4*(y*width + x) + 2];
+    }
+    // r, g: gradient, b: slope, a: land (1) / water (0) of the last computed frame
+    ofTexture& getTexture(){
+        return fieldFbo.getTexture();
+    }
+
+private:
+    bool shaderLoaded;
+    ofShader fieldShader;
+    ofFbo fieldFbo;
+    ofTexture maskTexture;
+
+    // Read back ring: the pass of frame n is copied to pbo[n%2] and pbo[(n-1)%2] is mapped
+    ofBufferObject pbo[2];
+    int writeIndex;
+    int pendingCopies;
+    bool readBackRequested;
+    ofFloatPixels field;
+
+    int width, height;
+    int gradientSpan;
+};
@@ -25,7 +25,13 @@ General Public License for more details.
 KinectGrabber::KinectGrabber()
 :newFrame(true),
 bufferInitiated(false),
-kinectOpened(false)
+kinectOpened(false),
+rimDepth(0),
+elevationOffset(0),
+gpuGradientField(false),
+playback(false),
+playbackIndex(0),
+recordedFrames(0)
 {
 }
 
@@ -56,23 +62,97 @@ bool KinectGrabber::setup(){
 	doInPaint = 0;
 	doFullFrameFiltering = false;
 
-	kinect.init();
-	kinect.setRegistration(true); // To have correspondance between RGB and depth images
-	kinect.setUseTexture(false);
-	width = kinect.getWidth();
-	height = kinect.getHeight();
+	if (playback)
+	{
+		// The frame size comes from the recording
+		width = 640;
+		height = 480;
+		if (!playbackFiles.empty() && ofLoadImage(kinectDepthImage, playbackFiles[0]))
+		{
+			width = kinectDepthImage.getWidth();
+			height = kinectDepthImage.getHeight();
+		}
+	}
+	else
+	{
+		kinect.init();
+		kinect.setRegistration(true); // To have correspondance between RGB and depth images
+		kinect.setUseTexture(false);
+		width = kinect.getWidth();
+		height = kinect.getHeight();
+	}
 
 	kinectDepthImage.allocate(width, height, 1);
     filteredframe.allocate(width, height, 1);
+    elevationframe.allocate(width, height, 1);
+    elevationframe.set(0);
+    landframe.allocate(width, height, 1);
+    landframe.set(0);
+    shoreframe.allocate(width, height, 1);
+    shoreframe.set(0);
     kinectColorImage.allocate(width, height);
     kinectColorImage.setUseTexture(false);
+    kinectColorImage.set(0); // Played back recordings have no color frames
 	return openKinect();
 }
 
 bool KinectGrabber::openKinect() {
-	kinectOpened = kinect.open();
+	if (playback)
+		kinectOpened = !playbackFiles.empty();
+	else
+		kinectOpened = kinect.open();
 	return kinectOpened;
 }
+
+void KinectGrabber::setDepthPlayback(std::string dir) {
+	ofDirectory recording(dir);
+	recording.allowExt("png");
+	recording.listDir();
+	recording.sort();
+	playbackFiles.clear();
+	for (size_t i = 0; i < recording.size(); i++)
+		playbackFiles.push_back(recording.getPath(i));
+	playbackIndex = 0;
+	playback = true;
+	ofLogVerbose("kinectGrabber") << "setDepthPlayback(): " << playbackFiles.size() << " depth frames in " << dir;
+}
+
+void KinectGrabber::setDepthRecording(std::string dir) {
+	performInThread([dir](KinectGrabber & kg) {
+		kg.recordingDir = dir;
+		kg.recordedFrames = 0;
+		if (!dir.empty())
+			ofDirectory::createDirectory(dir, true, true);
+	});
+}
+
+bool KinectGrabber::playNextFrame() {
+	// Wait until the previous frame has been received
+	lock();
+	bool received = storedframes == 0;
+	unlock();
+	if (!received)
+	{
+		ofSleepMillis(1);
+		return false;
+	}
+	if (!ofLoadImage(kinectDepthImage, playbackFiles[playbackIndex]) ||
+		kinectDepthImage.getWidth() != width || kinectDepthImage.getHeight() != height)
+	{
+		ofLogError("kinectGrabber") << "playNextFrame(): can not read " << playbackFiles[playbackIndex];
+		kinectDepthImage.allocate(width, height, 1);
+		kinectDepthImage.set(0);
+	}
+	if (playbackIndex + 1 < playbackFiles.size())
+		playbackIndex++;
+	return true;
+}
+
+void KinectGrabber::recordFrame() {
+	std::string name = recordingDir + "/depth_" + ofToString(recordedFrames, 6, '0') + ".png";
+	ofSaveImage(kinectDepthImage, name);
+	recordedFrames++;
+}
 void KinectGrabber::setupFramefilter(int sgradFieldresolution, float newMaxOffset, ofRectangle ROI, bool sspatialFilter, bool sfollowBigChange, int snumAveragingSlots) {
     gradFieldresolution = sgradFieldresolution;
     ofLogVerbose("kinectGrabber") << "setupFramefilter(): Gradient Field resolution: " << gradFieldresolution;
@@ -163,17 +243,37 @@ void KinectGrabber::threadedFunction() {
         this->actions.clear();
         this->actionsLock.unlock();
         
-        kinect.update();
-        if(kinect.isFrameNew()){
-            kinectDepthImage = kinect.getRawDepthPixels();
+        bool frameNew;
+        if (playback)
+        {
+            frameNew = playNextFrame();
+        }
+        else
+        {
+            kinect.update();
+            frameNew = kinect.isFrameNew();
+            if (frameNew)
+                kinectDepthImage = kinect.getRawDepthPixels();
+        }
+        if(frameNew){
+            if (!recordingDir.empty())
+                recordFrame();
+            updateRimDepth();
             filter();
             filteredframe.setImageType(OF_IMAGE_GRAYSCALE);
-            updateGradientField();
-			kinectColorImage.setFromPixels(kinect.getPixels());
+            if (!gpuGradientField)
+                updateGradientField();
+            updateElevation();
+            updateShoreDistance();
+            if (!playback)
+                kinectColorImage.setFromPixels(kinect.getPixels());
         }
         if (storedframes == 0)
         {
             filtered.send(std::move(filteredframe));
+            elevation.send(std::move(elevationframe));
+            land.send(std::move(landframe));
+            shoreDistance.send(std::move(shoreframe));
 			gradient.send(std::move(gradField));
             colored.send(std::move(kinectColorImage.getPixels()));
             lock();
@@ -200,23 +300,21 @@ void KinectGrabber::filter()
 	if (bufferInitiated && numAveragingSlots < 2)
 	{
 		// Just copy raw kinect data
-		const RawDepth* inputFramePtr = static_cast<const RawDepth*>(kinectDepthImage.getData());
-		float* filteredFramePtr = filteredframe.getData();
-		inputFramePtr += minY*width;  // We only scan kinect ROI
-		filteredFramePtr += minY*width;
+		const RawDepth* inputFrame = static_cast<const RawDepth*>(kinectDepthImage.getData());
+		float* filteredFrame = filteredframe.getData();
 
 		for (unsigned int y = minY; y < maxY; ++y)
 		{
-			inputFramePtr += minX;
-			filteredFramePtr += minX;
+			// We only scan the part of the row inside the ROI mask
+			int rowOffset = y*width + ROIRowStart[y];
+			const RawDepth* inputFramePtr = inputFrame + rowOffset;
+			float* filteredFramePtr = filteredFrame + rowOffset;
 
-			for (unsigned int x = minX; x < maxX; ++x, ++inputFramePtr, ++filteredFramePtr)
+			for (int x = ROIRowStart[y]; x < ROIRowEnd[y]; ++x, ++inputFramePtr, ++filteredFramePtr)
 			{
 				float newVal = static_cast<float>(*inputFramePtr);
 				*filteredFramePtr = newVal;
 			}
-			inputFramePtr += width - maxX;
-			filteredFramePtr += width - maxX;
 		}
 
 		if (doInPaint)
@@ -231,26 +329,20 @@ void KinectGrabber::filter()
 	}
 	else if (bufferInitiated)
     {
-        const RawDepth* inputFramePtr = static_cast<const RawDepth*>(kinectDepthImage.getData());
-        float* averagingBufferPtr = averagingBuffer+averagingSlotIndex*height*width;
-        float* statBufferPtr = statBuffer;
-        float* validBufferPtr = validBuffer;
-        float* filteredFramePtr = filteredframe.getData();
-        
-        inputFramePtr += minY*width;  // We only scan kinect ROI
-        averagingBufferPtr += minY*width;
-        statBufferPtr += minY*width*3;
-        validBufferPtr += minY*width;
-        filteredFramePtr += minY*width;
+        const RawDepth* inputFrame = static_cast<const RawDepth*>(kinectDepthImage.getData());
+        float* averagingSlot = averagingBuffer+averagingSlotIndex*height*width;
+        float* filteredFrame = filteredframe.getData();
 
 		for(unsigned int y=minY ; y<maxY ; ++y)
         {
-            inputFramePtr += minX;
-            averagingBufferPtr += minX;
-            statBufferPtr += minX*3;
-            validBufferPtr += minX;
-            filteredFramePtr += minX;
-            for(unsigned int x=minX ; x<maxX ; ++x,++inputFramePtr,++averagingBufferPtr,statBufferPtr+=3,++validBufferPtr,++filteredFramePtr)
+            // We only scan the part of the row inside the ROI mask
+            int rowOffset = y*width + ROIRowStart[y];
+            const RawDepth* inputFramePtr = inputFrame + rowOffset;
+            float* averagingBufferPtr = averagingSlot + rowOffset;
+            float* statBufferPtr = statBuffer + rowOffset*3;
+            float* validBufferPtr = validBuffer + rowOffset;
+            float* filteredFramePtr = filteredFrame + rowOffset;
+            for(int x=ROIRowStart[y] ; x<ROIRowEnd[y] ; ++x,++inputFramePtr,++averagingBufferPtr,statBufferPtr+=3,++validBufferPtr,++filteredFramePtr)
             {
                 float newVal = static_cast<float>(*inputFramePtr);
                 float oldVal = *averagingBufferPtr;
@@ -302,11 +394,6 @@ void KinectGrabber::filter()
                 }
                 *filteredFramePtr = *validBufferPtr;
 			}
-            inputFramePtr += width-maxX;
-            averagingBufferPtr += width-maxX;
-            statBufferPtr += (width-maxX)*3;
-            validBufferPtr += width-maxX;
-            filteredFramePtr += width-maxX;
         }
 
         /* Go to the next averaging slot: */
@@ -332,16 +419,17 @@ void KinectGrabber::filter()
 	}
 }
 
-void KinectGrabber::setFullFrameFiltering(bool ff, ofRectangle ROI)
+void KinectGrabber::setFullFrameFiltering(bool ff, ofRectangle ROI, ofPixels ROIMask)
 {
 	doFullFrameFiltering = ff;
 	if (ff)
 	{
 		setKinectROI(ofRectangle(0, 0, width, height));
+		updateRimSamples(ROI); // The rim is still around the sand area
 	}
 	else 
 	{
-		setKinectROI(ROI);
+		setKinectROI(ROI, ROIMask);
 		float *data = filteredframe.getData();
 
 		// Clear all pixels outside ROI
@@ -349,7 +437,7 @@ void KinectGrabber::setFullFrameFiltering(bool ff, ofRectangle ROI)
 		{
 			for (unsigned int x = 0; x < width; x++)
 			{
-				if (y < minY || y >= maxY || x < minX || x >= maxX)
+				if (!isInsideROI(x, y))
 				{
 					int idx = y * width + x;
 					data[idx] = 0;
@@ -364,15 +452,17 @@ void KinectGrabber::applySpaceFilter()
 {
     for(int filterPass=0;filterPass<2;++filterPass)
     {
-		// Pointer to first pixel of ROI
-		float *ptrOffset = filteredframe.getData() + minY * width + minX;
-
         // Low-pass filter the values in the ROI
-		// First a horisontal pass
-        for(unsigned int x = 0; x < width; x++)
+		// First a vertical pass along each column of the mask
+        for(int x = minX; x < maxX; x++)
         {
+			int colStart = ROIColStart[x];
+			int colEnd = ROIColEnd[x];
+			if (colEnd - colStart < 2)
+				continue;
+
 			// Pointer to current pixel
-            float* colPtr = ptrOffset + x;
+            float* colPtr = filteredframe.getData() + colStart * width + x;
 			float lastVal = *colPtr;
 
             // Top border pixels 
@@ -380,7 +470,7 @@ void KinectGrabber::applySpaceFilter()
             colPtr += width;
             
             // Filter the interior pixels in the column
-            for(unsigned int y = minY+1; y < maxY-1; ++y, colPtr += width)
+            for(int y = colStart+1; y < colEnd-1; ++y, colPtr += width)
             {
 				float nextLastVal = *colPtr;
                 *colPtr=(lastVal + colPtr[0]*2.0f + colPtr[width])*0.25f;
@@ -391,11 +481,16 @@ void KinectGrabber::applySpaceFilter()
             *colPtr=(lastVal + colPtr[0] * 2.0f)/3.0f;
         }
 
-		// then a vertical pass
-        for(unsigned int y = 0; y < height; y++)
+		// then a horizontal pass along each row of the mask
+        for(int y = minY; y < maxY; y++)
         {
+			int rowStart = ROIRowStart[y];
+			int rowEnd = ROIRowEnd[y];
+			if (rowEnd - rowStart < 2)
+				continue;
+
 			// Pointer to current pixel
-			float* rowPtr = ptrOffset + y * width;
+			float* rowPtr = filteredframe.getData() + y * width + rowStart;
 			
 			// Filter the first pixel in the row: 
             float lastVal=*rowPtr;
@@ -403,7 +498,7 @@ void KinectGrabber::applySpaceFilter()
             rowPtr++;
        
             // Filter the interior pixels in the row: 
-            for(unsigned int x = minX+1; x < maxX-1; ++x,++rowPtr)
+            for(int x = rowStart+1; x < rowEnd-1; ++x,++rowPtr)
             {
                 float nextLastVal=*rowPtr;
                 *rowPtr=(lastVal+rowPtr[0]*2.0f+rowPtr[1])*0.25f;
@@ -416,6 +511,39 @@ void KinectGrabber::applySpaceFilter()
     }
 }
 
+void KinectGrabber::updateElevation()
+{
+    if (elevationCoeffs.size() != width*height)
+        return; // Base plane not set yet
+
+    // Straight loops over the whole frame so the compiler can vectorize them
+    const float* depthPtr = filteredframe.getData();
+    const ofVec2f* coeffPtr = elevationCoeffs.data();
+    float* elevationPtr = elevationframe.getData();
+    unsigned char* landPtr = landframe.getData();
+    int size = width*height;
+    for (int i = 0; i < size; i++)
+        elevationPtr[i] = depthPtr[i] * coeffPtr[i].x - elevationOffset;
+    for (int i = 0; i < size; i++)
+        landPtr[i] = (elevationPtr[i] > 0) * 255;
+}
+
+// Exact euclidean distance transforms (linear time, two passes) of the land and water areas inside the ROI
+void KinectGrabber::updateShoreDistance()
+{
+    if (elevationCoeffs.size() != width*height || maxX <= minX || maxY <= minY)
+        return;
+
+    cv::Rect ROIRect(minX, minY, maxX - minX, maxY - minY);
+    cv::Mat land = cv::Mat(height, width, CV_8UC1, landframe.getData())(ROIRect);
+    cv::Mat shore = cv::Mat(height, width, CV_32FC1, shoreframe.getData())(ROIRect);
+
+    cv::bitwise_not(land, waterMask);
+    cv::distanceTransform(land, distanceToWater, CV_DIST_L2, CV_DIST_MASK_PRECISE);
+    cv::distanceTransform(waterMask, distanceToLand, CV_DIST_L2, CV_DIST_MASK_PRECISE);
+    cv::subtract(distanceToWater, distanceToLand, shore); // One of the two is 0 on each pixel
+}
+
 void KinectGrabber::updateGradientField()
 {
     int ind = 0;
@@ -426,7 +554,7 @@ void KinectGrabber::updateGradientField()
     float* filteredFramePtr=filteredframe.getData();
     for(unsigned int y=0;y<gradFieldrows;++y) {
         for(unsigned int x=0;x<gradFieldcols;++x) {
-            if (isInsideROI(x*gradFieldresolution, y*gradFieldresolution) && isInsideROI((x+1)*gradFieldresolution, (y+1)*gradFieldresolution) ){
+            if (isInsideROI(x*gradFieldresolution, y*gradFieldresolution) && isInsideROI((x+1)*gradFieldresolution-1, (y+1)*gradFieldresolution-1) ){
                 gx = 0;
                 gvx = 0;
                 gy = 0;
@@ -462,8 +590,6 @@ float KinectGrabber::findInpaintValue(float *data, int x, int y)
 	int sideLength = 5;
 
 	// We do not search outside ROI
-	int tminx = max(minX, x - sideLength);
-	int tmaxx = min(maxX, x + sideLength);
 	int tminy = max(minY, y - sideLength);
 	int tmaxy = min(maxY, y + sideLength);
 
@@ -471,7 +597,9 @@ float KinectGrabber::findInpaintValue(float *data, int x, int y)
 	double sumval = 0;
 	for (int y = tminy; y < tmaxy; y++)
 	{
-		for (int x = tminx; x < tmaxy; x++)
+		int tminx = max(ROIRowStart[y], x - sideLength);
+		int tmaxx = min(ROIRowEnd[y], x + sideLength);
+		for (int x = tminx; x < tmaxx; x++)
 		{
 			int idx = y * width + x;
 			float val = data[idx];
@@ -496,9 +624,9 @@ void KinectGrabber::applySimpleOutlierInpainting()
 	// Estimate overall average inside ROI
 	int samples = 0;
 	ROIAverageValue = 0;
-	for (unsigned int y = minY; y < maxY; y++)
+	for (int y = minY; y < maxY; y++)
 	{
-		for (unsigned int x = minX; x < maxX; x++)
+		for (int x = ROIRowStart[y]; x < ROIRowEnd[y]; x++)
 		{
 			int idx = y * width + x;
 			float val = data[idx];
@@ -517,15 +645,11 @@ void KinectGrabber::applySimpleOutlierInpainting()
 
 	setToLocalAvg = 0;
 	setToGlobalAvg = 0;
-	// Filter ROI
-	for (unsigned int y = max(0, minY-2); y < min((int)height, maxY+2); y++)
+	// Filter ROI (the mask rows already extend beyond the sand area border)
+	for (int y = minY; y < maxY; y++)
 	{
-		for (unsigned int x = max(0, minX-2); x < min((int)width, maxX+2); x++)
+		for (int x = ROIRowStart[y]; x < ROIRowEnd[y]; x++)
 		{
-	//for (unsigned int y = minY; y < maxY; y++)
-	//{
-	//	for (unsigned int x = minX; x < maxX; x++)
-	//	{
 			int idx = y * width + x;
 			float val = data[idx];
 
@@ -549,12 +673,99 @@ void KinectGrabber::applySimpleOutlierInpainting()
 }
 
 bool KinectGrabber::isInsideROI(int x, int y){
-    if (x<minX||x>maxX||y<minY||y>maxY)
+    if (x<minX||x>=maxX||y<minY||y>=maxY)
         return false;
-    return true;
+    return x >= ROIRowStart[y] && x < ROIRowEnd[y];
+}
+
+void KinectGrabber::updateROISpans(){
+    ROIRowStart.assign(height, 0);
+    ROIRowEnd.assign(height, 0);
+    ROIColStart.assign(width, height);
+    ROIColEnd.assign(width, 0);
+
+    for (int y = minY; y < maxY; y++)
+    {
+        if (!ROIMask.isAllocated())
+        {
+            ROIRowStart[y] = minX;
+            ROIRowEnd[y] = maxX;
+        }
+        else
+        {
+            // Extent of the mask on this row - holes in non convex masks are kept
+            const unsigned char* maskRow = ROIMask.getData() + y*width;
+            int x0 = minX;
+            while (x0 < maxX && maskRow[x0] == 0)
+                x0++;
+            int x1 = maxX;
+            while (x1 > x0 && maskRow[x1-1] == 0)
+                x1--;
+            ROIRowStart[y] = x0;
+            ROIRowEnd[y] = x1;
+        }
+        for (int x = ROIRowStart[y]; x < ROIRowEnd[y]; x++)
+        {
+            ROIColStart[x] = min(ROIColStart[x], y);
+            ROIColEnd[x] = max(ROIColEnd[x], y+1);
+        }
+    }
+    for (int x = 0; x < width; x++)
+    {
+        if (ROIColEnd[x] == 0)
+            ROIColStart[x] = 0;
+    }
 }
 
-void KinectGrabber::setKinectROI(ofRectangle ROI){
+void KinectGrabber::updateRimSamples(ofRectangle ROI){
+    // Every 4th pixel of a rectangle 8 pixels outside the ROI, inside the frame
+    rimSamples.clear();
+    int x0 = static_cast<int>(ROI.getMinX()) - 8;
+    int x1 = static_cast<int>(ROI.getMaxX()) + 8;
+    int y0 = static_cast<int>(ROI.getMinY()) - 8;
+    int y1 = static_cast<int>(ROI.getMaxY()) + 8;
+    for (int x = x0; x <= x1; x += 4)
+    {
+        if (x < 0 || x >= (int)width)
+            continue;
+        if (y0 >= 0)
+            rimSamples.push_back(y0*width + x);
+        if (y1 < (int)height)
+            rimSamples.push_back(y1*width + x);
+    }
+    for (int y = y0 + 4; y < y1; y += 4)
+    {
+        if (y < 0 || y >= (int)height)
+            continue;
+        if (x0 >= 0)
+            rimSamples.push_back(y*width + x0);
+        if (x1 < (int)width)
+            rimSamples.push_back(y*width + x1);
+    }
+    rimValues.reserve(rimSamples.size());
+}
+
+void KinectGrabber::updateRimDepth(){
+    const RawDepth* depth = kinectDepthImage.getData();
+    rimValues.clear();
+    for (int i = 0; i < rimSamples.size(); i++)
+    {
+        if (depth[rimSamples[i]] > 0)
+            rimValues.push_back(depth[rimSamples[i]]);
+    }
+    // The median ignores people leaning on a part of the rim
+    float value = 0;
+    if (rimValues.size() > 10 && rimValues.size() > rimSamples.size() / 2)
+    {
+        std::nth_element(rimValues.begin(), rimValues.begin() + rimValues.size() / 2, rimValues.end());
+        value = rimValues[rimValues.size() / 2];
+    }
+    lock();
+    rimDepth = value;
+    unlock();
+}
+
+void KinectGrabber::setKinectROI(ofRectangle ROI, ofPixels sROIMask){
 	if (doFullFrameFiltering)
 	{
 		minX = 0;
@@ -574,6 +785,21 @@ void KinectGrabber::setKinectROI(ofRectangle ROI){
 		minY = max(0, minY);
 		maxY = min(maxY, (int)height);
 	}
+
+	// The sand area mask is grown by the same border as the rectangle
+	if (!doFullFrameFiltering && sROIMask.isAllocated() && sROIMask.getWidth() == width && sROIMask.getHeight() == height)
+	{
+		ROIMask = sROIMask;
+		cv::Mat mask = ofxCv::toCv(ROIMask);
+		cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+	}
+	else
+	{
+		ROIMask.clear();
+	}
+	updateROISpans();
+	if (!doFullFrameFiltering)
+		updateRimSamples(ROI);
     //ROIwidth = maxX-minX;
     //ROIheight = maxY-minY;
     resetBuffers();
@@ -633,7 +859,16 @@ float KinectGrabber::getValidBuffer(int x, int y){
 
 ofMatrix4x4 KinectGrabber::getWorldMatrix() {
 	auto mat = ofMatrix4x4();
-	if (kinectOpened) {
+	if (playback) {
+		// No device to ask: zero plane of a Kinect v1 as reported by libfreenect
+		// (reference pixel size 0.1042 mm at 120 mm, doubled for the 640x480 depth frames)
+		float factor = 2 * 0.1042 / 120;
+		mat = ofMatrix4x4(factor, 0, 0, -factor * width / 2,
+			0, factor, 0, -factor * height / 2,
+			0, 0, 0, 1,
+			0, 0, 0, 1);
+	}
+	else if (kinectOpened) {
 		ofVec3f a = kinect.getWorldCoordinateAt(0, 0, 1);// Trick to access kinect internal parameters without having to modify ofxKinect
 		ofVec3f b = kinect.getWorldCoordinateAt(1, 1, 1);
 		ofLogVerbose("kinectGrabber") << "getWorldMatrix(): Computing kinect world matrix";
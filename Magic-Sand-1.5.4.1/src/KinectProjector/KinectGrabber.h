@@ -39,6 +39,16 @@ public:
     void performInThread(std::function<void(KinectGrabber&)> action);
     bool setup();
 	bool openKinect();
+	// Play the raw depth frames (16 bits png files, in name order) of dir instead of opening the kinect.
+	// To be called before setup(). One frame is played each time the previous one has been received
+	// and the last frame is repeated at the end. KinectProjector waits for each played frame, so the
+	// application runs one frame per depth frame whatever the machine speed
+	void setDepthPlayback(std::string dir);
+	bool isPlayingBack(){
+		return playback;
+	}
+	// Save each raw depth frame as a png in dir (empty dir: stop recording)
+	void setDepthRecording(std::string dir);
 	void setupFramefilter(int gradFieldresolution, float newMaxOffset, ofRectangle ROI, bool spatialFilter, bool followBigChange, int numAveragingSlots);
     void initiateBuffers(void); // Reinitialise buffers
     void resetBuffers(void);
@@ -48,7 +58,7 @@ public:
     float getValidBuffer(int x, int y);
     
     void setFollowBigChange(bool newfollowBigChange);
-    void setKinectROI(ofRectangle skinectROI);
+    void setKinectROI(ofRectangle skinectROI, ofPixels sROIMask = ofPixels());
     void setAveragingSlotsNumber(int snumAveragingSlots);
     void setGradFieldResolution(int sgradFieldresolution);
     
@@ -73,6 +83,14 @@ public:
     }
     
 	ofMatrix4x4 getWorldMatrix();
+
+	// Median raw depth of the ring of pixels just outside the ROI (the sandbox rim), 0 if not visible
+	float getRimDepth(){
+		lock();
+		float depth = rimDepth;
+		unlock();
+		return depth;
+	}
     
     int getNumAveragingSlots(){
         return numAveragingSlots;
@@ -91,10 +109,26 @@ public:
 		doInPaint = inp;
 	}
 
+	// The gradient field is computed on the GPU by the KinectProjector: skip the CPU gradient field
+	void setGPUGradientField(bool gpu)
+	{
+		gpuGradientField = gpu;
+	}
+
 	// Should the entire frame be filtered and thereby ignoring the KinectROI
-	void setFullFrameFiltering(bool ff, ofRectangle ROI);
+	void setFullFrameFiltering(bool ff, ofRectangle ROI, ofPixels ROIMask = ofPixels());
+
+	// Per pixel depth to elevation coefficients (see KinectProjector::elevationCoeffs)
+	void setElevationCoefficients(const vector<ofVec2f>& coeffs, float planeOffset)
+	{
+		elevationCoeffs = coeffs;
+		elevationOffset = planeOffset;
+	}
 
 	ofThreadChannel<ofFloatPixels> filtered;
+	ofThreadChannel<ofFloatPixels> elevation; // Elevation above the base plane of the filtered frame
+	ofThreadChannel<ofPixels> land; // 255 where the elevation is above the base plane, 0 in water
+	ofThreadChannel<ofFloatPixels> shoreDistance; // Signed distance to the shore in pixels, positive on land
 	ofThreadChannel<ofPixels> colored;
 	ofThreadChannel<ofVec2f*> gradient;
     
@@ -102,8 +136,15 @@ private:
 	void threadedFunction() override;
     void filter();
     bool isInsideROI(int x, int y); // test is x, y is inside ROI
+    void updateROISpans(); // Compute the per row/column extent of the ROI mask
+    void updateRimSamples(ofRectangle ROI);
+    void updateRimDepth();
     void applySpaceFilter();
     void updateGradientField();
+    void updateElevation();
+    void updateShoreDistance();
+    bool playNextFrame();
+    void recordFrame();
     
 	// A simple inpainting algorithm to remove outliers in the depth
 	// Since the shader has no way of filtering outliers (0 and 4000 values mainly) it creates visual artifacts if they are not 
@@ -130,11 +171,23 @@ private:
     unsigned int width, height; // Width and height of kinect frames
 	int minX, maxX; // , ROIwidth; // ROI definition
 	int minY, maxY; //, ROIheight;
+	ofPixels ROIMask; // Sand area mask inside the ROI (not allocated: the whole ROI rectangle is used)
+	vector<int> ROIRowStart, ROIRowEnd; // First and last+1 pixel of the mask on each row
+	vector<int> ROIColStart, ROIColEnd; // First and last+1 pixel of the mask on each column
+	vector<int> rimSamples; // Pixel indices sampled on the sandbox rim
+	vector<RawDepth> rimValues;
+	float rimDepth;
     
     // General buffers
     ofxCvColorImage         kinectColorImage;
     ofShortPixels     kinectDepthImage;
     ofFloatPixels filteredframe;
+    ofFloatPixels elevationframe;
+    ofPixels landframe;
+    ofFloatPixels shoreframe;
+    cv::Mat waterMask, distanceToWater, distanceToLand; // Kept between frames to avoid reallocations
+    vector<ofVec2f> elevationCoeffs;
+    float elevationOffset;
     ofVec2f* gradField;
     
     // Filtering buffers
@@ -167,6 +220,14 @@ private:
 	bool doInPaint;
 
 	bool doFullFrameFiltering;
+	bool gpuGradientField;
+
+	// Recorded depth frames
+	bool playback;
+	vector<std::string> playbackFiles;
+	size_t playbackIndex;
+	std::string recordingDir;
+	int recordedFrames;
     // Debug
 //    int blockX, blockY;
 };
@@ -22,10 +22,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 ***********************************************************************/
 
 #include "KinectProjector.h"
+#include "../FrameClock.h"
 #include <sstream>
 
 using namespace ofxCSG;
 
+// Histogram of the distances to the fitted plane used by the robust plane fit
+static const int DepthPlaneHistogramBins = 400;
+static const float DepthPlaneHistogramBinSize = 0.25f; // mm
+
 KinectProjector::KinectProjector(std::shared_ptr<ofAppBaseWindow> const& p)
 :ROIcalibrated(false),
 projKinectCalibrated(false),
@@ -33,7 +38,7 @@ projKinectCalibrated(false),
 basePlaneUpdated (false),
 basePlaneComputed(false),
 projKinectCalibrationUpdated (false),
-//ROIUpdated (false),
+ROIUpdated (false),
 imageStabilized (false),
 waitingForFlattenSand (false),
 drawKinectView(false),
@@ -43,8 +48,34 @@ drawKinectColorView(true)
 	applicationState = APPLICATION_STATE_SETUP;
     projWindow = p;
 	TemporalFilteringType = 1;
+	TemporalFrameFilter = std::make_shared<CTemporalFrameFilter>();
+	chessboardDetectionPending = false;
+	chessboardDetectionId = 0;
+	doOnlineCalibration = false;
+	onlineCalibState = ONLINE_CALIB_STATE_WAIT;
+	onlineCalibInterval = 30;
+	onlineCalibLastTime = 0;
+	onlineCalibFrameCounter = 0;
+	fiducialDetectionId = 0;
+	kinectProjMatrixBlending = false;
+	basePlaneResidual = 0;
+	basePlaneInlierRatio = 1;
+	driftState = DRIFT_NONE;
+	rimDepthBaseline = 0;
+	driftLastRimCheck = 0;
+	driftLastPlaneCheck = 0;
+	rimDriftCount = 0;
+	planeDriftCount = 0;
+	fiducialDriftCount = 0;
+	basePlaneCalibGrabberReset = false;
+	projToKinectMapDirty = true;
+	projToKinectMapStep = 8;
+	projToKinectMapCols = 0;
+	projToKinectMapRows = 0;
+	newDepthFrame = false;
 	DumpDebugFiles = true;
 	DebugFileOutDir = "DebugFiles//";
+	recordingDepth = false;
 }
 
 void KinectProjector::setup(bool sdisplayGui)
@@ -64,6 +95,11 @@ void KinectProjector::setup(bool sdisplayGui)
     calibModal->setTheme(modalTheme);
     calibModal->addListener(this, &KinectProjector::onCalibModalEvent);
     calibModal->setButtonLabel("Cancel");
+
+    driftModal = make_shared<ofxModalConfirm>();
+    driftModal->setTheme(modalTheme);
+    driftModal->addListener(this, &KinectProjector::onDriftModalEvent);
+    driftModal->setButtonLabel("Ok");
         
 	displayGui = sdisplayGui;
 
@@ -71,6 +107,7 @@ void KinectProjector::setup(bool sdisplayGui)
 	chessboardSize = 300;
 	chessboardX = 5;
     chessboardY = 4;
+    fiducialSize = 150; // Online calibration chessboards use the same pattern at half size
     
     // 	Gradient Field
 	gradFieldResolution = 10;
@@ -97,6 +134,7 @@ void KinectProjector::setup(bool sdisplayGui)
 
 	doInpainting = false;
 	doFullFrameFiltering = false;
+	doGPUGradientField = false;
 	spatialFiltering = true;
     followBigChanges = false;
     numAveragingSlots = 15;
@@ -119,8 +157,15 @@ void KinectProjector::setup(bool sdisplayGui)
     kinectgrabber.setupFramefilter(gradFieldResolution, maxOffset, kinectROI, spatialFiltering, followBigChanges, numAveragingSlots);
     kinectWorldMatrix = kinectgrabber.getWorldMatrix();
     ofLogVerbose("KinectProjector") << "KinectProjector.setup(): kinectWorldMatrix: " << kinectWorldMatrix ;
+    updateKinectRays();
     
     // Setup gradient field
+#ifndef TARGET_OPENGLES
+    if (ofIsGLProgrammableRenderer())
+        gpuGradientField.loadShader("shaders/shadersGL3/");
+    else
+        gpuGradientField.loadShader("shaders/shadersGL2/");
+#endif
     setupGradientField();
     
     fboProjWindow.allocate(projRes.x, projRes.y, GL_RGBA);
@@ -138,12 +183,16 @@ void KinectProjector::setup(bool sdisplayGui)
         setupGui();
 
     kinectgrabber.start(); // Start the acquisition
+    chessboardDetector.start();
+    fiducialDetector.start();
 
 	updateStatusGUI();
 }
 
 void KinectProjector::exit(ofEventArgs& e)
 {
+	chessboardDetector.stop();
+	fiducialDetector.stop();
 	if (ROIcalibrated)
 	{
 		if (saveSettings())
@@ -165,6 +214,9 @@ void KinectProjector::setupGradientField(){
     for(unsigned int y=0;y<gradFieldrows;++y)
         for(unsigned int x=0;x<gradFieldcols;++x,++gfPtr)
             *gfPtr=ofVec2f(0);
+
+    // The GPU field differentiates the depth over the same distance as the grabber cells
+    gpuGradientField.setup(kinectRes.x, kinectRes.y, gradFieldResolution/2);
 }
 
 void KinectProjector::setGradFieldResolution(int sgradFieldResolution){
@@ -201,9 +253,14 @@ void KinectProjector::updateStatusGUI()
 		StatusGUI->getLabel("ROI Status")->setLabelColor(ofColor(255, 0, 0));
 	}
 
-	if (basePlaneComputed)
+	if (basePlaneComputed && (basePlaneResidual > 5 || basePlaneInlierRatio < 0.8))
 	{
-		StatusGUI->getLabel("Baseplane Status")->setLabel("Baseplane found");
+		StatusGUI->getLabel("Baseplane Status")->setLabel("Baseplane found - sand not flat (" + ofToString(basePlaneResidual, 1) + " mm)");
+		StatusGUI->getLabel("Baseplane Status")->setLabelColor(ofColor(255, 128, 0));
+	}
+	else if (basePlaneComputed)
+	{
+		StatusGUI->getLabel("Baseplane Status")->setLabel("Baseplane found (" + ofToString(basePlaneResidual, 1) + " mm)");
 		StatusGUI->getLabel("Baseplane Status")->setLabelColor(ofColor(0, 255, 0));
 	}
 	else
@@ -223,6 +280,27 @@ void KinectProjector::updateStatusGUI()
 		StatusGUI->getLabel("Calibration Status")->setLabelColor(ofColor(255, 0, 0));
 	}
 
+	if (driftState == DRIFT_KINECT)
+	{
+		StatusGUI->getLabel("Drift Status")->setLabel("Drift: the Kinect moved");
+		StatusGUI->getLabel("Drift Status")->setLabelColor(ofColor(255, 0, 0));
+	}
+	else if (driftState == DRIFT_BASE_PLANE)
+	{
+		StatusGUI->getLabel("Drift Status")->setLabel("Drift: the sand box tilted");
+		StatusGUI->getLabel("Drift Status")->setLabelColor(ofColor(255, 0, 0));
+	}
+	else if (driftState == DRIFT_PROJECTION)
+	{
+		StatusGUI->getLabel("Drift Status")->setLabel("Drift: the projector moved");
+		StatusGUI->getLabel("Drift Status")->setLabelColor(ofColor(255, 0, 0));
+	}
+	else
+	{
+		StatusGUI->getLabel("Drift Status")->setLabel("No drift detected");
+		StatusGUI->getLabel("Drift Status")->setLabelColor(ofColor(0, 255, 0));
+	}
+
 	StatusGUI->getLabel("Projector Status")->setLabel("Projector " + ofToString(projRes.x) + " x " + ofToString(projRes.y));
 
 	std::string AppStatus = "Setup";
@@ -241,15 +319,19 @@ void KinectProjector::updateStatusGUI()
 	gui->getToggle("Quick reaction")->setChecked(followBigChanges);
 	gui->getToggle("Inpaint outliers")->setChecked(doInpainting);
 	gui->getToggle("Full Frame Filtering")->setChecked(doFullFrameFiltering);
+	gui->getToggle("GPU gradient field")->setChecked(doGPUGradientField);
+	gui->getToggle("Online calibration refinement")->setChecked(doOnlineCalibration);
 }
 
 void KinectProjector::update()
 {
     // Clear updated state variables
     basePlaneUpdated = false;
-//    ROIUpdated = false;
+    ROIUpdated = false;
     projKinectCalibrationUpdated = false;
 
+	updateKinectProjMatrixBlending();
+
 	// Try to open the kinect every 3. second if it is not yet open
 	float TimeStamp = ofGetElapsedTimef();
 	if (!kinectOpened && TimeStamp-lastKinectOpenTry > 3)
@@ -267,6 +349,7 @@ void KinectProjector::update()
 			kinectgrabber.setupFramefilter(gradFieldResolution, maxOffset, kinectROI, spatialFiltering, followBigChanges, numAveragingSlots);
 			kinectWorldMatrix = kinectgrabber.getWorldMatrix();
 			ofLogVerbose("KinectProjector") << "KinectProjector.update(): kinectWorldMatrix: " << kinectWorldMatrix;
+			updateKinectRays();
 
 			updateStatusGUI();
 		}
@@ -278,30 +361,56 @@ void KinectProjector::update()
 		StatusGUI->update();
 	}
 
-    // Get images from kinect grabber
+    // Get images from kinect grabber. The recorded frames are played in lockstep: each application
+    // frame waits for the next depth frame, so the simulations advance once per depth frame
+    bool lockstep = kinectgrabber.isPlayingBack();
     ofFloatPixels filteredframe;
-    if (kinectOpened && kinectgrabber.filtered.tryReceive(filteredframe)) 
+    newDepthFrame = false;
+    if (kinectOpened && (lockstep ? kinectgrabber.filtered.receive(filteredframe) : kinectgrabber.filtered.tryReceive(filteredframe)))
 	{
+		newDepthFrame = true;
 		fpsKinect.newFrame();
 		fpsKinectText->setText(ofToString(fpsKinect.getFps(), 2));
 
 		FilteredDepthImage.setFromPixels(filteredframe.getData(), kinectRes.x, kinectRes.y);
         FilteredDepthImage.updateTexture();
         
+        // Get elevation image and land mask of the same frame
+        // (sent right after the filtered frame, waited for in lockstep)
+        if (lockstep)
+        {
+            kinectgrabber.elevation.receive(elevationImage);
+            kinectgrabber.land.receive(landImage);
+            kinectgrabber.shoreDistance.receive(shoreDistanceImage);
+        }
+        else
+        {
+            kinectgrabber.elevation.tryReceive(elevationImage);
+            kinectgrabber.land.tryReceive(landImage);
+            kinectgrabber.shoreDistance.tryReceive(shoreDistanceImage);
+        }
+
         // Get color image from kinect grabber
         ofPixels coloredframe;
-        if (kinectgrabber.colored.tryReceive(coloredframe)) 
+        bool newColorFrame = false;
+        if (lockstep ? kinectgrabber.colored.receive(coloredframe) : kinectgrabber.colored.tryReceive(coloredframe))
 		{
+            newColorFrame = true;
             kinectColorImage.setFromPixels(coloredframe);
 		
 			if (TemporalFilteringType == 0)
-				TemporalFrameFilter.NewFrame(kinectColorImage.getPixels().getData(), kinectColorImage.width, kinectColorImage.height);
+				TemporalFrameFilter->NewFrame(kinectColorImage.getPixels().getData(), kinectColorImage.width, kinectColorImage.height);
 			else if (TemporalFilteringType == 1)
-				TemporalFrameFilter.NewColFrame(kinectColorImage.getPixels().getData(), kinectColorImage.width, kinectColorImage.height);
+				TemporalFrameFilter->NewColFrame(kinectColorImage.getPixels().getData(), kinectColorImage.width, kinectColorImage.height);
 		}
 
         // Get gradient field from kinect grabber
-        kinectgrabber.gradient.tryReceive(gradField);
+        if (lockstep)
+            kinectgrabber.gradient.receive(gradField);
+        else
+            kinectgrabber.gradient.tryReceive(gradField);
+        if (doGPUGradientField)
+            updateGPUGradientField();
         
         // Update grabber stored frame number
         kinectgrabber.lock();
@@ -318,6 +427,12 @@ void KinectProjector::update()
         } 
 		else 
 		{
+			if (applicationState == APPLICATION_STATE_RUNNING)
+			{
+				updateOnlineCalibration(newColorFrame);
+				updateDriftMonitor();
+			}
+
 			//ofEnableAlphaBlending();
 			fboMainWindow.begin();
             if (drawKinectView || drawKinectColorView)
@@ -371,6 +486,10 @@ void KinectProjector::update()
 	{
 		ofClear(255, 255, 255, 0);
 	}
+	if (applicationState == APPLICATION_STATE_RUNNING && onlineCalibState == ONLINE_CALIB_STATE_SHOW_FIDUCIAL)
+	{
+		drawFiducial();
+	}
 	if (doShowROIonProjector && ROIcalibrated && kinectOpened)
 	{
 		ofNoFill();
@@ -405,6 +524,9 @@ void KinectProjector::update()
 		ofBackground(255); // Set to white in setup mode
 	}
 	fboProjWindow.end();
+
+	if (projKinectCalibrationUpdated || basePlaneUpdated || ROIUpdated)
+		projToKinectMapDirty = true;
 }
 
 void KinectProjector::mousePressed(int x, int y, int button)
@@ -449,6 +571,7 @@ void KinectProjector::mouseReleased(int x, int y, int button)
 
 			ofRectangle tempRect(xmin, ymin, xmax - xmin, ymax - ymin);
 			kinectROI = tempRect;
+			kinectROIPolygon.clear();
 			setNewKinectROI();
 			ROICalibState = ROI_CALIBRATION_STATE_DONE;
 			calibrationText = "Manual ROI defined";
@@ -493,6 +616,8 @@ void KinectProjector::updateCalibration()
         updateProjKinectAutoCalibration();
     }else if (calibrationState == CALIBRATION_STATE_PROJ_KINECT_MANUAL_CALIBRATION) {
         updateProjKinectManualCalibration();
+    } else if (calibrationState == CALIBRATION_STATE_BASE_PLANE_DETERMINATION) {
+        updateBasePlaneCalibration();
     }
 }
 
@@ -583,6 +708,8 @@ void KinectProjector::updateROIFromColorImage()
         }
         kinectROI = large.getBoundingBox();
         kinectROI.standardize();
+        kinectROIPolygon = large;
+        kinectROIPolygon.simplify();
         ofLogVerbose("KinectProjector") << "updateROIFromColorImage(): kinectROI : " << kinectROI ;
         ROICalibState = ROI_CALIBRATION_STATE_DONE;
         setNewKinectROI();
@@ -647,8 +774,9 @@ void KinectProjector::updateROIFromDepthImage(){
 			updateStatusGUI();
         } else {
             kinectROI = large.getBoundingBox();
-//            insideROIPoly = large.getResampledBySpacing(10);
             kinectROI.standardize();
+            kinectROIPolygon = large; // Keep the sand area outline and not only its bounding box
+            kinectROIPolygon.simplify();
             calibModal->setMessage("Sand area successfully detected");
             ofLogVerbose("KinectProjector") << "updateROIFromDepthImage(): final kinectROI : " << kinectROI ;
             setNewKinectROI();
@@ -674,6 +802,7 @@ void KinectProjector::updateROIFromFile()
 	{
 		xml.setTo("KINECTSETTINGS");
 		kinectROI = xml.getValue<ofRectangle>("kinectROI");
+		loadKinectROIPolygon(xml);
 		setNewKinectROI();
 		ROICalibState = ROI_CALIBRATION_STATE_DONE;
 		return;
@@ -698,18 +827,59 @@ void KinectProjector::setNewKinectROI()
     kinectROI.height = static_cast<int>(kinectROI.height);
     
 	ofLogVerbose("KinectProjector") << "setNewKinectROI : " << kinectROI;
+	updateKinectROIMask();
+	gpuGradientField.setKinectROIMask(kinectROIMask);
+	setGPUGradientField(doGPUGradientField); // The GPU field needs the mask
 
     // Update states variables
     ROIcalibrated = true;
-//    ROIUpdated = true;
+    ROIUpdated = true;
     saveCalibrationAndSettings();
-    updateKinectGrabberROI(kinectROI);
+    updateKinectGrabberROI(kinectROI, kinectROIMask);
 	updateStatusGUI();
 }
 
-void KinectProjector::updateKinectGrabberROI(ofRectangle ROI){
-    kinectgrabber.performInThread([ROI](KinectGrabber & kg) {
-        kg.setKinectROI(ROI);
+void KinectProjector::updateKinectROIMask()
+{
+	// Rasterize the sand area polygon, clipped to the kinect ROI rectangle
+	kinectROIMask.allocate(kinectRes.x, kinectRes.y, 1);
+	kinectROIMask.set(0);
+	cv::Mat mask = ofxCv::toCv(kinectROIMask);
+	cv::Rect ROIRect((int)kinectROI.x, (int)kinectROI.y, (int)kinectROI.width, (int)kinectROI.height);
+	if (kinectROIPolygon.size() < 3)
+	{
+		mask(ROIRect).setTo(255);
+		return;
+	}
+
+	vector<cv::Point> polyPts;
+	for (auto & p : kinectROIPolygon.getVertices())
+		polyPts.push_back(cv::Point((int)p.x, (int)p.y));
+	const cv::Point* pts = &polyPts[0];
+	int npts = polyPts.size();
+	cv::Mat polyMask = cv::Mat::zeros(mask.size(), CV_8UC1);
+	cv::fillPoly(polyMask, &pts, &npts, 1, cv::Scalar(255));
+	polyMask(ROIRect).copyTo(mask(ROIRect));
+
+	int inside = cv::countNonZero(mask);
+	ofLogVerbose("KinectProjector") << "updateKinectROIMask(): " << inside << " pixels inside the sand area (" << ROIRect.area() - inside << " skipped in ROI)";
+}
+
+bool KinectProjector::isInsideKinectROI(float x, float y)
+{
+	// Same pixels as the mask: first row and column included, last excluded
+	// (ofRectangle::inside excludes both borders)
+	if (x < kinectROI.x || x >= kinectROI.getRight() || y < kinectROI.y || y >= kinectROI.getBottom())
+		return false;
+	if (!kinectROIMask.isAllocated())
+		return true;
+	int idx = (int)y * kinectROIMask.getWidth() + (int)x;
+	return kinectROIMask.getData()[idx] != 0;
+}
+
+void KinectProjector::updateKinectGrabberROI(ofRectangle ROI, ofPixels ROIMask){
+    kinectgrabber.performInThread([ROI, ROIMask](KinectGrabber & kg) {
+        kg.setKinectROI(ROI, ROIMask);
     });
 //    while (kinectgrabber.isImageStabilized()){
 //    } // Wait for kinectgrabber to reset buffers
@@ -804,6 +974,10 @@ void KinectProjector::updateProjKinectAutoCalibration()
         upframe = false;
         trials = 0;
 		TemporalFrameCounter = 0;
+		chessboardDetectionPending = false; // Results of an aborted calibration are ignored
+		chessboardDetectionId++;
+		pairsKinect.clear(); // Point pairs of a previous calibration are not reused
+		pairsProjector.clear();
 
 		ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; //
 		drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
@@ -812,11 +986,26 @@ void KinectProjector::updateProjKinectAutoCalibration()
     } 
 	else if (autoCalibState == AUTOCALIB_STATE_NEXT_POINT && imageStabilized)
 	{
+		if (chessboardDetectionPending)
+		{
+			// The chessboard is searched by the detector thread - we keep on acquiring frames meanwhile
+			ChessboardDetectionResult result;
+			while (chessboardDetector.results.tryReceive(result))
+			{
+				if (result.id != chessboardDetectionId)
+					continue; // From an aborted calibration
+				chessboardDetectionPending = false;
+				spareTemporalFrameFilter = result.frameFilter;
+				processChessboardDetection(result);
+			}
+			return;
+		}
+
 		if (!(TemporalFrameCounter % 20))
-			ofLogVerbose("KinectProjector") << "autoCalib(): Got frame " + ofToString(TemporalFrameCounter) + " / " + ofToString(TemporalFrameFilter.getBufferSize() + 3) + " for temporal filter";
+			ofLogVerbose("KinectProjector") << "autoCalib(): Got frame " + ofToString(TemporalFrameCounter) + " / " + ofToString(TemporalFrameFilter->getBufferSize() + 3) + " for temporal filter";
 
 		// We want to have a buffer of images that are only focusing on one chess pattern
-		if (TemporalFrameCounter++ > TemporalFrameFilter.getBufferSize() + 3)
+		if (TemporalFrameCounter++ > TemporalFrameFilter->getBufferSize() + 3)
 		{
 			CalibrateNextPoint();
 			TemporalFrameCounter = 0;
@@ -824,7 +1013,7 @@ void KinectProjector::updateProjKinectAutoCalibration()
 	}
 	else if (autoCalibState == AUTOCALIB_STATE_COMPUTE) 
 	{
-        updateKinectGrabberROI(kinectROI); // Goes back to kinectROI and maxoffset
+        updateKinectGrabberROI(kinectROI, kinectROIMask); // Goes back to kinectROI and maxoffset
         kinectgrabber.performInThread([this](KinectGrabber & kg) {
             kg.setMaxOffset(this->maxOffset);
         });
@@ -837,13 +1026,28 @@ void KinectProjector::updateProjKinectAutoCalibration()
 		else 
 		{
             ofLogVerbose("KinectProjector") << "autoCalib(): Calibrating" ;
-            kpt->calibrate(pairsKinect, pairsProjector);
+            if (!kpt->calibrate(pairsKinect, pairsProjector))
+			{
+				ofLogVerbose("KinectProjector") << "autoCalib(): No consistent projection matrix found";
+				projKinectCalibrated = false;
+				projKinectCalibrationUpdated = false;
+				applicationState = APPLICATION_STATE_SETUP;
+				calibrationText = "Calibration failed - no projection consistent with most points found";
+				updateStatusGUI();
+				return;
+			}
             kinectProjMatrix = kpt->getProjectionMatrix();
+            resetOnlineCalibration();
 
+			// Outlier pairs (wrongly detected chessboards) are rejected by the calibration
+			// and not counted in the reprojection error
 			double ReprojectionError = ComputeReprojectionError(DumpDebugFiles);
-			ofLogVerbose("KinectProjector") << "autoCalib(): ReprojectionError " + ofToString(ReprojectionError);
+			int nOutliers = pairsKinect.size() - kpt->getNumberOfInliers();
+			ofLogVerbose("KinectProjector") << "autoCalib(): ReprojectionError " + ofToString(ReprojectionError) + " with " + ofToString(nOutliers) + " outliers";
 
-			if (ReprojectionError > 50)
+			// The inliers are all closer than the RANSAC threshold, a mean error close to it
+			// means that the consensus is loose rather than a precise fit
+			if (ReprojectionError > kpt->getRansacThreshold() / 2)
 			{
 				ofLogVerbose("KinectProjector") << "autoCalib(): ReprojectionError too big. Something wrong with projection matrix";
 				projKinectCalibrated = false; 
@@ -860,6 +1064,8 @@ void KinectProjector::updateProjKinectAutoCalibration()
             projKinectCalibrationUpdated = true;
 			applicationState = APPLICATION_STATE_SETUP;
 			calibrationText = "Calibration successful";
+			if (nOutliers > 0)
+				calibrationText += " - " + ofToString(nOutliers) + " points rejected";
 
 			//saveCalibrationAndSettings(); // Already done in updateROIFromCalibration
 			if (kpt->saveCalibration("settings/calibration.xml"))
@@ -883,12 +1089,18 @@ void KinectProjector::updateProjKinectAutoCalibration()
 }
 
 // Compute the error when using the projection matrix to project calibration Kinect points into Project space
-// and comparing with calibration projector points
+// and comparing with calibration projector points. Only the pairs kept as inliers by the calibration are averaged
 double KinectProjector::ComputeReprojectionError(bool WriteFile)
 {
 	std::string oErrors = ofToDataPath(DebugFileOutDir + "CalibrationReprojectionErrors_" + GetTimeAndDateString() + ".txt");
 
+	vector<bool> inliers = kpt->getInliers();
+	if (inliers.size() != pairsKinect.size())
+		inliers.assign(pairsKinect.size(), true);
+
 	double PError = 0;
+	int nInliers = 0;
+	vector<double> errors(pairsKinect.size());
 
 	for (int i = 0; i < pairsKinect.size(); i++)
 	{
@@ -899,11 +1111,16 @@ double KinectProjector::ComputeReprojectionError(bool WriteFile)
 		ofVec2f projectedPoint(screenPos.x / screenPos.z, screenPos.y / screenPos.z);
 		ofVec2f projP = pairsProjector[i];
 
-		double D = sqrt((projectedPoint.x - projP.x) * (projectedPoint.x - projP.x) + (projectedPoint.y - projP.y) * (projectedPoint.y - projP.y));
+		errors[i] = sqrt((projectedPoint.x - projP.x) * (projectedPoint.x - projP.x) + (projectedPoint.y - projP.y) * (projectedPoint.y - projP.y));
 
-		PError += D;
+		if (inliers[i])
+		{
+			PError += errors[i];
+			nInliers++;
+		}
 	}
-	PError /= (double)pairsKinect.size();
+	if (nInliers > 0)
+		PError /= (double)nInliers;
 
 	if (WriteFile)
 	{
@@ -918,10 +1135,8 @@ double KinectProjector::ComputeReprojectionError(bool WriteFile)
 			ofVec2f projectedPoint(screenPos.x / screenPos.z, screenPos.y / screenPos.z);
 			ofVec2f projP = pairsProjector[i];
 
-			double D = sqrt((projectedPoint.x - projP.x) * (projectedPoint.x - projP.x) + (projectedPoint.y - projP.y) * (projectedPoint.y - projP.y));
-
 			fost2 << wc.x << ", " << wc.y << ", " << wc.z << ", "
-				<< projP.x << ", " << projP.y << ", " << projectedPoint.x << ", " << projectedPoint.y << ", " << D << std::endl;
+				<< projP.x << ", " << projP.y << ", " << projectedPoint.x << ", " << projectedPoint.y << ", " << errors[i] << ", " << inliers[i] << std::endl;
 		}
 	}
 
@@ -943,103 +1158,93 @@ void KinectProjector::CalibrateNextPoint()
 			updateStatusGUI();
 		}
 
-		// Current RGB frame - probably with rolling shutter problems
-		cvRgbImage = ofxCv::toCv(kinectColorImage.getPixels());
+		// Hand the acquired frames to the detector and keep on filling a second buffer
+		ChessboardDetectionRequest request;
+		request.id = ++chessboardDetectionId;
+		request.frameFilter = TemporalFrameFilter;
+		request.filteringType = TemporalFilteringType;
+		request.width = kinectColorImage.width;
+		request.height = kinectColorImage.height;
+		CheckAndNormalizeKinectROI();
+		request.kinectROI = kinectROI;
+		request.searchROI = getExpectedChessboardKinectROI(ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]);
+		request.patternSize = cv::Size(chessboardX - 1, chessboardY - 1);
 
-		ofxCvGrayscaleImage tempImage;
-		if (TemporalFilteringType == 0)
-			tempImage.setFromPixels(TemporalFrameFilter.getMedianFilteredImage(), kinectColorImage.width, kinectColorImage.height);
-		if (TemporalFilteringType == 1)
-			tempImage.setFromPixels(TemporalFrameFilter.getAverageFilteredColImage(), kinectColorImage.width, kinectColorImage.height);
-		
-		ProcessChessBoardInput(tempImage);
+		TemporalFrameFilter = spareTemporalFrameFilter ? spareTemporalFrameFilter : std::make_shared<CTemporalFrameFilter>();
+		spareTemporalFrameFilter.reset();
 
-		if (DumpDebugFiles)
-		{
-			std::string tname = DebugFileOutDir + "ChessboardImage_" + GetTimeAndDateString() + "_" + ofToString(currentCalibPts) + "_try_" + ofToString(trials) + ".png";
-			ofSaveImage(tempImage.getPixels(), tname);
+		chessboardDetectionPending = true;
+		chessboardDetector.requests.send(std::move(request));
+	}
+	else
+	{
+		if (upframe)
+		{ // We are done
+			calibrationText = "Updating acquisition ceiling";
+			updateMaxOffset(); // Find max offset
+			autoCalibState = AUTOCALIB_STATE_COMPUTE;
+			updateStatusGUI();
 		}
+		else
+		{ // We ask for higher points
+			calibModal->hide();
+			confirmModal->show();
+			confirmModal->setMessage("Please cover the sandbox with a board and press ok.");
+		}
+	}
+}
 
-		cvGrayImage = ofxCv::toCv(tempImage.getPixels());
+void KinectProjector::processChessboardDetection(ChessboardDetectionResult& result)
+{
+	if (DumpDebugFiles)
+	{
+		std::string tname = DebugFileOutDir + "ChessboardImage_" + GetTimeAndDateString() + "_" + ofToString(currentCalibPts) + "_try_" + ofToString(trials) + ".png";
+		ofSaveImage(result.image, tname);
+	}
 
-		cv::Rect tempROI((int)kinectROI.x, (int)kinectROI.y,(int)kinectROI.width, (int)kinectROI.height);
-		cv::Mat cvGrayROI = cvGrayImage(tempROI);
+	// Changed logic so the "cleared" flag is not used - we do a long frame average instead
+	if (result.found)
+	{
+		cvPoints = result.corners;
+		if (!result.foundInSearchROI)
+			ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard found outside of the expected area";
 
+		// Current RGB frame - probably with rolling shutter problems
+		cvRgbImage = ofxCv::toCv(kinectColorImage.getPixels());
 		cv::Size patternSize = cv::Size(chessboardX - 1, chessboardY - 1);
-	//	int chessFlags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_FAST_CHECK;
-		int chessFlags = 0;
+		drawChessboardCorners(cvRgbImage, patternSize, cv::Mat(cvPoints), result.found);
 
-		//bool foundChessboard = findChessboardCorners(cvGrayImage, patternSize, cvPoints, chessFlags);
-		bool foundChessboard = findChessboardCorners(cvGrayROI, patternSize, cvPoints, chessFlags);
-
-		if (!foundChessboard)
+		if (DumpDebugFiles)
 		{
-			int chessFlags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_FAST_CHECK;
-			foundChessboard = findChessboardCorners(cvGrayROI, patternSize, cvPoints, chessFlags);
+			std::string tname = DebugFileOutDir + "FoundChessboard_" + GetTimeAndDateString() + "_" + ofToString(currentCalibPts) + "_try_" + ofToString(trials) + ".png";
+			ofSaveImage(kinectColorImage.getPixels(), tname);
 		}
 
-		// Changed logic so the "cleared" flag is not used - we do a long frame average instead
-		if (foundChessboard)
-		{
-			for (int i = 0; i < cvPoints.size(); i++)
-			{
-				cvPoints[i].x += tempROI.x;
-				cvPoints[i].y += tempROI.y;
-			}
-
-			cornerSubPix(cvGrayImage, cvPoints, cv::Size(2, 2), cv::Size(-1, -1),   // Rasmus: changed search size to 2 from 11 - since this caused false findings
-				cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-
-			drawChessboardCorners(cvRgbImage, patternSize, cv::Mat(cvPoints), foundChessboard);
-
-			if (DumpDebugFiles)
-			{
-				std::string tname = DebugFileOutDir + "FoundChessboard_" + GetTimeAndDateString() + "_" + ofToString(currentCalibPts) + "_try_" + ofToString(trials) + ".png";
-				ofSaveImage(kinectColorImage.getPixels(), tname);
-			}
-
-			kinectColorImage.updateTexture();
-			fboMainWindow.begin();
-			kinectColorImage.draw(0, 0);
-			fboMainWindow.end();
+		kinectColorImage.updateTexture();
+		fboMainWindow.begin();
+		kinectColorImage.draw(0, 0);
+		fboMainWindow.end();
 
-			ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard found for point :" << currentCalibPts;
-			bool okchess = addPointPair();
+		ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard found for point :" << currentCalibPts;
+		bool okchess = addPointPair();
 
-			if (okchess)
-			{
-				trials = 0;
-				currentCalibPts++;
-				ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; // Compute next chessboard position
-				drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
-			}
-			else
-			{
-				// We cannot get all depth points for the chessboard
-				trials++;
-				ofLogVerbose("KinectProjector") << "autoCalib(): Depth points of chessboard not allfound on trial : " << trials;
-				if (trials > 3)
-				{
-					// Move the chessboard closer to the center of the screen
-					ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard could not be found moving chessboard closer to center ";
-					autoCalibPts[currentCalibPts] = 4 * autoCalibPts[currentCalibPts] / 5;
-					ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; // Compute next chessboard position
-					drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
-					trials = 0;
-				}
-			}
+		if (okchess)
+		{
+			trials = 0;
+			currentCalibPts++;
+			ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; // Compute next chessboard position
+			drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
 		}
 		else
 		{
-			// We cannot find the chessboard
+			// We cannot get all depth points for the chessboard
 			trials++;
-			ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard not found on trial : " << trials;
-			if (trials > 3) 
+			ofLogVerbose("KinectProjector") << "autoCalib(): Depth points of chessboard not allfound on trial : " << trials;
+			if (trials > 3)
 			{
 				// Move the chessboard closer to the center of the screen
 				ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard could not be found moving chessboard closer to center ";
-				autoCalibPts[currentCalibPts] = 3 * autoCalibPts[currentCalibPts] / 4;
-
+				autoCalibPts[currentCalibPts] = 4 * autoCalibPts[currentCalibPts] / 5;
 				ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; // Compute next chessboard position
 				drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
 				trials = 0;
@@ -1048,20 +1253,444 @@ void KinectProjector::CalibrateNextPoint()
 	}
 	else
 	{
-		if (upframe)
-		{ // We are done
-			calibrationText = "Updating acquisition ceiling";
-			updateMaxOffset(); // Find max offset
-			autoCalibState = AUTOCALIB_STATE_COMPUTE;
-			updateStatusGUI();
+		// We cannot find the chessboard
+		trials++;
+		ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard not found on trial : " << trials;
+		if (trials > 3) 
+		{
+			// Move the chessboard closer to the center of the screen
+			ofLogVerbose("KinectProjector") << "autoCalib(): Chessboard could not be found moving chessboard closer to center ";
+			autoCalibPts[currentCalibPts] = 3 * autoCalibPts[currentCalibPts] / 4;
+
+			ofPoint dispPt = ofPoint(projRes.x / 2, projRes.y / 2) + autoCalibPts[currentCalibPts]; // Compute next chessboard position
+			drawChessboard(dispPt.x, dispPt.y, chessboardSize); // We can now draw the next chess board
+			trials = 0;
 		}
+	}
+}
+
+// Expected area of the chessboard in the kinect image. It is predicted from the chessboards found so far
+// The whole kinect ROI is returned when there is not enough chessboards yet
+ofRectangle KinectProjector::getExpectedChessboardKinectROI(ofPoint chessboardCenter)
+{
+	if (pairsProjector.size() < 6)
+		return kinectROI;
+
+	// Least squares affine mapping from projector coordinates to kinect coordinates
+	cv::Mat A(pairsProjector.size(), 3, CV_64F);
+	cv::Mat B(pairsProjector.size(), 2, CV_64F);
+	for (int i = 0; i < pairsProjector.size(); i++)
+	{
+		ofVec2f kc = worldCoordTokinectCoord(pairsKinect[i]);
+		A.at<double>(i, 0) = pairsProjector[i].x;
+		A.at<double>(i, 1) = pairsProjector[i].y;
+		A.at<double>(i, 2) = 1;
+		B.at<double>(i, 0) = kc.x;
+		B.at<double>(i, 1) = kc.y;
+	}
+	cv::Mat X;
+	if (!cv::solve(A, B, X, cv::DECOMP_SVD))
+		return kinectROI;
+
+	ofRectangle expectedROI;
+	float hs = chessboardSize / 2;
+	ofPoint corners[4] = { ofPoint(-hs, -hs), ofPoint(hs, -hs), ofPoint(hs, hs), ofPoint(-hs, hs) };
+	for (int i = 0; i < 4; i++)
+	{
+		ofPoint p = chessboardCenter + corners[i];
+		ofPoint kc(X.at<double>(0, 0) * p.x + X.at<double>(1, 0) * p.y + X.at<double>(2, 0),
+			X.at<double>(0, 1) * p.x + X.at<double>(1, 1) * p.y + X.at<double>(2, 1));
+		if (i == 0)
+			expectedROI = ofRectangle(kc, 0, 0);
 		else
-		{ // We ask for higher points
-			calibModal->hide();
-			confirmModal->show();
-			confirmModal->setMessage("Please cover the sandbox with a board and press ok.");
+			expectedROI.growToInclude(kc);
+	}
+
+	// Margin for the parallax of the high chessboards and the prediction errors
+	float margin = std::max(expectedROI.width, expectedROI.height) / 2;
+	expectedROI.x -= margin;
+	expectedROI.y -= margin;
+	expectedROI.width += 2 * margin;
+	expectedROI.height += 2 * margin;
+	expectedROI = expectedROI.getIntersection(kinectROI);
+	ofLogVerbose("KinectProjector") << "getExpectedChessboardKinectROI(): " << expectedROI;
+	if (expectedROI.width < 10 || expectedROI.height < 10)
+		return kinectROI;
+	return expectedROI;
+}
+
+void KinectProjector::resetOnlineCalibration()
+{
+	// Pairs and pending detections refer to the previous calibration
+	kinectProjMatrixBlending = false;
+	onlinePairsKinect.clear();
+	onlinePairsProjector.clear();
+	onlineCalibState = ONLINE_CALIB_STATE_WAIT;
+	onlineCalibLastTime = FrameClock::getElapsedTimef();
+	fiducialDetectionId++;
+}
+
+void KinectProjector::updateOnlineCalibration(bool newColorFrame)
+{
+	if (onlineCalibState == ONLINE_CALIB_STATE_WAIT)
+	{
+		if (doOnlineCalibration && projKinectCalibrated && imageStabilized &&
+			FrameClock::getElapsedTimef() - onlineCalibLastTime > onlineCalibInterval)
+		{
+			startFiducial();
+		}
+	}
+	else if (onlineCalibState == ONLINE_CALIB_STATE_SHOW_FIDUCIAL)
+	{
+		if (!newColorFrame)
+			return;
+
+		// Skip the first frames where the fiducial may not be projected yet
+		if (onlineCalibFrameCounter++ < 3)
+			return;
+
+		fiducialFrameFilter->NewFrame(kinectColorImage.getPixels().getData(), kinectColorImage.width, kinectColorImage.height, 5);
+		if (fiducialFrameFilter->isValid())
+		{
+			ChessboardDetectionRequest request;
+			request.id = ++fiducialDetectionId;
+			request.frameFilter = fiducialFrameFilter;
+			request.filteringType = 0;
+			request.width = kinectColorImage.width;
+			request.height = kinectColorImage.height;
+			request.kinectROI = kinectROI;
+			request.searchROI = getExpectedFiducialKinectROI();
+			request.patternSize = cv::Size(chessboardX - 1, chessboardY - 1);
+			fiducialFrameFilter.reset();
+
+			onlineCalibState = ONLINE_CALIB_STATE_DETECT; // The fiducial is not drawn anymore
+			fiducialDetector.requests.send(std::move(request));
+		}
+	}
+	else if (onlineCalibState == ONLINE_CALIB_STATE_DETECT)
+	{
+		ChessboardDetectionResult result;
+		while (fiducialDetector.results.tryReceive(result))
+		{
+			if (result.id != fiducialDetectionId)
+				continue; // Detection requested before a new calibration
+			processFiducialDetection(result);
+			onlineCalibState = ONLINE_CALIB_STATE_WAIT;
+			onlineCalibLastTime = FrameClock::getElapsedTimef();
+		}
+	}
+}
+
+void KinectProjector::startFiducial()
+{
+	// Random location inside the projected sand area
+	ofRectangle projROI = getProjectorSandROI();
+	if (projROI.width <= fiducialSize || projROI.height <= fiducialSize)
+	{
+		onlineCalibLastTime = FrameClock::getElapsedTimef();
+		return;
+	}
+	float x = ofRandom(projROI.getMinX() + fiducialSize / 2, projROI.getMaxX() - fiducialSize / 2);
+	float y = ofRandom(projROI.getMinY() + fiducialSize / 2, projROI.getMaxY() - fiducialSize / 2);
+
+	// Inner corners, in the order the chessboard detector returns them
+	float xf = x - fiducialSize / 2;
+	float yf = y - fiducialSize / 2;
+	fiducialProjectorPoints.clear();
+	for (int j = 1; j < chessboardY; j++)
+	{
+		for (int i = 1; i < chessboardX; i++)
+		{
+			fiducialProjectorPoints.push_back(ofVec2f(xf + ofMap(i, 0, chessboardX, 0, fiducialSize), yf + ofMap(j, 0, chessboardY, 0, fiducialSize)));
+		}
+	}
+
+	fiducialFrameFilter = std::make_shared<CTemporalFrameFilter>();
+	onlineCalibFrameCounter = 0;
+	onlineCalibState = ONLINE_CALIB_STATE_SHOW_FIDUCIAL;
+}
+
+// Draw the fiducial with a white border on the projector window - must be called between fboProjWindow.begin() and end()
+void KinectProjector::drawFiducial()
+{
+	ofPushStyle();
+	ofPushMatrix();
+	ofFill();
+	float w = (float)fiducialSize / chessboardX;
+	float h = (float)fiducialSize / chessboardY;
+	ofVec2f topLeft = fiducialProjectorPoints[0] - ofVec2f(w, h);
+
+	ofSetColor(255);
+	ofDrawRectangle(topLeft.x - w / 2, topLeft.y - h / 2, fiducialSize + w, fiducialSize + h);
+	ofSetColor(0);
+	ofTranslate(topLeft);
+	for (int j = 0; j < chessboardY; j++)
+	{
+		for (int i = 0; i < chessboardX; i++)
+		{
+			if ((i + j) % 2 == 0)
+				ofDrawRectangle(ofMap(i, 0, chessboardX, 0, fiducialSize), ofMap(j, 0, chessboardY, 0, fiducialSize), w, h);
 		}
 	}
+	ofPopMatrix();
+	ofPopStyle();
+}
+
+// Kinect pixels currently projected around the fiducial
+ofRectangle KinectProjector::getExpectedFiducialKinectROI()
+{
+	ofRectangle fiducialRect(fiducialProjectorPoints.front(), fiducialProjectorPoints.back());
+	fiducialRect.standardize();
+	fiducialRect.scaleFromCenter(2);
+
+	ofRectangle expectedROI;
+	bool found = false;
+	int step = 4;
+	for (int y = kinectROI.getMinY(); y < kinectROI.getMaxY(); y += step)
+	{
+		for (int x = kinectROI.getMinX(); x < kinectROI.getMaxX(); x += step)
+		{
+			if (!fiducialRect.inside(kinectCoordToProjCoord(x, y)))
+				continue;
+			if (!found)
+				expectedROI = ofRectangle(x, y, step, step);
+			else
+				expectedROI.growToInclude(ofRectangle(x, y, step, step));
+			found = true;
+		}
+	}
+	if (!found)
+		return kinectROI;
+	expectedROI = expectedROI.getIntersection(kinectROI);
+	if (expectedROI.width < 10 || expectedROI.height < 10)
+		return kinectROI;
+	return expectedROI;
+}
+
+void KinectProjector::processFiducialDetection(ChessboardDetectionResult& result)
+{
+	int n = fiducialProjectorPoints.size();
+	if (!result.found || result.corners.size() != n)
+	{
+		ofLogVerbose("KinectProjector") << "processFiducialDetection(): fiducial not found";
+		return;
+	}
+
+	// The corners can be returned in reverse order: keep the order matching the current calibration
+	vector<ofVec3f> worldPoints;
+	double error = 0;
+	double reversedError = 0;
+	for (int i = 0; i < n; i++)
+	{
+		ofVec3f wc = kinectCoordToWorldCoord(result.corners[i].x, result.corners[i].y);
+		worldPoints.push_back(wc);
+		ofVec2f projectedPoint = worldCoordToProjCoord(wc);
+		error += projectedPoint.distance(fiducialProjectorPoints[i]);
+		reversedError += projectedPoint.distance(fiducialProjectorPoints[n - 1 - i]);
+	}
+	bool reversed = reversedError < error;
+	error = std::min(error, reversedError) / n;
+	updateFiducialDrift(error);
+
+	// A large error is a wrong detection or a moved projector that needs a full calibration
+	if (error > 30)
+	{
+		ofLogVerbose("KinectProjector") << "processFiducialDetection(): fiducial error too big: " << error << " pixels";
+		return;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		onlinePairsKinect.push_back(worldPoints[i]);
+		onlinePairsProjector.push_back(fiducialProjectorPoints[reversed ? n - 1 - i : i]);
+	}
+	int maxPairs = 20 * n;
+	if (onlinePairsKinect.size() > maxPairs)
+	{
+		int nRemove = onlinePairsKinect.size() - maxPairs;
+		onlinePairsKinect.erase(onlinePairsKinect.begin(), onlinePairsKinect.begin() + nRemove);
+		onlinePairsProjector.erase(onlinePairsProjector.begin(), onlinePairsProjector.begin() + nRemove);
+	}
+
+	// Regularization towards the current calibration: 100 times the squared change of the normalized
+	// parameters is added to the squared errors of the pairs in normalized projector coordinates.
+	// The refined calibration is only blended in and saved if it lowers the error on the pairs held out of the fit
+	if (!kpt->refine(onlinePairsKinect, onlinePairsProjector, 100))
+		return;
+
+	ofLogVerbose("KinectProjector") << "processFiducialDetection(): fiducial error " << error << " pixels, refined mean error "
+		<< kpt->getMeanInlierError() << " pixels on " << onlinePairsKinect.size() << " pairs";
+	kinectProjMatrixTarget = kpt->getProjectionMatrix();
+	kinectProjMatrixBlending = true;
+
+	if (!kpt->saveCalibration("settings/calibration.xml"))
+	{
+		ofLogVerbose("KinectProjector") << "processFiducialDetection(): Calibration could not be saved ";
+	}
+}
+
+// Move kinectProjMatrix towards the refined calibration so the projection does not jump
+void KinectProjector::updateKinectProjMatrixBlending()
+{
+	if (!kinectProjMatrixBlending)
+		return;
+
+	float* m = kinectProjMatrix.getPtr();
+	float* t = kinectProjMatrixTarget.getPtr();
+	float maxDiff = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		m[i] += (t[i] - m[i]) * 0.05f;
+		maxDiff = std::max(maxDiff, fabs(t[i] - m[i]) / std::max(fabs(t[i]), 1e-6f));
+	}
+	if (maxDiff < 1e-4)
+	{
+		kinectProjMatrix = kinectProjMatrixTarget;
+		kinectProjMatrixBlending = false;
+	}
+	projKinectCalibrationUpdated = true;
+}
+
+void KinectProjector::resetDriftBaseline()
+{
+	driftState = DRIFT_NONE;
+	rimDepthBaseline = 0; // Taken from the next rim depth received
+	driftLastRimCheck = FrameClock::getElapsedTimef();
+	driftLastPlaneCheck = driftLastRimCheck;
+	rimDriftCount = 0;
+	planeDriftCount = 0;
+	fiducialDriftCount = 0;
+}
+
+// Cheap checks done while the application is running. A drift has to be seen on several
+// consecutive checks so people playing in the sand do not raise it
+void KinectProjector::updateDriftMonitor()
+{
+	if (driftState != DRIFT_NONE)
+		return;
+
+	float TimeStamp = FrameClock::getElapsedTimef();
+	if (TimeStamp - driftLastRimCheck > 2)
+	{
+		driftLastRimCheck = TimeStamp;
+		float rimDepth = kinectgrabber.getRimDepth();
+		if (rimDepth > 0 && rimDepthBaseline == 0)
+		{
+			rimDepthBaseline = rimDepth;
+			ofLogVerbose("KinectProjector") << "updateDriftMonitor(): rim depth baseline " << rimDepthBaseline << " mm";
+		}
+		else if (rimDepth > 0)
+		{
+			if (fabs(rimDepth - rimDepthBaseline) > 20)
+				rimDriftCount++;
+			else
+				rimDriftCount = 0;
+			if (rimDriftCount >= 5)
+			{
+				ofLogVerbose("KinectProjector") << "updateDriftMonitor(): rim depth moved from " << rimDepthBaseline << " to " << rimDepth << " mm";
+				raiseDriftAlert(DRIFT_KINECT);
+				return;
+			}
+		}
+	}
+
+	if (TimeStamp - driftLastPlaneCheck > 30)
+	{
+		driftLastPlaneCheck = TimeStamp;
+		ofVec4f planeEq;
+		float residual, inlierRatio;
+		// The tilt can only be measured when the sand is roughly flat. Every 4th row and column
+		// is enough for a tilt of a few degrees and keeps the check cheap on the main thread
+		if (fitPlaneToDepthImage(planeEq, residual, inlierRatio, 4) && residual < 5 && inlierRatio > 0.8)
+		{
+			float angle = ofVec3f(planeEq).angle(basePlaneNormalBack);
+			if (angle > 3)
+				planeDriftCount++;
+			else
+				planeDriftCount = 0;
+			ofLogVerbose("KinectProjector") << "updateDriftMonitor(): sand plane tilted by " << angle << " degrees from the base plane";
+			if (planeDriftCount >= 3)
+				raiseDriftAlert(DRIFT_BASE_PLANE);
+		}
+	}
+}
+
+// Fiducials are projected with the current calibration: a growing error means the projector moved
+void KinectProjector::updateFiducialDrift(float error)
+{
+	if (driftState != DRIFT_NONE)
+		return;
+
+	if (error > 8)
+		fiducialDriftCount++;
+	else
+		fiducialDriftCount = 0;
+	if (fiducialDriftCount >= 3)
+	{
+		ofLogVerbose("KinectProjector") << "updateFiducialDrift(): fiducial error " << error << " pixels";
+		raiseDriftAlert(DRIFT_PROJECTION);
+	}
+}
+
+void KinectProjector::raiseDriftAlert(Drift_type type)
+{
+	driftState = type;
+	driftModal->setTitle("Calibration drift");
+	if (type == DRIFT_KINECT)
+		driftModal->setMessage("The Kinect seems to have moved. Press ok to detect the sand region again. The projector calibration has to be done afterwards.");
+	else if (type == DRIFT_BASE_PLANE)
+		driftModal->setMessage("The sand box seems to be tilted. Press ok to measure the sea level plane again.");
+	else if (type == DRIFT_PROJECTION)
+		driftModal->setMessage("The projector seems to have moved. Press ok to calibrate the projector again.");
+	driftModal->show();
+	ofLogVerbose("KinectProjector") << "raiseDriftAlert(): drift type " << type;
+	updateStatusGUI();
+}
+
+void KinectProjector::startBasePlaneCalibration()
+{
+	if (!kinectOpened || !ROIcalibrated)
+	{
+		ofLogVerbose("KinectProjector") << "startBasePlaneCalibration(): Kinect not running or ROI not defined";
+		return;
+	}
+	applicationState = APPLICATION_STATE_CALIBRATING;
+	calibrationState = CALIBRATION_STATE_BASE_PLANE_DETERMINATION;
+	basePlaneCalibGrabberReset = false;
+	calibrationText = "Starting sea level plane measurement";
+	confirmModal->setTitle("Measure sea level");
+	calibModal->setTitle("Measure sea level");
+	askToFlattenSand();
+	ofLogVerbose("KinectProjector") << "startBasePlaneCalibration(): Starting base plane measurement";
+	updateStatusGUI();
+}
+
+void KinectProjector::updateBasePlaneCalibration()
+{
+	if (!basePlaneCalibGrabberReset)
+	{
+		// Flush the frames averaged before the sand was flattened
+		updateKinectGrabberROI(kinectROI, kinectROIMask);
+		basePlaneCalibGrabberReset = true;
+		calibrationText = "Stabilizing acquisition";
+		updateStatusGUI();
+		return;
+	}
+	if (!imageStabilized)
+		return;
+
+	updateBasePlane();
+	if (!basePlaneComputed)
+	{
+		applicationState = APPLICATION_STATE_SETUP;
+		calibrationText = "Failed to acquire sea level plane";
+		updateStatusGUI();
+		return;
+	}
+	saveCalibrationAndSettings();
+	calibrationText = "Sea level plane estimated";
+	applicationState = APPLICATION_STATE_SETUP;
+	startApplication(); // Only the base plane changed: go back to the games
 }
 
 //TODO: Add manual Prj Kinect calibration
@@ -1087,34 +1716,17 @@ void KinectProjector::updateBasePlane()
 	basePlaneComputed = false;
 	updateStatusGUI();
 
-    ofRectangle smallROI = kinectROI;
-    smallROI.scaleFromCenter(0.75); // Reduce ROI to avoid problems with borders
-    ofLogVerbose("KinectProjector") << "updateBasePlane(): smallROI: " << smallROI ;
-    int sw = static_cast<int>(smallROI.width);
-    int sh = static_cast<int>(smallROI.height);
-    int sl = static_cast<int>(smallROI.getLeft());
-    int st = static_cast<int>(smallROI.getTop());
-    ofLogVerbose("KinectProjector") << "updateBasePlane(): sw: " << sw << " sh : " << sh << " sl : " << sl << " st : " << st << " sw*sh : " << sw*sh ;
-    if (sw*sh == 0) {
-        ofLogVerbose("KinectProjector") << "updateBasePlane(): smallROI is null, cannot compute base plane normal" ;
-        return;
-    }
-    ofVec4f pt;
-    ofVec3f* points;
-    points = new ofVec3f[sw*sh];
-    ofLogVerbose("KinectProjector") << "updateBasePlane(): Computing points in smallROI : " << sw*sh ;
-    for (int x = 0; x<sw; x++){
-        for (int y = 0; y<sh; y ++){
-            points[x+y*sw] = kinectCoordToWorldCoord(x+sl, y+st);
-        }
-    }
-    ofLogVerbose("KinectProjector") << "updateBasePlane(): Computing plane from points" ;
-    basePlaneEq = plane_from_points(points, sw*sh);
-	if (basePlaneEq.x == 0 && basePlaneEq.y == 0 && basePlaneEq.z == 0)
+	ofVec4f planeEq;
+	if (!fitPlaneToDepthImage(planeEq, basePlaneResidual, basePlaneInlierRatio))
 	{
-		ofLogVerbose("KinectProjector") << "updateBasePlane(): plane_from_points could not compute basePlane";
+		ofLogVerbose("KinectProjector") << "updateBasePlane(): could not compute basePlane";
 		return;
 	}
+	basePlaneEq = planeEq;
+	updateElevationCoefficients();
+	ofLogVerbose("KinectProjector") << "updateBasePlane(): residual " << basePlaneResidual << " mm on " << basePlaneInlierRatio * 100 << "% of the pixels";
+	if (basePlaneResidual > 5 || basePlaneInlierRatio < 0.8)
+		ofLogVerbose("KinectProjector") << "updateBasePlane(): the sand does not look flat";
 
     basePlaneNormal = ofVec3f(basePlaneEq);
     basePlaneOffset = ofVec3f(0,0,-basePlaneEq.w);
@@ -1126,51 +1738,140 @@ void KinectProjector::updateBasePlane()
 }
 
 void KinectProjector::updateMaxOffset(){
-    ofRectangle smallROI = kinectROI;
-    smallROI.scaleFromCenter(0.75); // Reduce ROI to avoid problems with borders
-    ofLogVerbose("KinectProjector") << "updateMaxOffset(): smallROI: " << smallROI ;
-    int sw = static_cast<int>(smallROI.width);
-    int sh = static_cast<int>(smallROI.height);
-    int sl = static_cast<int>(smallROI.getLeft());
-    int st = static_cast<int>(smallROI.getTop());
-    ofLogVerbose("KinectProjector") << "updateMaxOffset(): sw: " << sw << " sh : " << sh << " sl : " << sl << " st : " << st << " sw*sh : " << sw*sh ;
-    if (sw*sh == 0) {
-        ofLogVerbose("KinectProjector") << "updateMaxOffset(): smallROI is null, cannot compute base plane normal" ;
+    ofVec4f eqoff;
+    float residual, inlierRatio;
+    if (!fitPlaneToDepthImage(eqoff, residual, inlierRatio)) {
+        ofLogVerbose("KinectProjector") << "updateMaxOffset(): could not compute the ceiling plane" ;
         return;
     }
-    ofVec4f pt;
-    ofVec3f* points;
-    points = new ofVec3f[sw*sh];
-    ofLogVerbose("KinectProjector") << "updateMaxOffset(): Computing points in smallROI : " << sw*sh ;
-    for (int x = 0; x<sw; x++){
-        for (int y = 0; y<sh; y ++){
-            points[x+y*sw] = kinectCoordToWorldCoord(x+sl, y+st);//vertexCcvertexCc;
-        }
-    }
-    ofLogVerbose("KinectProjector") << "updateMaxOffset(): Computing plane from points" ;
-    ofVec4f eqoff = plane_from_points(points, sw*sh);
     maxOffset = -eqoff.w-maxOffsetSafeRange;
     maxOffsetBack = maxOffset;
     // Update max Offset
-    ofLogVerbose("KinectProjector") << "updateMaxOffset(): maxOffset" << maxOffset ;
+    ofLogVerbose("KinectProjector") << "updateMaxOffset(): maxOffset" << maxOffset << " residual " << residual << " mm on " << inlierRatio * 100 << "% of the pixels";
     kinectgrabber.performInThread([this](KinectGrabber & kg) {
         kg.setMaxOffset(this->maxOffset);
     });
 }
 
+// Robust plane fit on the depth image, in the central part of the sand area.
+// The pixels are streamed into a plane accumulator, then the fit is repeated on the pixels close to
+// the previous plane only (trimmed least squares) so hands, toys and heaps do not tilt the plane.
+// residual is the RMS distance of the kept pixels to the plane in mm and inlierRatio the fraction kept.
+// Only every sampleStep-th row and column is read
+bool KinectProjector::fitPlaneToDepthImage(ofVec4f& planeEq, float& residual, float& inlierRatio, int sampleStep)
+{
+    ofRectangle smallROI = kinectROI;
+    smallROI.scaleFromCenter(0.75); // Reduce ROI to avoid problems with borders
+    smallROI = smallROI.getIntersection(ofRectangle(0, 0, kinectRes.x, kinectRes.y));
+    ofLogVerbose("KinectProjector") << "fitPlaneToDepthImage(): smallROI: " << smallROI ;
+    if (smallROI.width < 1 || smallROI.height < 1) {
+        ofLogVerbose("KinectProjector") << "fitPlaneToDepthImage(): smallROI is null, cannot compute plane" ;
+        return false;
+    }
+
+    // Least squares fit on all the pixels
+    PlaneFitAccumulator accumulator;
+    double sumSquares;
+    int nValid = depthPlanePass(smallROI, ofVec4f(), FLT_MAX, &accumulator, nullptr, sumSquares, sampleStep);
+    planeEq = accumulator.fitPlane();
+    if (planeEq.x == 0 && planeEq.y == 0 && planeEq.z == 0)
+        return false;
+
+    // Histogram of the absolute distances to the plane, to get their median without storing them
+    int histogram[DepthPlaneHistogramBins + 1];
+    float threshold = FLT_MAX;
+    for (int iteration = 0; iteration < 3; iteration++)
+    {
+        depthPlanePass(smallROI, planeEq, FLT_MAX, nullptr, histogram, sumSquares, sampleStep);
+        int count = 0;
+        int bin = 0;
+        while (bin < DepthPlaneHistogramBins && count + histogram[bin] < nValid / 2)
+            count += histogram[bin++];
+        float median = (bin + 0.5f) * DepthPlaneHistogramBinSize;
+        threshold = std::max(3 * 1.4826f * median, 2.0f); // 3 robust standard deviations, at least 2 mm
+
+        accumulator.clear();
+        depthPlanePass(smallROI, planeEq, threshold, &accumulator, nullptr, sumSquares, sampleStep);
+        ofVec4f newPlaneEq = accumulator.fitPlane();
+        if (newPlaneEq.x == 0 && newPlaneEq.y == 0 && newPlaneEq.z == 0)
+            break;
+        planeEq = newPlaneEq;
+    }
+
+    // Quality of the fit
+    accumulator.clear();
+    depthPlanePass(smallROI, planeEq, threshold, &accumulator, nullptr, sumSquares, sampleStep);
+    residual = sqrt(sumSquares / std::max(accumulator.n, 1.0));
+    inlierRatio = nValid > 0 ? accumulator.n / nValid : 0;
+    return true;
+}
+
+// One pass over the valid depth pixels of ROI. If planeEq is not null, the distances to the plane are
+// added to histogram (if given) and only the pixels closer than threshold are accumulated.
+// Returns the number of valid pixels
+int KinectProjector::depthPlanePass(ofRectangle ROI, ofVec4f planeEq, float threshold, PlaneFitAccumulator* accumulator, int* histogram, double& sumSquares, int sampleStep)
+{
+    const float* depth = FilteredDepthImage.getFloatPixelsRef().getData();
+    const unsigned char* mask = kinectROIMask.isAllocated() ? kinectROIMask.getData() : nullptr;
+    int width = kinectRes.x;
+    bool usePlane = planeEq.x != 0 || planeEq.y != 0 || planeEq.z != 0;
+
+    // Per pixel ray: the world point is depth * (sx * x + ox, sy * y + oy, 1)
+    float sx = kinectWorldMatrix(0, 0);
+    float ox = kinectWorldMatrix(0, 3);
+    float sy = kinectWorldMatrix(1, 1);
+    float oy = kinectWorldMatrix(1, 3);
+
+    if (histogram)
+        std::fill(histogram, histogram + DepthPlaneHistogramBins + 1, 0);
+    sumSquares = 0;
+    int nValid = 0;
+    for (int y = ROI.getMinY(); y < ROI.getMaxY(); y += sampleStep)
+    {
+        const float* depthPtr = depth + y * width;
+        const unsigned char* maskPtr = mask ? mask + y * width : nullptr;
+        float ry = sy * y + oy;
+        for (int x = ROI.getMinX(); x < ROI.getMaxX(); x += sampleStep)
+        {
+            float z = depthPtr[x];
+            if (z <= 0 || z >= 4000 || (maskPtr && !maskPtr[x]))
+                continue;
+            nValid++;
+            ofVec3f p(z * (sx * x + ox), z * ry, z);
+            if (usePlane)
+            {
+                float d = fabs(planeEq.x * p.x + planeEq.y * p.y + planeEq.z * p.z + planeEq.w);
+                if (histogram)
+                    histogram[std::min((int)(d / DepthPlaneHistogramBinSize), DepthPlaneHistogramBins)]++;
+                if (d > threshold)
+                    continue;
+                sumSquares += d * d;
+            }
+            if (accumulator)
+                accumulator->add(p);
+        }
+    }
+    return nValid;
+}
+
 bool KinectProjector::addPointPair() {
     bool okchess = true;
     string resultMessage;
     ofLogVerbose("KinectProjector") << "addPointPair(): Adding point pair in kinect world coordinates" ;
+    int n = cvPoints.size();
+    vector<float> x(n), y(n), wx(n), wy(n), wz(n);
+    for (int i=0; i<n; i++) {
+        x[i] = cvPoints[i].x;
+        y[i] = cvPoints[i].y;
+    }
+    kinectCoordsToWorldCoords(n, x.data(), y.data(), nullptr, wx.data(), wy.data(), wz.data());
     int nDepthPoints = 0;
-    for (int i=0; i<cvPoints.size(); i++) {
-        ofVec3f worldPoint = kinectCoordToWorldCoord(cvPoints[i].x, cvPoints[i].y);
-        if (worldPoint.z > 0)   nDepthPoints++;
+    for (int i=0; i<n; i++) {
+        if (wz[i] > 0)   nDepthPoints++;
     }
     if (nDepthPoints == (chessboardX-1)*(chessboardY-1)) {
-        for (int i=0; i<cvPoints.size(); i++) {
-            ofVec3f worldPoint = kinectCoordToWorldCoord(cvPoints[i].x, cvPoints[i].y);
-            pairsKinect.push_back(worldPoint);
+        for (int i=0; i<n; i++) {
+            pairsKinect.push_back(ofVec3f(wx[i], wy[i], wz[i]));
             pairsProjector.push_back(currentProjectorPoints[i]);
         }
         resultMessage = "addPointPair(): Added " + ofToString((chessboardX-1)*(chessboardY-1)) + " points pairs.";
@@ -1251,6 +1952,8 @@ void KinectProjector::drawChessboard(int x, int y, int chessboardSize) {
 void KinectProjector::drawGradField()
 {
     ofClear(255, 0);
+    if (doGPUGradientField)
+        gpuGradientField.requestReadBack();
     for(int rowPos=0; rowPos< gradFieldrows ; rowPos++)
     {
         for(int colPos=0; colPos< gradFieldcols ; colPos++)
@@ -1259,7 +1962,7 @@ void KinectProjector::drawGradField()
             float y = rowPos*gradFieldResolution  + gradFieldResolution/2;
             ofVec2f projectedPoint = kinectCoordToProjCoord(x, y);
             int ind = colPos + rowPos * gradFieldcols;
-            ofVec2f v2 = gradField[ind];
+            ofVec2f v2 = (doGPUGradientField && gpuGradientField.hasField()) ? gpuGradientField.gradientAt(x, y) : gradField[ind];
             v2 *= arrowLength;
 
             ofSetColor(255,0,0,255);
@@ -1297,11 +2000,7 @@ ofVec2f KinectProjector::kinectCoordToProjCoord(float x, float y) // x, y in kin
 
 ofVec2f KinectProjector::kinectCoordToProjCoord(float x, float y, float z)
 {
-	ofVec4f kc = ofVec2f(x, y);
-	kc.z = z;
-	kc.w = 1;
-	ofVec4f wc = kinectWorldMatrix*kc*kc.z;
-
+	ofVec3f wc(z * (kinectWorldMatrix(0, 0) * x + kinectWorldMatrix(0, 3)), z * (kinectWorldMatrix(1, 1) * y + kinectWorldMatrix(1, 3)), z);
 	return worldCoordToProjCoord(wc);
 }
 
@@ -1331,7 +2030,8 @@ ofVec3f KinectProjector::projCoordAndWorldZToWorldCoord(float projX, float projY
 	return ofVec3f(x, y, worldZ);
 }
 
-ofVec3f KinectProjector::kinectCoordToWorldCoord(float x, float y) // x, y in kinect pixel coord
+// Index of the kinect pixel containing (x, y), clamped to the image
+int KinectProjector::kinectCoordToIndex(float x, float y)
 {
 	// Simple crash avoidence
 	if (y < 0)
@@ -1342,18 +2042,194 @@ ofVec3f KinectProjector::kinectCoordToWorldCoord(float x, float y) // x, y in ki
 		x = 0;
 	if (x >= kinectRes.x)
 		x = kinectRes.x - 1;
+	return static_cast<int>(y) * kinectRes.x + static_cast<int>(x);
+}
+
+ofVec3f KinectProjector::kinectCoordToWorldCoord(float x, float y) // x, y in kinect pixel coord
+{
+	// Simple crash avoidence
+	x = ofClamp(x, 0, kinectRes.x - 1);
+	y = ofClamp(y, 0, kinectRes.y - 1);
+	float z = FilteredDepthImage.getFloatPixelsRef().getData()[kinectCoordToIndex(x, y)];
+
+	// The ray is computed from the sub pixel position (calibration corners) instead of the lookup table
+	return ofVec3f(z * (kinectWorldMatrix(0, 0) * x + kinectWorldMatrix(0, 3)), z * (kinectWorldMatrix(1, 1) * y + kinectWorldMatrix(1, 3)), z);
+}
+
+void KinectProjector::kinectCoordsToWorldCoords(int n, const float* x, const float* y, const float* z, float* wx, float* wy, float* wz)
+{
+	const float* depth = FilteredDepthImage.getFloatPixelsRef().getData();
+	int width = kinectRes.x;
+	float maxX = kinectRes.x - 1;
+	float maxY = kinectRes.y - 1;
+	float sx = kinectWorldMatrix(0, 0);
+	float ox = kinectWorldMatrix(0, 3);
+	float sy = kinectWorldMatrix(1, 1);
+	float oy = kinectWorldMatrix(1, 3);
+
+	for (int i = 0; i < n; i++)
+	{
+		float xc = x[i];
+		float yc = y[i];
+		float d;
+		if (z)
+		{
+			d = z[i];
+		}
+		else
+		{
+			xc = ofClamp(xc, 0, maxX);
+			yc = ofClamp(yc, 0, maxY);
+			d = depth[static_cast<int>(yc) * width + static_cast<int>(xc)];
+		}
+		wx[i] = d * (sx * xc + ox);
+		wy[i] = d * (sy * yc + oy);
+		wz[i] = d;
+	}
+}
 
-    ofVec4f kc = ofVec2f(x, y);
-    int ind = static_cast<int>(y) * kinectRes.x + static_cast<int>(x);
-    kc.z = FilteredDepthImage.getFloatPixelsRef().getData()[ind];
-	//if (kc.z == 0)
-	//	ofLogVerbose("KinectProjector") << "kinectCoordToWorldCoord z coordinate 0";
-	//if (kc.z == 4000)
-	//	ofLogVerbose("KinectProjector") << "kinectCoordToWorldCoord z coordinate 4000 (invalid)";
+void KinectProjector::kinectCoordsToProjCoords(int n, const float* x, const float* y, const float* z, float* px, float* py)
+{
+	const float* depth = FilteredDepthImage.getFloatPixelsRef().getData();
+	int width = kinectRes.x;
+	float maxX = kinectRes.x - 1;
+	float maxY = kinectRes.y - 1;
+	float sx = kinectWorldMatrix(0, 0);
+	float ox = kinectWorldMatrix(0, 3);
+	float sy = kinectWorldMatrix(1, 1);
+	float oy = kinectWorldMatrix(1, 3);
+	const ofMatrix4x4& m = kinectProjMatrix;
+	float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2), m03 = m(0, 3);
+	float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2), m13 = m(1, 3);
+	float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2), m23 = m(2, 3);
+
+	for (int i = 0; i < n; i++)
+	{
+		float xc = x[i];
+		float yc = y[i];
+		float d;
+		if (z)
+		{
+			d = z[i];
+		}
+		else
+		{
+			xc = ofClamp(xc, 0, maxX);
+			yc = ofClamp(yc, 0, maxY);
+			d = depth[static_cast<int>(yc) * width + static_cast<int>(xc)];
+		}
+		float wx = d * (sx * xc + ox);
+		float wy = d * (sy * yc + oy);
+		float sX = m00 * wx + m01 * wy + m02 * d + m03;
+		float sY = m10 * wx + m11 * wy + m12 * d + m13;
+		float sZ = m20 * wx + m21 * wy + m22 * d + m23;
+		px[i] = sX / sZ;
+		py[i] = sY / sZ;
+	}
+}
 
-    kc.w = 1;
-    ofVec4f wc = kinectWorldMatrix*kc*kc.z;
-    return ofVec3f(wc);
+ofVec2f KinectProjector::projCoordToKinectCoord(float x, float y, bool onSand)
+{
+	if (projToKinectMapDirty)
+		updateProjToKinectMap();
+	if (projToKinectMap.empty())
+		return ofVec2f(0);
+
+	ofVec4f m;
+	float invDepth;
+	projToKinectMapAt(ofClamp(x, 0, projRes.x - 1), ofClamp(y, 0, projRes.y - 1), m, invDepth);
+	ofVec2f kc(m.x + m.z * invDepth, m.y + m.w * invDepth);
+	if (!onSand)
+		return kc;
+
+	// Move along the projector ray to the depth of the sand seen at the sea level point
+	float z = FilteredDepthImage.getFloatPixelsRef().getData()[kinectCoordToIndex(kc.x, kc.y)];
+	if (z <= 0 || z >= 4000)
+		return kc;
+	return ofVec2f(m.x + m.z / z, m.y + m.w / z);
+}
+
+// The world point seen at a projector pixel is linear in its depth: P(z) = P(0) + z * (P(1) - P(0)),
+// so its kinect coordinates are ((P(z).x / z) - ox) / sx = (P(1).x - P(0).x - ox) / sx + P(0).x / (sx * z)
+void KinectProjector::updateProjToKinectMap()
+{
+	projToKinectMapDirty = false;
+	if (!projKinectCalibrated)
+	{
+		projToKinectMap.clear();
+		projSeaLevelInvDepth.clear();
+		projectorSandROI = ofRectangle(0, 0, projRes.x, projRes.y);
+		return;
+	}
+
+	float sx = kinectWorldMatrix(0, 0);
+	float ox = kinectWorldMatrix(0, 3);
+	float sy = kinectWorldMatrix(1, 1);
+	float oy = kinectWorldMatrix(1, 3);
+	int width = projRes.x;
+	int height = projRes.y;
+	int step = projToKinectMapStep;
+	int cols = (width - 1) / step + 2;
+	int rows = (height - 1) / step + 2;
+	projToKinectMapCols = cols;
+	projToKinectMapRows = rows;
+	projToKinectMap.resize(cols * rows);
+	projSeaLevelInvDepth.resize(cols * rows);
+
+	// The sand ROI is the bounding box of the nodes on the sand, so it stays inside the sand area
+	float minX = width, minY = height, maxX = -1, maxY = -1;
+	for (int j = 0; j < rows; j++)
+	{
+		for (int i = 0; i < cols; i++)
+		{
+			int ind = j * cols + i;
+			int x = i * step;
+			int y = j * step;
+			ofVec3f p0 = projCoordAndWorldZToWorldCoord(x, y, 0);
+			ofVec3f p1 = projCoordAndWorldZToWorldCoord(x, y, 1) - p0;
+			projToKinectMap[ind] = ofVec4f((p1.x - ox) / sx, (p1.y - oy) / sy, p0.x / sx, p0.y / sy);
+
+			// Intersection of the ray with the base plane
+			float den = basePlaneEq.x * p1.x + basePlaneEq.y * p1.y + basePlaneEq.z;
+			float num = -(basePlaneEq.x * p0.x + basePlaneEq.y * p0.y + basePlaneEq.w);
+			float invDepth = (num != 0) ? den / num : 0;
+			projSeaLevelInvDepth[ind] = invDepth;
+
+			const ofVec4f& m = projToKinectMap[ind];
+			if (x < width && y < height && invDepth > 0 && isInsideKinectROI(m.x + m.z * invDepth, m.y + m.w * invDepth))
+			{
+				minX = std::min(minX, (float)x);
+				maxX = std::max(maxX, (float)x);
+				minY = std::min(minY, (float)y);
+				maxY = std::max(maxY, (float)y);
+			}
+		}
+	}
+	if (maxX >= minX && maxY >= minY)
+		projectorSandROI = ofRectangle(ofPoint(minX, minY), ofPoint(maxX + 1, maxY + 1));
+	else
+		projectorSandROI = ofRectangle();
+	ofLogVerbose("KinectProjector") << "updateProjToKinectMap(): projector sand ROI " << projectorSandROI;
+}
+
+// Bilinear interpolation of the inverse map at projector pixel (x, y)
+void KinectProjector::projToKinectMapAt(float x, float y, ofVec4f& m, float& invDepth)
+{
+	float fx = x / projToKinectMapStep;
+	float fy = y / projToKinectMapStep;
+	int i = std::min(static_cast<int>(fx), projToKinectMapCols - 2);
+	int j = std::min(static_cast<int>(fy), projToKinectMapRows - 2);
+	fx -= i;
+	fy -= j;
+	int ind = j * projToKinectMapCols + i;
+	float w00 = (1 - fx) * (1 - fy);
+	float w10 = fx * (1 - fy);
+	float w01 = (1 - fx) * fy;
+	float w11 = fx * fy;
+	m = projToKinectMap[ind] * w00 + projToKinectMap[ind + 1] * w10
+		+ projToKinectMap[ind + projToKinectMapCols] * w01 + projToKinectMap[ind + projToKinectMapCols + 1] * w11;
+	invDepth = projSeaLevelInvDepth[ind] * w00 + projSeaLevelInvDepth[ind + 1] * w10
+		+ projSeaLevelInvDepth[ind + projToKinectMapCols] * w01 + projSeaLevelInvDepth[ind + projToKinectMapCols + 1] * w11;
 }
 
 ofVec2f KinectProjector::worldCoordTokinectCoord(ofVec3f wc)
@@ -1365,35 +2241,107 @@ ofVec2f KinectProjector::worldCoordTokinectCoord(ofVec3f wc)
 
 ofVec3f KinectProjector::RawKinectCoordToWorldCoord(float x, float y) // x, y in kinect pixel coord
 {
-    ofVec4f kc = ofVec3f(x, y, kinectgrabber.getRawDepthAt(static_cast<int>(x), static_cast<int>(y)));
-    kc.w = 1;
-    ofVec4f wc = kinectWorldMatrix*kc*kc.z;
-    return ofVec3f(wc);
+    float z = kinectgrabber.getRawDepthAt(static_cast<int>(x), static_cast<int>(y));
+    const ofVec2f& ray = kinectRays[kinectCoordToIndex(x, y)];
+    return ofVec3f(z * ray.x, z * ray.y, z);
 }
 
 float KinectProjector::elevationAtKinectCoord(float x, float y) // x, y in kinect pixel coordinate
 {
-    ofVec4f wc = kinectCoordToWorldCoord(x, y);
-    wc.w = 1;
-    float elevation = -basePlaneEq.dot(wc);
-    return elevation;
+    int ind = kinectCoordToIndex(x, y);
+    if (elevationImage.isAllocated())
+        return elevationImage.getData()[ind];
+    float z = FilteredDepthImage.getFloatPixelsRef().getData()[ind];
+    return z * elevationCoeffs[ind].x - basePlaneEq.w;
 }
 
 float KinectProjector::elevationToKinectDepth(float elevation, float x, float y) // x, y in kinect pixel coordinate
 {
-    ofVec4f wc = kinectCoordToWorldCoord(x, y);
-    wc.z = 0;
-    wc.w = 1;
-    float kinectDepth = -(basePlaneEq.dot(wc)+elevation)/basePlaneEq.z;
-    return kinectDepth;
+    // Depth along the ray of the pixel where the elevation is reached
+    return (elevation + basePlaneEq.w) * elevationCoeffs[kinectCoordToIndex(x, y)].y;
+}
+
+void KinectProjector::updateKinectRays()
+{
+    int width = kinectRes.x;
+    int height = kinectRes.y;
+    float sx = kinectWorldMatrix(0, 0);
+    float ox = kinectWorldMatrix(0, 3);
+    float sy = kinectWorldMatrix(1, 1);
+    float oy = kinectWorldMatrix(1, 3);
+
+    kinectRays.resize(width * height);
+    ofVec2f* rayPtr = kinectRays.data();
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++, rayPtr++)
+            *rayPtr = ofVec2f(sx * x + ox, sy * y + oy);
+    updateElevationCoefficients();
+}
+
+// The elevation of a world point p is -basePlaneEq.(p, 1). Along the ray of a pixel it is linear in the depth
+void KinectProjector::updateElevationCoefficients()
+{
+    elevationCoeffs.resize(kinectRays.size());
+    for (int i = 0; i < kinectRays.size(); i++)
+    {
+        float k = -(basePlaneEq.x * kinectRays[i].x + basePlaneEq.y * kinectRays[i].y + basePlaneEq.z);
+        elevationCoeffs[i] = ofVec2f(k, k != 0 ? 1 / k : 0);
+    }
+
+    // The grabber computes the elevation image of each frame with the same coefficients
+    vector<ofVec2f> coeffs = elevationCoeffs;
+    float planeOffset = basePlaneEq.w;
+    kinectgrabber.performInThread([coeffs, planeOffset](KinectGrabber & kg) {
+        kg.setElevationCoefficients(coeffs, planeOffset);
+    });
+}
+
+float KinectProjector::shoreDistanceAtKinectCoord(float x, float y) // x, y in kinect pixel coordinate
+{
+    if (!shoreDistanceImage.isAllocated())
+        return elevationAtKinectCoord(x, y) > 0 ? 1000 : -1000;
+    return shoreDistanceImage.getData()[kinectCoordToIndex(x, y)];
+}
+
+// Direction of increasing shore distance: towards the inland for land pixels and towards the shore in water
+ofVec2f KinectProjector::shoreGradientAtKinectCoord(float x, float y)
+{
+    if (!shoreDistanceImage.isAllocated())
+        return ofVec2f(0);
+    x = ofClamp(x, 1, kinectRes.x - 2);
+    y = ofClamp(y, 1, kinectRes.y - 2);
+    const float* data = shoreDistanceImage.getData();
+    int ind = kinectCoordToIndex(x, y);
+    int width = kinectRes.x;
+    return ofVec2f(data[ind + 1] - data[ind - 1], data[ind + width] - data[ind - width]) * 0.5;
 }
 
 ofVec2f KinectProjector::gradientAtKinectCoord(float x, float y){
     int ind = static_cast<int>(floor(x/gradFieldResolution)) + gradFieldcols*static_cast<int>(floor(y/gradFieldResolution));
     fishInd = ind;
+    if (doGPUGradientField)
+        gpuGradientField.requestReadBack();
+    if (doGPUGradientField && gpuGradientField.hasField())
+        return gpuGradientField.gradientAt(ofClamp(x, 0, kinectRes.x-1), ofClamp(y, 0, kinectRes.y-1));
     return gradField[ind];
 }
 
+float KinectProjector::slopeAtKinectCoord(float x, float y){
+    if (doGPUGradientField)
+        gpuGradientField.requestReadBack();
+    if (doGPUGradientField && gpuGradientField.hasField())
+        return gpuGradientField.slopeAt(ofClamp(x, 0, kinectRes.x-1), ofClamp(y, 0, kinectRes.y-1));
+    return gradientAtKinectCoord(x, y).length();
+}
+
+// Run the gradient pass on the new depth frame. The field is read back only while gradientAtKinectCoord,
+// slopeAtKinectCoord or drawGradField ask for it, and is then the one of the previous frame: the copy had
+// a whole frame to complete so mapping it does not stall the pipeline
+void KinectProjector::updateGPUGradientField(){
+    ofVec2f depthTransformation(FilteredDepthImage.getNativeScaleMax()-FilteredDepthImage.getNativeScaleMin(), FilteredDepthImage.getNativeScaleMin());
+    gpuGradientField.update(FilteredDepthImage.getTexture(), getTransposedKinectWorldMatrix(), depthTransformation, basePlaneEq);
+}
+
 void KinectProjector::setupGui(){
     // instantiate and position the gui //
     gui = new ofxDatGui( ofxDatGuiAnchor::TOP_RIGHT );
@@ -1411,6 +2359,7 @@ void KinectProjector::setupGui(){
     advancedFolder->addToggle("Spatial filtering", spatialFiltering);
 	advancedFolder->addToggle("Inpaint outliers", doInpainting);
 	advancedFolder->addToggle("Full Frame Filtering", doFullFrameFiltering);
+	advancedFolder->addToggle("GPU gradient field", doGPUGradientField);
 	advancedFolder->addToggle("Quick reaction", followBigChanges);
     advancedFolder->addSlider("Averaging", 1, 40, numAveragingSlots)->setPrecision(0);
 	advancedFolder->addSlider("Tilt X", -30, 30, 0);
@@ -1424,6 +2373,7 @@ void KinectProjector::setupGui(){
 	calibrationFolder->addButton("Automatically calibrate kinect & projector");
 	calibrationFolder->addButton("Auto Adjust ROI");
 	calibrationFolder->addToggle("Show ROI on sand", doShowROIonProjector);
+	calibrationFolder->addToggle("Online calibration refinement", doOnlineCalibration);
 
 	//	advancedFolder->addButton("Draw ROI")->setName("Draw ROI");
  //   advancedFolder->addButton("Calibrate")->setName("Full Calibration");
@@ -1451,6 +2401,7 @@ void KinectProjector::setupGui(){
 	StatusGUI->addLabel("Baseplane Status");
 	StatusGUI->addLabel("Calibration Status");
 	StatusGUI->addLabel("Calibration Step");
+	StatusGUI->addLabel("Drift Status");
 	StatusGUI->addLabel("Projector Status");
 	StatusGUI->addHeader(":: Status ::", false);
 	StatusGUI->setAutoDraw(false);
@@ -1484,6 +2435,7 @@ void KinectProjector::startApplication()
 		{
 			ofLogVerbose("KinectProjector") << "KinectProjector.setup(): Calibration loaded ";
 			kinectProjMatrix = kpt->getProjectionMatrix();
+			resetOnlineCalibration();
 			ofLogVerbose("KinectProjector") << "KinectProjector.setup(): kinectProjMatrix: " << kinectProjMatrix;
 			projKinectCalibrated = true;
 			projKinectCalibrationUpdated = true;
@@ -1508,6 +2460,7 @@ void KinectProjector::startApplication()
 			basePlaneComputed = true;
 			setFullFrameFiltering(doFullFrameFiltering);
 			setInPainting(doInpainting);
+			setGPUGradientField(doGPUGradientField);
 			setFollowBigChanges(followBigChanges);
 			setSpatialFiltering(spatialFiltering);
 
@@ -1525,6 +2478,7 @@ void KinectProjector::startApplication()
 	}
 
 	ResetSeaLevel();
+	resetDriftBaseline();
 
 	// If all is well we are running
 	applicationState = APPLICATION_STATE_RUNNING;
@@ -1622,12 +2576,26 @@ void KinectProjector::setInPainting(bool inp) {
 }
 
 
+void KinectProjector::setGPUGradientField(bool gpu) {
+	doGPUGradientField = gpu;
+	if (gpu && !gpuGradientField.isReady())
+		ofLogWarning("KinectProjector") << "setGPUGradientField(): gradient field shader or sand area mask not ready, the grabber keeps computing the gradient field";
+	if (!gpu)
+		gpuGradientField.clear();
+	bool skipCPUField = gpu && gpuGradientField.isReady();
+	kinectgrabber.performInThread([skipCPUField](KinectGrabber & kg) {
+		kg.setGPUGradientField(skipCPUField);
+	});
+	updateStatusGUI();
+}
+
 void KinectProjector::setFullFrameFiltering(bool ff)
 {
 	doFullFrameFiltering = ff;
 	ofRectangle ROI = kinectROI;
-	kinectgrabber.performInThread([ff, ROI](KinectGrabber & kg) {
-		kg.setFullFrameFiltering(ff, ROI);
+	ofPixels ROIMask = kinectROIMask;
+	kinectgrabber.performInThread([ff, ROI, ROIMask](KinectGrabber & kg) {
+		kg.setFullFrameFiltering(ff, ROI, ROIMask);
 	});
 	updateStatusGUI();
 }
@@ -1640,6 +2608,14 @@ void KinectProjector::setFollowBigChanges(bool sfollowBigChanges){
 	updateStatusGUI();
 }
 
+void KinectProjector::setOnlineCalibration(bool online){
+	doOnlineCalibration = online;
+	if (!online && onlineCalibState == ONLINE_CALIB_STATE_SHOW_FIDUCIAL)
+		onlineCalibState = ONLINE_CALIB_STATE_WAIT;
+	onlineCalibLastTime = FrameClock::getElapsedTimef();
+	updateStatusGUI();
+}
+
 void KinectProjector::onButtonEvent(ofxDatGuiButtonEvent e){
     if (e.target->is("Full Calibration")) {
         startFullCalibration();
@@ -1687,6 +2663,7 @@ void KinectProjector::ResetSeaLevel()
 	basePlaneNormal = basePlaneNormalBack;
 	basePlaneOffset = basePlaneOffsetBack;
 	basePlaneEq = getPlaneEquation(basePlaneOffset, basePlaneNormal);
+	updateElevationCoefficients();
 	basePlaneUpdated = true;
 }
 
@@ -1703,6 +2680,14 @@ bool KinectProjector::getDumpDebugFiles()
 	return DumpDebugFiles;
 }
 
+void KinectProjector::toggleDepthRecording()
+{
+	recordingDepth = !recordingDepth;
+	std::string dir = recordingDepth ? "recordings/depth-" + GetTimeAndDateString() : "";
+	ofLogVerbose("KinectProjector") << "toggleDepthRecording(): " << (recordingDepth ? "recording the depth frames in " + dir : "recording stopped");
+	kinectgrabber.setDepthRecording(dir);
+}
+
 void KinectProjector::onToggleEvent(ofxDatGuiToggleEvent e){
     if (e.target->is("Spatial filtering")) {
 		setSpatialFiltering(e.checked);
@@ -1716,6 +2701,9 @@ void KinectProjector::onToggleEvent(ofxDatGuiToggleEvent e){
 	else if (e.target->is("Full Frame Filtering")) {
 		setFullFrameFiltering(e.checked);
 	}
+	else if (e.target->is("GPU gradient field")) {
+		setGPUGradientField(e.checked);
+	}
 	else if (e.target->is("Draw kinect depth view")){
         drawKinectView = e.checked;
 		if (drawKinectView)
@@ -1740,6 +2728,10 @@ void KinectProjector::onToggleEvent(ofxDatGuiToggleEvent e){
 	{
 		showROIonProjector(e.checked);
 	}
+	else if (e.target->is("Online calibration refinement"))
+	{
+		setOnlineCalibration(e.checked);
+	}
 }
 
 void KinectProjector::onSliderEvent(ofxDatGuiSliderEvent e){
@@ -1747,10 +2739,12 @@ void KinectProjector::onSliderEvent(ofxDatGuiSliderEvent e){
         basePlaneNormal = basePlaneNormalBack.getRotated(gui->getSlider("Tilt X")->getValue(), ofVec3f(1,0,0));
         basePlaneNormal.rotate(gui->getSlider("Tilt Y")->getValue(), ofVec3f(0,1,0));
         basePlaneEq = getPlaneEquation(basePlaneOffset,basePlaneNormal);
+        updateElevationCoefficients();
         basePlaneUpdated = true;
     } else if (e.target->is("Vertical offset")) {
         basePlaneOffset.z = basePlaneOffsetBack.z + e.value;
         basePlaneEq = getPlaneEquation(basePlaneOffset,basePlaneNormal);
+        updateElevationCoefficients();
         basePlaneUpdated = true;
     } else if (e.target->is("Ceiling")){
         maxOffset = maxOffsetBack-e.value;
@@ -1826,6 +2820,31 @@ void KinectProjector::onCalibModalEvent(ofxModalEvent e)
     }
 }
 
+void KinectProjector::onDriftModalEvent(ofxModalEvent e)
+{
+	if (e.type == ofxModalEvent::CONFIRM)
+	{
+		Drift_type type = driftState;
+		ofLogVerbose("KinectProjector") << "Drift modal confirm button pressed: recalibrating";
+		applicationState = APPLICATION_STATE_SETUP;
+		resetDriftBaseline();
+		if (type == DRIFT_KINECT)
+			startAutomaticROIDetection();
+		else if (type == DRIFT_BASE_PLANE)
+			startBasePlaneCalibration();
+		else if (type == DRIFT_PROJECTION)
+			startAutomaticKinectProjectorCalibration();
+		updateStatusGUI();
+	}
+	else if (e.type == ofxModalEvent::CANCEL)
+	{
+		// The current state becomes the new reference
+		ofLogVerbose("KinectProjector") << "Drift modal cancel button pressed: keeping the calibration";
+		resetDriftBaseline();
+		updateStatusGUI();
+	}
+}
+
 void KinectProjector::saveCalibrationAndSettings()
 {
 	if (projKinectCalibrated)
@@ -1858,11 +2877,13 @@ bool KinectProjector::loadSettings(){
         return false;
     xml.setTo("KINECTSETTINGS");
     kinectROI = xml.getValue<ofRectangle>("kinectROI");
+    loadKinectROIPolygon(xml);
     basePlaneNormalBack = xml.getValue<ofVec3f>("basePlaneNormalBack");
     basePlaneNormal = basePlaneNormalBack;
     basePlaneOffsetBack = xml.getValue<ofVec3f>("basePlaneOffsetBack");
     basePlaneOffset = basePlaneOffsetBack;
     basePlaneEq = xml.getValue<ofVec4f>("basePlaneEq");
+    updateElevationCoefficients();
     maxOffsetBack = xml.getValue<float>("maxOffsetBack");
     maxOffset = maxOffsetBack;
     spatialFiltering = xml.getValue<bool>("spatialFiltering");
@@ -1870,6 +2891,8 @@ bool KinectProjector::loadSettings(){
     numAveragingSlots = xml.getValue<int>("numAveragingSlots");
 	doInpainting = xml.getValue<bool>("OutlierInpainting", false);
 	doFullFrameFiltering = xml.getValue<bool>("FullFrameFiltering", false);
+	doGPUGradientField = xml.getValue<bool>("GPUGradientField", false);
+	doOnlineCalibration = xml.getValue<bool>("OnlineCalibration", false);
     return true;
 }
 
@@ -1881,6 +2904,9 @@ bool KinectProjector::saveSettings()
     xml.addChild("KINECTSETTINGS");
     xml.setTo("KINECTSETTINGS");
     xml.addValue("kinectROI", kinectROI);
+    xml.addValue("kinectROIPolygonSize", (int)kinectROIPolygon.size());
+    for (int i = 0; i < kinectROIPolygon.size(); i++)
+        xml.addValue("kinectROIPolygonPoint" + ofToString(i), ofVec2f(kinectROIPolygon[i].x, kinectROIPolygon[i].y));
     xml.addValue("basePlaneNormalBack", basePlaneNormalBack);
     xml.addValue("basePlaneOffsetBack", basePlaneOffsetBack);
     xml.addValue("basePlaneEq", basePlaneEq);
@@ -1890,48 +2916,19 @@ bool KinectProjector::saveSettings()
     xml.addValue("numAveragingSlots", numAveragingSlots);
 	xml.addValue("OutlierInpainting", doInpainting);
 	xml.addValue("FullFrameFiltering", doFullFrameFiltering);
+	xml.addValue("GPUGradientField", doGPUGradientField);
+	xml.addValue("OnlineCalibration", doOnlineCalibration);
 	xml.setToParent();
     return xml.save(settingsFile);
 }
 
-void KinectProjector::ProcessChessBoardInput(ofxCvGrayscaleImage& image)
+void KinectProjector::loadKinectROIPolygon(ofXml& xml)
 {
-	CheckAndNormalizeKinectROI();
-
-	unsigned char *imgD = image.getPixels().getData();
-	unsigned char minV = 255;
-	unsigned char maxV = 0;
-
-	// Find min and max values inside ROI
-	for (int y = kinectROI.getMinY(); y < kinectROI.getMaxY(); y++)
-	{
-		for (int x = kinectROI.getMinX(); x < kinectROI.getMaxX(); x++)
-		{
-			int idx = y* image.width + x;
-			unsigned char val = imgD[idx];
-
-			if (val > maxV)
-				maxV = val;
-			if (val < minV)
-				minV = val;
-		}
-	}
-	std::cout << "Min " << (int)minV << " max " << (int)maxV << std::endl;
-	double scale = 255.0 / (maxV - minV);
-
-	for (int y = 0; y < image.height; y++)
-	{
-		for (int x = 0; x < image.width; x++)
-		{
-			int idx = y* image.width + x;
-			unsigned char val = imgD[idx];
-			double newVal = (val - minV) * scale;
-			newVal = std::min(newVal, 255.0);
-			newVal = std::max(newVal, 0.0);
-
-			imgD[idx] = (unsigned char)newVal;
-		}
-	}
+    // Older settings files only contain the rectangular kinectROI
+    kinectROIPolygon.clear();
+    int polygonSize = xml.getValue<int>("kinectROIPolygonSize", 0);
+    for (int i = 0; i < polygonSize; i++)
+        kinectROIPolygon.addVertex(xml.getValue<ofVec2f>("kinectROIPolygonPoint" + ofToString(i)));
 }
 
 void KinectProjector::CheckAndNormalizeKinectROI()
@@ -2021,30 +3018,37 @@ bool KinectProjector::getBinaryLandImage(ofxCvGrayscaleImage& BinImg)
 	if (!kinectOpened)
 		return false;
 
-	float *imgData = FilteredDepthImage.getFloatPixelsRef().getData();
+	if (!landImage.isAllocated())
+		return false;
 
+	// The land mask is computed by the kinect grabber for every frame
 	BinImg.allocate(kinectRes.x, kinectRes.y);
-	unsigned char *binData = BinImg.getPixels().getData();
-
-	for (int y = 0; y < kinectRes.y; y++)
-	{
-		for (int x = 0; x < kinectRes.x; x++)
-		{
-			int IDX = y * kinectRes.x + x;
-			double val = imgData[IDX];
+	BinImg.setFromPixels(landImage);
+	return true;
+}
 
-			float H = elevationAtKinectCoord(x, y);
 
-			unsigned char BinOut = 255 * (H > 0);
+ofRectangle KinectProjector::getProjectorSandROI()
+{
+	if (projToKinectMapDirty)
+		updateProjToKinectMap();
+	return projectorSandROI;
+}
 
-			binData[IDX] = BinOut;
-		}
-	}
+bool KinectProjector::getProjToKinectWarp(ofFloatPixels& kinectMap, ofFloatPixels& seaLevelInvDepth, int& step)
+{
+	// Also rebuilt at each step of a calibration blending, so the warp follows the projection
+	if (projToKinectMapDirty)
+		updateProjToKinectMap();
+	if (projToKinectMap.empty())
+		return false;
 
+	kinectMap.setFromPixels(&projToKinectMap[0].x, projToKinectMapCols, projToKinectMapRows, 4);
+	seaLevelInvDepth.setFromPixels(projSeaLevelInvDepth.data(), projToKinectMapCols, projToKinectMapRows, 1);
+	step = projToKinectMapStep;
 	return true;
 }
 
-
 ofRectangle KinectProjector::getProjectorActiveROI()
 {
 	ofRectangle projROI = ofRectangle(ofPoint(0, 0), ofPoint(projRes.x, projRes.y));
@@ -2130,14 +3134,14 @@ void KinectProjector::SaveKinectColorImage()
 	std::string MedianOutName = DebugFileOutDir + "TemporalFilteredImage.png";
 	ofSaveImage(kinectColorImage.getPixels(), ColourOutName);
 
-	if (TemporalFrameFilter.isValid())
+	if (TemporalFrameFilter->isValid())
 	{
 		ofxCvGrayscaleImage tempImage;
 //		tempImage.allocate(kinectColorImage.width, kinectColorImage.height);
 		if (TemporalFilteringType == 0)
-			tempImage.setFromPixels(TemporalFrameFilter.getMedianFilteredImage(), kinectColorImage.width, kinectColorImage.height);
+			tempImage.setFromPixels(TemporalFrameFilter->getMedianFilteredImage(), kinectColorImage.width, kinectColorImage.height);
 		if (TemporalFilteringType == 1)
-			tempImage.setFromPixels(TemporalFrameFilter.getAverageFilteredColImage(), kinectColorImage.width, kinectColorImage.height);
+			tempImage.setFromPixels(TemporalFrameFilter->getAverageFilteredColImage(), kinectColorImage.width, kinectColorImage.height);
 		ofSaveImage(tempImage.getPixels(), MedianOutName);
 	}
 
@@ -34,6 +34,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "KinectProjectorCalibration.h"
 #include "Utils.h"
 #include "TemporalFrameFilter.h"
+#include "ChessboardDetector.h"
+#include "GradientField.h"
 
 class ofxModalThemeProjKinect : public ofxModalTheme {
 public:
@@ -66,9 +68,18 @@ public:
 	ofVec3f kinectCoordToWorldCoord(float x, float y);
 	ofVec2f worldCoordTokinectCoord(ofVec3f wc);
 	ofVec3f RawKinectCoordToWorldCoord(float x, float y);
+	// Batch conversions of n points stored as separate coordinate arrays. When z is null the depths
+	// are read in the filtered depth image like kinectCoordToWorldCoord does
+	void kinectCoordsToWorldCoords(int n, const float* x, const float* y, const float* z, float* wx, float* wy, float* wz);
+	void kinectCoordsToProjCoords(int n, const float* x, const float* y, const float* z, float* px, float* py);
+	// Kinect pixel seen at projector pixel (x, y), on the sand surface or at the sea level
+	ofVec2f projCoordToKinectCoord(float x, float y, bool onSand = true);
     float elevationAtKinectCoord(float x, float y);
     float elevationToKinectDepth(float elevation, float x, float y);
     ofVec2f gradientAtKinectCoord(float x, float y);
+    float slopeAtKinectCoord(float x, float y);
+    float shoreDistanceAtKinectCoord(float x, float y);
+    ofVec2f shoreGradientAtKinectCoord(float x, float y);
 
 	// Try to start the application - assumes calibration has been done before
 	void startApplication();
@@ -82,8 +93,10 @@ public:
 	void setSpatialFiltering(bool sspatialFiltering);
 	void setInPainting(bool inp);
 	void setFullFrameFiltering(bool ff);	
+	void setGPUGradientField(bool gpu);
 	
 	void setFollowBigChanges(bool sfollowBigChanges);
+	void setOnlineCalibration(bool online);
 	void StartManualROIDefinition();
 	void ResetSeaLevel();
 	void showROIonProjector(bool show);
@@ -96,6 +109,7 @@ public:
     void onSliderEvent(ofxDatGuiSliderEvent e);
     void onConfirmModalEvent(ofxModalEvent e);
     void onCalibModalEvent(ofxModalEvent e);
+    void onDriftModalEvent(ofxModalEvent e);
 
 	void mousePressed(int x, int y, int button);
 	void mouseReleased(int x, int y, int button);
@@ -125,6 +139,14 @@ public:
     ofRectangle getKinectROI(){
         return kinectROI;
     }
+    ofPolyline getKinectROIPolygon(){
+        return kinectROIPolygon;
+    }
+    ofPixels & getKinectROIMask(){
+        return kinectROIMask;
+    }
+    // Is the kinect coordinate inside the sand area (and not on the sandbox walls)
+    bool isInsideKinectROI(float x, float y);
     ofVec2f getKinectRes(){
         return kinectRes;
     }
@@ -137,12 +159,29 @@ public:
     ofVec3f getBasePlaneOffset(){
         return basePlaneOffset;
     }
+    float getBasePlaneResidual(){
+        return basePlaneResidual;
+    }
 
 	// Get the ROI of the projector window that should match the Kinect ROI
 	ofRectangle getProjectorActiveROI();
+	// Bounding box of the projector pixels falling inside the sand area at the sea level
+	ofRectangle getProjectorSandROI();
+	// Projector to kinect warp images for the projector space renderer, one pixel every step projector
+	// pixels (pixel (i, j) is projector pixel (i * step, j * step)): kinectMap holds the inverse map
+	// (A.xy, B.xy) and seaLevelInvDepth 1 / depth of the base plane.
+	// Returns false if the projector is not calibrated
+	bool getProjToKinectWarp(ofFloatPixels& kinectMap, ofFloatPixels& seaLevelInvDepth, int& step);
 
 	// Map Game interface
 	bool getBinaryLandImage(ofxCvGrayscaleImage& BinImg);
+	// Elevation above the base plane and land (255) / water (0) mask of the current depth frame
+	const ofFloatPixels& getElevationImage(){
+		return elevationImage;
+	}
+	const ofPixels& getLandImage(){
+		return landImage;
+	}
 
 	bool isCalibrated(){
         return projKinectCalibrated;
@@ -153,9 +192,12 @@ public:
     bool isBasePlaneUpdated(){ // To be called after update()
         return basePlaneUpdated;
     }
-    //bool isROIUpdated(){ // To be called after update()  // Could be set using manual mouse based drawing and cleared before the information was propagated to other modules
-    //    return ROIUpdated;
-    //}
+    bool isDepthFrameNew(){ // To be called after update()
+        return newDepthFrame;
+    }
+    bool isROIUpdated(){ // To be called after update()  // Could be set using manual mouse based drawing and cleared before the information was propagated to other modules
+        return ROIUpdated;
+    }
     bool isCalibrationUpdated(){ // To be called after update()
         return projKinectCalibrationUpdated;
     }
@@ -180,6 +222,15 @@ public:
 	void SaveFilteredDepthImage();
 	void SaveKinectColorImage();
 
+	// Recorded depth frames: the playback (see KinectGrabber::setDepthPlayback) is set before setup()
+	void setDepthPlayback(std::string dir){
+		kinectgrabber.setDepthPlayback(dir);
+	}
+	void toggleDepthRecording();
+	bool isRecordingDepth(){
+		return recordingDepth;
+	}
+
 private:
 
     enum Calibration_state
@@ -189,7 +240,8 @@ private:
         CALIBRATION_STATE_ROI_MANUAL_DETERMINATION,
 		CALIBRATION_STATE_ROI_FROM_FILE,
 		CALIBRATION_STATE_PROJ_KINECT_AUTO_CALIBRATION,
-        CALIBRATION_STATE_PROJ_KINECT_MANUAL_CALIBRATION
+        CALIBRATION_STATE_PROJ_KINECT_MANUAL_CALIBRATION,
+        CALIBRATION_STATE_BASE_PLANE_DETERMINATION
     };
     enum Full_Calibration_state
     {
@@ -212,10 +264,24 @@ private:
         AUTOCALIB_STATE_COMPUTE,
         AUTOCALIB_STATE_DONE
     };
+    enum Online_calibration_state
+    {
+        ONLINE_CALIB_STATE_WAIT,
+        ONLINE_CALIB_STATE_SHOW_FIDUCIAL,
+        ONLINE_CALIB_STATE_DETECT
+    };
+    enum Drift_type
+    {
+        DRIFT_NONE,
+        DRIFT_BASE_PLANE, // The sand box or the kinect tilted
+        DRIFT_PROJECTION, // The projector moved
+        DRIFT_KINECT      // The kinect moved
+    };
 
    
     void exit(ofEventArgs& e);
     void setupGradientField();
+    void updateGPUGradientField();
     
 
     void updateCalibration();
@@ -229,18 +295,45 @@ private:
     void updateROIFromCalibration();
     void setMaxKinectGrabberROI();
     void setNewKinectROI();
-    void updateKinectGrabberROI(ofRectangle ROI);
+    void updateKinectROIMask();
+    void updateKinectGrabberROI(ofRectangle ROI, ofPixels ROIMask = ofPixels());
 
 	void updateProjKinectAutoCalibration();
 
 	double ComputeReprojectionError(bool WriteFile);
 	void CalibrateNextPoint();
+	void processChessboardDetection(ChessboardDetectionResult& result);
+	ofRectangle getExpectedChessboardKinectROI(ofPoint chessboardCenter);
 
 	void updateProjKinectManualCalibration();
+	void startBasePlaneCalibration();
+	void updateBasePlaneCalibration();
+
+	// Online calibration refinement while the application is running
+	void updateOnlineCalibration(bool newColorFrame);
+	void startFiducial();
+	void drawFiducial();
+	ofRectangle getExpectedFiducialKinectROI();
+	void processFiducialDetection(ChessboardDetectionResult& result);
+	void updateKinectProjMatrixBlending();
+	void resetOnlineCalibration();
+
+	// Drift detection while the application is running
+	void resetDriftBaseline();
+	void updateDriftMonitor();
+	void updateFiducialDrift(float error);
+	void raiseDriftAlert(Drift_type type);
     bool addPointPair();
     void updateMaxOffset();
     void updateBasePlane();
+    bool fitPlaneToDepthImage(ofVec4f& planeEq, float& residual, float& inlierRatio, int sampleStep = 1);
+    int depthPlanePass(ofRectangle ROI, ofVec4f planeEq, float threshold, ofxCSG::PlaneFitAccumulator* accumulator, int* histogram, double& sumSquares, int sampleStep);
     void askToFlattenSand();
+    void updateKinectRays();
+    void updateElevationCoefficients();
+    int kinectCoordToIndex(float x, float y);
+    void updateProjToKinectMap();
+    void projToKinectMapAt(float x, float y, ofVec4f& m, float& invDepth);
 
     void drawChessboard(int x, int y, int chessboardSize);
     void drawArrow(ofVec2f projectedPoint, ofVec2f v1);
@@ -248,8 +341,8 @@ private:
     void saveCalibrationAndSettings();
     bool loadSettings();
     bool saveSettings();
+    void loadKinectROIPolygon(ofXml& xml);
     
-	void ProcessChessBoardInput(ofxCvGrayscaleImage& image);
 	void CheckAndNormalizeKinectROI();
 
     // State variables
@@ -258,11 +351,12 @@ private:
 	float lastKinectOpenTry;
 	bool ROIcalibrated;
     bool projKinectCalibrated;
-//    bool ROIUpdated;
+    bool ROIUpdated;
     bool projKinectCalibrationUpdated;
 	bool basePlaneComputed;
     bool basePlaneUpdated;
     bool imageStabilized;
+    bool newDepthFrame;
     bool waitingForFlattenSand;
     bool drawKinectView;
 	bool drawKinectColorView;
@@ -270,6 +364,7 @@ private:
     ROI_calibration_state ROICalibState;
     Auto_calibration_state autoCalibState;
     Full_Calibration_state fullCalibState;
+    Online_calibration_state onlineCalibState;
 	Application_state applicationState;
 
     // Projector window
@@ -285,6 +380,9 @@ private:
 
     //kinect buffer
     ofxCvFloatImage             FilteredDepthImage;
+    ofFloatPixels               elevationImage; // Computed by the kinect grabber from FilteredDepthImage
+    ofPixels                    landImage;
+    ofFloatPixels               shoreDistanceImage; // Signed distance to the shore in kinect pixels, positive on land
     ofxCvColorImage             kinectColorImage;
     ofVec2f*                    gradField;
 	ofFpsCounter                fpsKinect;
@@ -300,7 +398,6 @@ private:
 
     //Images and cv matrixes
     cv::Mat                     cvRgbImage;
-	cv::Mat                     cvGrayImage;
 //	ofxCvFloatImage             Dptimg;
     
     //Gradient field variables
@@ -308,6 +405,8 @@ private:
     int gradFieldResolution;
     float arrowLength;
     int fishInd;
+    GradientField               gpuGradientField; // Computed from FilteredDepthImage and read back one frame later
+    bool                        doGPUGradientField;
     
     // Calibration variables
     ofxKinectProjectorToolkit*  kpt;
@@ -322,6 +421,8 @@ private:
     float                       threshold;
     ofPolyline                  large;
     ofRectangle                 kinectROI, kinectROIManualCalib;
+    ofPolyline                  kinectROIPolygon; // Outline of the sand area found by the ROI detection (empty: whole kinectROI)
+    ofPixels                    kinectROIMask; // 255 inside the sand area, 0 outside
 	ofVec2f                     ROIStartPoint;
 	ofVec2f                     ROICurrentPoint;
 	bool                        doShowROIonProjector;
@@ -330,10 +431,25 @@ private:
     ofVec3f basePlaneNormal, basePlaneNormalBack;
     ofVec3f basePlaneOffset, basePlaneOffsetBack;
     ofVec4f basePlaneEq; // Base plane equation in GLSL-compatible format
+    float basePlaneResidual; // RMS distance (mm) of the sand to the base plane when it was computed
+    float basePlaneInlierRatio; // Fraction of the sand pixels used for the base plane
     
     // Conversion matrices
     ofMatrix4x4                 kinectProjMatrix;
     ofMatrix4x4                 kinectWorldMatrix;
+    // Per pixel lookup tables, rebuilt when kinectWorldMatrix or basePlaneEq change
+    vector<ofVec2f>             kinectRays; // The world point of pixel i at depth z is z * (kinectRays[i].x, kinectRays[i].y, 1)
+    vector<ofVec2f>             elevationCoeffs; // elevation = z * elevationCoeffs[i].x - basePlaneEq.w, z = (elevation + basePlaneEq.w) * elevationCoeffs[i].y
+    // Inverse map, rebuilt when the calibration or the base plane change: the kinect pixel seen at
+    // projector node i at depth z is (map[i].x, map[i].y) + (map[i].z, map[i].w) / z. The map is smooth,
+    // so it is only computed on a grid of nodes every projToKinectMapStep projector pixels (the last
+    // node is past the projector border) and bilinearly interpolated in between
+    vector<ofVec4f>             projToKinectMap;
+    vector<float>               projSeaLevelInvDepth; // 1 / depth of the base plane along the projector ray of node i
+    int                         projToKinectMapStep;
+    int                         projToKinectMapCols, projToKinectMapRows;
+    ofRectangle                 projectorSandROI;
+    bool                        projToKinectMapDirty;
 
     // Max offset for keeping kinect points
     float maxOffset;
@@ -346,8 +462,13 @@ private:
     int trials;
     bool upframe;
 
-	// Temporal frame filter for cleaning the colour image used for calibration. It should probably be moved to the grabber class/thread
-	CTemporalFrameFilter TemporalFrameFilter;
+	// Temporal frame filter for cleaning the colour image used for calibration. It is handed to the chessboard detector when a chessboard is searched
+	std::shared_ptr<CTemporalFrameFilter> TemporalFrameFilter;
+	std::shared_ptr<CTemporalFrameFilter> spareTemporalFrameFilter;
+	// Chessboard search running outside the main thread
+	ChessboardDetector chessboardDetector;
+	bool chessboardDetectionPending;
+	int chessboardDetectionId;
 	// Keeps track of how many frames are acquired since last calibration event
 	int TemporalFrameCounter;
 	// Type of temporal filtering of colour image 0: Median, 1 :average
@@ -358,10 +479,38 @@ private:
     int   chessboardX;
     int   chessboardY;
 
+    // Online calibration refinement: small chessboards (fiducials) are projected from time to time
+    // over the games and the point pairs found refine the calibration
+    bool doOnlineCalibration;
+    float onlineCalibInterval; // Seconds between two fiducials
+    float onlineCalibLastTime;
+    int onlineCalibFrameCounter;
+    int fiducialSize;
+    vector<ofVec2f> fiducialProjectorPoints;
+    std::shared_ptr<CTemporalFrameFilter> fiducialFrameFilter;
+    ChessboardDetector fiducialDetector;
+    int fiducialDetectionId;
+    vector<ofVec3f> onlinePairsKinect; // Most recent pairs found by the online refinement
+    vector<ofVec2f> onlinePairsProjector;
+    ofMatrix4x4 kinectProjMatrixTarget; // kinectProjMatrix is moved towards the refined calibration a little every frame
+    bool kinectProjMatrixBlending;
+
+    // Drift detection: the depth of the sandbox rim, the tilt of the flat sand and the error of the
+    // online calibration fiducials are compared to their values when the application started
+    Drift_type driftState;
+    float rimDepthBaseline; // 0 until the first rim depth is received
+    float driftLastRimCheck;
+    float driftLastPlaneCheck;
+    int rimDriftCount; // Number of consecutive checks above the threshold
+    int planeDriftCount;
+    int fiducialDriftCount;
+    bool basePlaneCalibGrabberReset;
+
     // GUI Modal window & interface
 	bool displayGui;
     shared_ptr<ofxModalConfirm>   confirmModal;
     shared_ptr<ofxModalAlert>   calibModal;
+    shared_ptr<ofxModalConfirm>   driftModal;
     shared_ptr<ofxModalThemeProjKinect>   modalTheme;
     ofxDatGui* gui;
 	ofxDatGui* StatusGUI;
@@ -370,6 +519,7 @@ private:
 	// Debug functions
 	bool DumpDebugFiles;
 	std::string DebugFileOutDir;
+	bool recordingDepth;
 	std::string GetTimeAndDateString();
 	bool savePointPair();
 	void SaveFilteredDepthImageDebug();
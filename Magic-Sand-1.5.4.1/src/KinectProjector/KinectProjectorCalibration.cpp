@@ -26,55 +26,478 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "KinectProjectorCalibration.h"
 
+CalibrationNormalEquations::CalibrationNormalEquations() {
+    clear();
+}
+
+void CalibrationNormalEquations::clear() {
+    AtA = 0;
+    Aty = 0;
+    nPairs = 0;
+}
+
+void CalibrationNormalEquations::add(ofVec3f kinectPoint, ofVec2f projectorPoint, double weight) {
+    // The two rows of the linear system given by a point pair
+    double rows[2][11] = {
+        {kinectPoint.x, kinectPoint.y, kinectPoint.z, 1, 0, 0, 0, 0,
+         -kinectPoint.x * projectorPoint.x, -kinectPoint.y * projectorPoint.x, -kinectPoint.z * projectorPoint.x},
+        {0, 0, 0, 0, kinectPoint.x, kinectPoint.y, kinectPoint.z, 1,
+         -kinectPoint.x * projectorPoint.y, -kinectPoint.y * projectorPoint.y, -kinectPoint.z * projectorPoint.y}};
+    double values[2] = {projectorPoint.x, projectorPoint.y};
+    
+    for (int r=0; r<2; r++) {
+        for (int i=0; i<11; i++) {
+            for (int j=i; j<11; j++) { // Upper triangle only, AtA is symmetric
+                AtA(i, j) += weight * rows[r][i] * rows[r][j];
+            }
+            Aty(i, 0) += weight * rows[r][i] * values[r];
+        }
+    }
+    nPairs++;
+}
+
+bool CalibrationNormalEquations::solve(dlib::matrix<double, 11, 1>& x) {
+    if (nPairs < 6)
+        return false;
+    
+    dlib::matrix<double, 11, 11> M = AtA;
+    for (int i=0; i<11; i++) {
+        for (int j=0; j<i; j++) {
+            M(i, j) = M(j, i);
+        }
+    }
+    dlib::qr_decomposition<dlib::matrix<double, 11, 11> > qrd(M);
+    if (!qrd.is_full_rank())
+        return false;
+    x = qrd.solve(Aty);
+    return true;
+}
+
 ofxKinectProjectorToolkit::ofxKinectProjectorToolkit(ofVec2f sprojRes, ofVec2f skinectRes) {
 	projRes = sprojRes;
 	kinectRes = skinectRes;
     calibrated = false;
+    ransacThreshold = 10;
+    ransacMaxIterations = 1000;
+    minInlierRatio = 0.5;
+    kinectScale = 1;
+    projectorScale = 1;
 }
 
-void ofxKinectProjectorToolkit::calibrate(vector<ofVec3f> pairsKinect,
+bool ofxKinectProjectorToolkit::calibrate(vector<ofVec3f> pairsKinect,
                                           vector<ofVec2f> pairsProjector) {
     int nPairs = pairsKinect.size();
-    A.set_size(nPairs*2, 11);
-    y.set_size(nPairs*2, 1);
+    residuals.clear();
+    inliers.clear();
+    if (nPairs < 6 || pairsProjector.size() != nPairs) {
+        ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): not enough point pairs: " << nPairs;
+        return false;
+    }
     
+    computeNormalization(pairsKinect, pairsProjector);
+    vector<ofVec3f> normKinect(nPairs);
+    vector<ofVec2f> normProjector(nPairs);
     for (int i=0; i<nPairs; i++) {
-        A(2*i, 0) = pairsKinect[i].x;
-        A(2*i, 1) = pairsKinect[i].y;
-        A(2*i, 2) = pairsKinect[i].z;
-        A(2*i, 3) = 1;
-        A(2*i, 4) = 0;
-        A(2*i, 5) = 0;
-        A(2*i, 6) = 0;
-        A(2*i, 7) = 0;
-        A(2*i, 8) = -pairsKinect[i].x * pairsProjector[i].x;
-        A(2*i, 9) = -pairsKinect[i].y * pairsProjector[i].x;
-        A(2*i, 10) = -pairsKinect[i].z * pairsProjector[i].x;
+        normKinect[i] = normalizeKinectPoint(pairsKinect[i]);
+        normProjector[i] = normalizeProjectorPoint(pairsProjector[i]);
+    }
+    double threshold = ransacThreshold * projectorScale;
+    double threshold2 = threshold * threshold;
+    
+    // RANSAC on minimal samples of 6 pairs
+    CalibrationNormalEquations equations;
+    dlib::matrix<double, 11, 1> p;
+    vector<bool> bestInliers(nPairs, false);
+    int bestCount = 0;
+    double bestCost = 0;
+    int iterations = ransacMaxIterations;
+    vector<int> sample;
+    for (int it=0; it<iterations; it++) {
+        sample.clear();
+        while (sample.size() < 6) {
+            int idx = min((int)ofRandom(nPairs), nPairs-1);
+            if (find(sample.begin(), sample.end(), idx) == sample.end())
+                sample.push_back(idx);
+        }
+        equations.clear();
+        for (int i=0; i<sample.size(); i++) {
+            equations.add(normKinect[sample[i]], normProjector[sample[i]]);
+        }
+        if (!equations.solve(p))
+            continue; // Degenerate sample
         
-        A(2*i+1, 0) = 0;
-        A(2*i+1, 1) = 0;
-        A(2*i+1, 2) = 0;
-        A(2*i+1, 3) = 0;
-        A(2*i+1, 4) = pairsKinect[i].x;
-        A(2*i+1, 5) = pairsKinect[i].y;
-        A(2*i+1, 6) = pairsKinect[i].z;
-        A(2*i+1, 7) = 1;
-        A(2*i+1, 8) = -pairsKinect[i].x * pairsProjector[i].y;
-        A(2*i+1, 9) = -pairsKinect[i].y * pairsProjector[i].y;
-        A(2*i+1, 10) = -pairsKinect[i].z * pairsProjector[i].y;
+        int count = 0;
+        double cost = 0;
+        for (int i=0; i<nPairs; i++) {
+            double d2 = (project(p, normKinect[i]) - normProjector[i]).lengthSquared();
+            if (d2 < threshold2) {
+                count++;
+                cost += d2;
+            }
+        }
+        if (count > bestCount || (count == bestCount && cost < bestCost)) {
+            bestCount = count;
+            bestCost = cost;
+            for (int i=0; i<nPairs; i++) {
+                bestInliers[i] = (project(p, normKinect[i]) - normProjector[i]).lengthSquared() < threshold2;
+            }
+            // Number of samples needed to draw an outlier free sample with a 99% probability
+            double pGood = pow((double)count / nPairs, 6);
+            if (pGood > 1 - 1e-9)
+                iterations = it + 1;
+            else if (pGood > 0)
+                iterations = min(ransacMaxIterations, (int)ceil(log(0.01) / log(1 - pGood)));
+        }
+    }
+    // A consensus of a minority of the pairs is more likely a coincidence of wrongly detected chessboards
+    int minInliers = max(6, (int)ceil(minInlierRatio * nPairs));
+    if (bestCount < minInliers) {
+        ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): no consistent model found, best consensus "
+            << bestCount << " of " << nPairs << " pairs (" << nPairs - bestCount << " outliers)";
+        return false;
+    }
+    
+    // Least squares on the inliers then nonlinear refinement of their reprojection error.
+    // The inliers are re-classified with the refined model until they are stable
+    vector<bool> currentInliers = bestInliers;
+    for (int pass=0; pass<3; pass++) {
+        vector<ofVec3f> inlierKinect;
+        vector<ofVec2f> inlierProjector;
+        equations.clear();
+        for (int i=0; i<nPairs; i++) {
+            if (currentInliers[i]) {
+                inlierKinect.push_back(normKinect[i]);
+                inlierProjector.push_back(normProjector[i]);
+                equations.add(normKinect[i], normProjector[i]);
+            }
+        }
+        if (!equations.solve(p)) {
+            ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): inliers do not constrain the model";
+            return false;
+        }
+        refineLevenbergMarquardt(p, inlierKinect, inlierProjector, p, 0);
         
-        y(2*i, 0) = pairsProjector[i].x;
-        y(2*i+1, 0) = pairsProjector[i].y;
+        bool changed = false;
+        int count = 0;
+        vector<bool> newInliers(nPairs);
+        for (int i=0; i<nPairs; i++) {
+            newInliers[i] = (project(p, normKinect[i]) - normProjector[i]).lengthSquared() < threshold2;
+            changed = changed || newInliers[i] != currentInliers[i];
+            count += newInliers[i];
+        }
+        if (!changed || count < 6)
+            break;
+        currentInliers = newInliers;
     }
     
-    dlib::qr_decomposition<dlib::matrix<double, 0, 11> > qrd(A);
-    x = qrd.solve(y);
-    cout << "x: "<< x << endl;
+    int nInliers = 0;
+    for (int i=0; i<nPairs; i++) {
+        nInliers += (project(p, normKinect[i]) - normProjector[i]).lengthSquared() < threshold2;
+    }
+    if (nInliers < minInliers) {
+        ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): refined model keeps only " << nInliers << " of " << nPairs
+            << " pairs (" << nPairs - nInliers << " outliers)";
+        return false;
+    }
+    
+    if (!denormalize(p)) {
+        ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): degenerate projection matrix";
+        return false;
+    }
     projMatrice = ofMatrix4x4(x(0,0), x(1,0), x(2,0), x(3,0),
                               x(4,0), x(5,0), x(6,0), x(7,0),
                               x(8,0), x(9,0), x(10,0), 1,
                               0, 0, 0, 1);
+    
+    computeResiduals(pairsKinect, pairsProjector);
+    ofLogVerbose("ofxKinectProjectorToolkit") << "calibrate(): " << getNumberOfInliers() << " inliers of " << nPairs
+        << " pairs (" << nPairs - getNumberOfInliers() << " outliers), mean inlier error " << getMeanInlierError() << " pixels";
     calibrated = true;
+    return true;
+}
+
+bool ofxKinectProjectorToolkit::refine(vector<ofVec3f> pairsKinect,
+                                       vector<ofVec2f> pairsProjector, double priorWeight) {
+    int nPairs = pairsKinect.size();
+    if (!calibrated || nPairs < 12 || pairsProjector.size() != nPairs)
+        return false;
+    
+    // The even pairs are fitted and the odd ones held out: the refined calibration is judged on
+    // the validation pairs that are inliers of the current calibration, where it has to do better
+    dlib::matrix<double, 11, 1> currentX = x;
+    ofMatrix4x4 currentProjMatrice = projMatrice;
+    computeResiduals(pairsKinect, pairsProjector);
+    vector<double> currentResiduals = residuals;
+    vector<bool> currentInliers = inliers;
+    vector<ofVec3f> fitKinect;
+    vector<ofVec2f> fitProjector;
+    double currentError = 0;
+    int count = 0;
+    for (int i=0; i<nPairs; i++) {
+        if (i % 2 == 0) {
+            fitKinect.push_back(pairsKinect[i]);
+            fitProjector.push_back(pairsProjector[i]);
+        } else if (currentInliers[i]) {
+            currentError += currentResiduals[i];
+            count++;
+        }
+    }
+    if (count < 3)
+        return false;
+    currentError /= count;
+    
+    int nFit = fitKinect.size();
+    computeNormalization(fitKinect, fitProjector);
+    vector<ofVec3f> normKinect(nFit);
+    vector<ofVec2f> normProjector(nFit);
+    for (int i=0; i<nFit; i++) {
+        normKinect[i] = normalizeKinectPoint(fitKinect[i]);
+        normProjector[i] = normalizeProjectorPoint(fitProjector[i]);
+    }
+    
+    // The current calibration is both the starting point and the prior. Recent pairs usually
+    // cover a small part of the sand and cannot constrain the 11 parameters alone
+    dlib::matrix<double, 11, 1> prior;
+    if (!normalizeCalibration(prior))
+        return false;
+    dlib::matrix<double, 11, 1> p = prior;
+    refineLevenbergMarquardt(p, normKinect, normProjector, prior, priorWeight);
+    
+    if (!denormalize(p))
+        return false;
+    projMatrice = ofMatrix4x4(x(0,0), x(1,0), x(2,0), x(3,0),
+                              x(4,0), x(5,0), x(6,0), x(7,0),
+                              x(8,0), x(9,0), x(10,0), 1,
+                              0, 0, 0, 1);
+    computeResiduals(pairsKinect, pairsProjector);
+    double refinedError = 0;
+    for (int i=1; i<nPairs; i+=2) {
+        if (currentInliers[i])
+            refinedError += residuals[i];
+    }
+    refinedError /= count;
+    if (refinedError >= currentError) {
+        ofLogVerbose("ofxKinectProjectorToolkit") << "refine(): no improvement on " << count << " validation pairs, mean error "
+            << refinedError << " pixels, current " << currentError << " pixels";
+        x = currentX;
+        projMatrice = currentProjMatrice;
+        residuals = currentResiduals;
+        inliers = currentInliers;
+        return false;
+    }
+    ofLogVerbose("ofxKinectProjectorToolkit") << "refine(): " << count << " validation pairs, mean error " << refinedError
+        << " pixels, current " << currentError << " pixels";
+    return true;
+}
+
+void ofxKinectProjectorToolkit::computeResiduals(vector<ofVec3f>& pairsKinect, vector<ofVec2f>& pairsProjector) {
+    residuals.clear();
+    inliers.clear();
+    for (int i=0; i<pairsKinect.size(); i++) {
+        double residual = (project(x, pairsKinect[i]) - pairsProjector[i]).length();
+        residuals.push_back(residual);
+        inliers.push_back(residual < ransacThreshold);
+    }
+}
+
+int ofxKinectProjectorToolkit::getNumberOfInliers() {
+    int count = 0;
+    for (int i=0; i<inliers.size(); i++) {
+        count += inliers[i];
+    }
+    return count;
+}
+
+double ofxKinectProjectorToolkit::getMeanInlierError() {
+    double error = 0;
+    int count = 0;
+    for (int i=0; i<residuals.size(); i++) {
+        if (inliers[i]) {
+            error += residuals[i];
+            count++;
+        }
+    }
+    return count > 0 ? error / count : 0;
+}
+
+void ofxKinectProjectorToolkit::computeNormalization(vector<ofVec3f>& pairsKinect, vector<ofVec2f>& pairsProjector) {
+    int nPairs = pairsKinect.size();
+    kinectCenter = ofVec3f(0);
+    projectorCenter = ofVec2f(0);
+    for (int i=0; i<nPairs; i++) {
+        kinectCenter += pairsKinect[i];
+        projectorCenter += pairsProjector[i];
+    }
+    kinectCenter /= nPairs;
+    projectorCenter /= nPairs;
+    
+    double kinectDist = 0;
+    double projectorDist = 0;
+    for (int i=0; i<nPairs; i++) {
+        kinectDist += (pairsKinect[i] - kinectCenter).length();
+        projectorDist += (pairsProjector[i] - projectorCenter).length();
+    }
+    kinectDist /= nPairs;
+    projectorDist /= nPairs;
+    kinectScale = kinectDist > 0 ? sqrt(3.0) / kinectDist : 1;
+    projectorScale = projectorDist > 0 ? sqrt(2.0) / projectorDist : 1;
+}
+
+ofVec3f ofxKinectProjectorToolkit::normalizeKinectPoint(ofVec3f kinectPoint) {
+    return (kinectPoint - kinectCenter) * kinectScale;
+}
+
+ofVec2f ofxKinectProjectorToolkit::normalizeProjectorPoint(ofVec2f projectorPoint) {
+    return (projectorPoint - projectorCenter) * projectorScale;
+}
+
+// Compute x = Tp^-1 * Pn * Tk from the solution on normalized coordinates, scaled so that P(2,3) = 1
+bool ofxKinectProjectorToolkit::denormalize(dlib::matrix<double, 11, 1>& xn) {
+    double Pn[3][4] = {{xn(0,0), xn(1,0), xn(2,0), xn(3,0)},
+                       {xn(4,0), xn(5,0), xn(6,0), xn(7,0)},
+                       {xn(8,0), xn(9,0), xn(10,0), 1}};
+    double P[3][4];
+    for (int r=0; r<3; r++) {
+        P[r][0] = kinectScale * Pn[r][0];
+        P[r][1] = kinectScale * Pn[r][1];
+        P[r][2] = kinectScale * Pn[r][2];
+        P[r][3] = Pn[r][3] - kinectScale * (Pn[r][0] * kinectCenter.x + Pn[r][1] * kinectCenter.y + Pn[r][2] * kinectCenter.z);
+    }
+    for (int c=0; c<4; c++) {
+        P[0][c] = P[0][c] / projectorScale + projectorCenter.x * P[2][c];
+        P[1][c] = P[1][c] / projectorScale + projectorCenter.y * P[2][c];
+    }
+    if (fabs(P[2][3]) < 1e-12)
+        return false;
+    for (int i=0; i<11; i++) {
+        x(i, 0) = P[i/4][i%4] / P[2][3];
+    }
+    return true;
+}
+
+// Inverse of denormalize(): compute xn = Tp * P * Tk^-1 from the current calibration, scaled so that Pn(2,3) = 1
+bool ofxKinectProjectorToolkit::normalizeCalibration(dlib::matrix<double, 11, 1>& xn) {
+    double P[3][4] = {{x(0,0), x(1,0), x(2,0), x(3,0)},
+                      {x(4,0), x(5,0), x(6,0), x(7,0)},
+                      {x(8,0), x(9,0), x(10,0), 1}};
+    double Pn[3][4];
+    for (int r=0; r<3; r++) {
+        Pn[r][0] = P[r][0] / kinectScale;
+        Pn[r][1] = P[r][1] / kinectScale;
+        Pn[r][2] = P[r][2] / kinectScale;
+        Pn[r][3] = P[r][3] + P[r][0] * kinectCenter.x + P[r][1] * kinectCenter.y + P[r][2] * kinectCenter.z;
+    }
+    for (int c=0; c<4; c++) {
+        Pn[0][c] = projectorScale * (Pn[0][c] - projectorCenter.x * Pn[2][c]);
+        Pn[1][c] = projectorScale * (Pn[1][c] - projectorCenter.y * Pn[2][c]);
+    }
+    if (fabs(Pn[2][3]) < 1e-12)
+        return false;
+    for (int i=0; i<11; i++) {
+        xn(i, 0) = Pn[i/4][i%4] / Pn[2][3];
+    }
+    return true;
+}
+
+ofVec2f ofxKinectProjectorToolkit::project(dlib::matrix<double, 11, 1>& p, ofVec3f point) {
+    double w = p(8,0) * point.x + p(9,0) * point.y + p(10,0) * point.z + 1;
+    double u = p(0,0) * point.x + p(1,0) * point.y + p(2,0) * point.z + p(3,0);
+    double v = p(4,0) * point.x + p(5,0) * point.y + p(6,0) * point.z + p(7,0);
+    return ofVec2f(u / w, v / w);
+}
+
+double ofxKinectProjectorToolkit::reprojectionCost(dlib::matrix<double, 11, 1>& p, vector<ofVec3f>& pointsKinect, vector<ofVec2f>& pointsProjector) {
+    double cost = 0;
+    for (int i=0; i<pointsKinect.size(); i++) {
+        ofVec3f k = pointsKinect[i];
+        double w = p(8,0) * k.x + p(9,0) * k.y + p(10,0) * k.z + 1;
+        double du = (p(0,0) * k.x + p(1,0) * k.y + p(2,0) * k.z + p(3,0)) / w - pointsProjector[i].x;
+        double dv = (p(4,0) * k.x + p(5,0) * k.y + p(6,0) * k.z + p(7,0)) / w - pointsProjector[i].y;
+        cost += du * du + dv * dv;
+    }
+    return cost;
+}
+
+double ofxKinectProjectorToolkit::priorCost(dlib::matrix<double, 11, 1>& p, dlib::matrix<double, 11, 1>& prior, double priorWeight) {
+    double cost = 0;
+    for (int i=0; i<11; i++) {
+        cost += (p(i, 0) - prior(i, 0)) * (p(i, 0) - prior(i, 0));
+    }
+    return priorWeight * cost;
+}
+
+// Minimize the sum of the squared reprojection errors (the linear solution minimizes an algebraic error)
+// plus priorWeight times the squared distance to the prior parameters
+void ofxKinectProjectorToolkit::refineLevenbergMarquardt(dlib::matrix<double, 11, 1>& p, vector<ofVec3f>& pointsKinect, vector<ofVec2f>& pointsProjector,
+                                                         dlib::matrix<double, 11, 1>& prior, double priorWeight) {
+    dlib::matrix<double, 11, 1> priorParameters = prior; // prior may alias p
+    double lambda = 1e-3;
+    double cost = reprojectionCost(p, pointsKinect, pointsProjector) + priorCost(p, priorParameters, priorWeight);
+    
+    for (int it=0; it<50; it++) {
+        // Normal equations of the linearized problem, accumulated pair by pair
+        dlib::matrix<double, 11, 11> JtJ;
+        dlib::matrix<double, 11, 1> Jtr;
+        JtJ = 0;
+        Jtr = 0;
+        for (int i=0; i<pointsKinect.size(); i++) {
+            ofVec3f k = pointsKinect[i];
+            double w = p(8,0) * k.x + p(9,0) * k.y + p(10,0) * k.z + 1;
+            if (fabs(w) < 1e-12)
+                continue;
+            double u = (p(0,0) * k.x + p(1,0) * k.y + p(2,0) * k.z + p(3,0)) / w;
+            double v = (p(4,0) * k.x + p(5,0) * k.y + p(6,0) * k.z + p(7,0)) / w;
+            double Ju[11] = {k.x/w, k.y/w, k.z/w, 1/w, 0, 0, 0, 0, -u*k.x/w, -u*k.y/w, -u*k.z/w};
+            double Jv[11] = {0, 0, 0, 0, k.x/w, k.y/w, k.z/w, 1/w, -v*k.x/w, -v*k.y/w, -v*k.z/w};
+            double ru = u - pointsProjector[i].x;
+            double rv = v - pointsProjector[i].y;
+            for (int a=0; a<11; a++) {
+                for (int b=a; b<11; b++) {
+                    JtJ(a, b) += Ju[a] * Ju[b] + Jv[a] * Jv[b];
+                }
+                Jtr(a, 0) += Ju[a] * ru + Jv[a] * rv;
+            }
+        }
+        for (int a=0; a<11; a++) {
+            for (int b=0; b<a; b++) {
+                JtJ(a, b) = JtJ(b, a);
+            }
+            JtJ(a, a) += priorWeight;
+            Jtr(a, 0) += priorWeight * (p(a, 0) - priorParameters(a, 0));
+        }
+        
+        // Increase the damping until the step decreases the cost
+        bool improved = false;
+        double decrease = 0;
+        while (!improved && lambda < 1e10) {
+            dlib::matrix<double, 11, 11> M = JtJ;
+            for (int a=0; a<11; a++) {
+                M(a, a) += lambda * max(JtJ(a, a), 1e-12);
+            }
+            dlib::qr_decomposition<dlib::matrix<double, 11, 11> > qrd(M);
+            if (!qrd.is_full_rank()) {
+                lambda *= 10;
+                continue;
+            }
+            dlib::matrix<double, 11, 1> delta = qrd.solve(Jtr);
+            dlib::matrix<double, 11, 1> candidate;
+            for (int a=0; a<11; a++) {
+                candidate(a, 0) = p(a, 0) - delta(a, 0);
+            }
+            double newCost = reprojectionCost(candidate, pointsKinect, pointsProjector) + priorCost(candidate, priorParameters, priorWeight);
+            if (newCost < cost) {
+                improved = true;
+                decrease = cost - newCost;
+                p = candidate;
+                cost = newCost;
+                lambda = max(lambda / 10, 1e-12);
+            } else {
+                lambda *= 10;
+            }
+        }
+        if (!improved || decrease < 1e-12 * cost)
+            break;
+    }
 }
 
 ofMatrix4x4 ofxKinectProjectorToolkit::getProjectionMatrix() {
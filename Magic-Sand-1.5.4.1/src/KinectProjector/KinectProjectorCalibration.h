@@ -33,12 +33,35 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "libs/dlib/matrix/matrix_qr.h"
 
 
+//! Normal equations of the linear kinect/projector calibration system
+/** Point pairs are accumulated one at a time so the memory used and the time
+    needed to solve the system do not depend on the number of pairs */
+class CalibrationNormalEquations
+{
+public:
+    CalibrationNormalEquations();
+
+    void clear();
+    void add(ofVec3f kinectPoint, ofVec2f projectorPoint, double weight = 1);
+    bool solve(dlib::matrix<double, 11, 1>& x);
+
+    int getNumberOfPairs() {return nPairs;}
+
+private:
+    dlib::matrix<double, 11, 11> AtA;
+    dlib::matrix<double, 11, 1> Aty;
+    int nPairs;
+};
+
 class ofxKinectProjectorToolkit
 {
 public:
     ofxKinectProjectorToolkit(ofVec2f projRes, ofVec2f kinectRes);
     
-    void calibrate(vector<ofVec3f> pairsKinect,
+    // Robust calibration: RANSAC outlier rejection followed by a Levenberg-Marquardt
+    // refinement of the reprojection error of the inliers. Returns false if no model is found
+    // or if it is consistent with less than the minimum inlier ratio of the pairs
+    bool calibrate(vector<ofVec3f> pairsKinect,
                    vector<ofVec2f> pairsProjector);
     
     ofVec2f getProjectedPoint(ofVec3f worldPoint);
@@ -50,11 +73,42 @@ public:
     bool saveCalibration(string path);
     
     bool isCalibrated() {return calibrated;}
+
+    // Reprojection error in projector pixels of each pair given to the last calibrate()
+    vector<double> getResiduals() {return residuals;}
+    vector<bool> getInliers() {return inliers;}
+    int getNumberOfInliers();
+    double getMeanInlierError();
+
+    // Online refinement: re-estimate the calibration from recent point pairs while staying close
+    // to the current calibration. The solution is fitted on the even pairs: it minimizes the sum of the
+    // squared reprojection errors in normalized projector coordinates plus priorWeight times the squared
+    // distance of the normalized parameters to the current ones. Returns false, and keeps the current
+    // calibration, unless the mean error on the held-out odd pairs that are inliers of the current
+    // calibration decreases
+    bool refine(vector<ofVec3f> pairsKinect,
+                vector<ofVec2f> pairsProjector, double priorWeight);
+
+    void setRansacThreshold(double threshold) {ransacThreshold = threshold;}
+    void setRansacMaxIterations(int iterations) {ransacMaxIterations = iterations;}
+    void setMinInlierRatio(double ratio) {minInlierRatio = ratio;}
+    double getRansacThreshold() {return ransacThreshold;}
     
 private:
-    
-    dlib::matrix<double, 0, 11> A;
-    dlib::matrix<double, 0, 1> y;
+    // The system is solved on normalized coordinates (centered, mean distance sqrt(3) and sqrt(2))
+    void computeNormalization(vector<ofVec3f>& pairsKinect, vector<ofVec2f>& pairsProjector);
+    ofVec3f normalizeKinectPoint(ofVec3f kinectPoint);
+    ofVec2f normalizeProjectorPoint(ofVec2f projectorPoint);
+    bool denormalize(dlib::matrix<double, 11, 1>& xn);
+    bool normalizeCalibration(dlib::matrix<double, 11, 1>& xn);
+    void computeResiduals(vector<ofVec3f>& pairsKinect, vector<ofVec2f>& pairsProjector);
+
+    static ofVec2f project(dlib::matrix<double, 11, 1>& p, ofVec3f point);
+    static double reprojectionCost(dlib::matrix<double, 11, 1>& p, vector<ofVec3f>& pointsKinect, vector<ofVec2f>& pointsProjector);
+    static double priorCost(dlib::matrix<double, 11, 1>& p, dlib::matrix<double, 11, 1>& prior, double priorWeight);
+    void refineLevenbergMarquardt(dlib::matrix<double, 11, 1>& p, vector<ofVec3f>& pointsKinect, vector<ofVec2f>& pointsProjector,
+                                  dlib::matrix<double, 11, 1>& prior, double priorWeight);
+
     dlib::matrix<double, 11, 1> x;
     
     ofMatrix4x4 projMatrice;
@@ -62,6 +116,17 @@ private:
     bool calibrated;
 	ofVec2f projRes;
 	ofVec2f kinectRes;
+
+    vector<double> residuals;
+    vector<bool> inliers;
+    double ransacThreshold; // Max reprojection error of an inlier in projector pixels
+    int ransacMaxIterations;
+    double minInlierRatio; // Min fraction of the pairs that must be inliers of the calibration
+
+    ofVec3f kinectCenter;
+    double kinectScale;
+    ofVec2f projectorCenter;
+    double projectorScale;
 };
 
 #endif /* defined(__Magic_Sand__Calibration__) */
@@ -368,67 +368,77 @@ namespace ofxCSG
 		return false;
 	}
     
-    // Compute plane equation from point cloud
-    static ofVec4f plane_from_points(ofVec3f* points, int n) {
-        if (n < 3){
-            ofLogVerbose("GreatSand") << "At least three points required" << endl;
-            return ofVec3f();
-        }
+    // Least squares plane fit accumulated one point at a time, without storing the points
+    struct PlaneFitAccumulator
+    {
+        double n;
+        double sx, sy, sz;
+        double sxx, sxy, sxz, syy, syz, szz;
         
-        ofVec3f sum = ofVec3f(0,0,0);
-        for (int i = 0; i < n; i++) {
-            sum = sum + points[i];
+        PlaneFitAccumulator() {
+            clear();
         }
-        ofVec3f centroid = sum/n;
-        
-        ofLogVerbose("GreatSand") << "Centroid coordinates : " << centroid << endl;
-
-        // Calc full 3x3 covariance matrix, excluding symmetries:
-        float xx = 0.0; float xy = 0.0; float xz = 0.0;
-        float yy = 0.0; float yz = 0.0; float zz = 0.0;
         
-        for (int i = 0; i < n; i++) {
-            ofVec3f r = points[i] - centroid;
-            xx += r.x * r.x;
-            xy += r.x * r.y;
-            xz += r.x * r.z;
-            yy += r.y * r.y;
-            yz += r.y * r.z;
-            zz += r.z * r.z;
+        void clear() {
+            n = 0;
+            sx = sy = sz = 0;
+            sxx = sxy = sxz = syy = syz = szz = 0;
         }
         
-        float det_x = yy*zz - yz*yz;
-        float det_y = xx*zz - xz*xz;
-        float det_z = xx*yy - xy*xy;
+        void add(ofVec3f p) {
+            n++;
+            sx += p.x; sy += p.y; sz += p.z;
+            sxx += (double)p.x * p.x; sxy += (double)p.x * p.y; sxz += (double)p.x * p.z;
+            syy += (double)p.y * p.y; syz += (double)p.y * p.z; szz += (double)p.z * p.z;
+        }
         
-        float det_max = max(det_x, max(det_y, det_z));
-        ofLogVerbose("GreatSand") << "det_max : " << det_max << endl;
-        if(det_max == 0.0){
-            ofLogVerbose("GreatSand") << "The points don't span a plane" << endl;
-            return ofVec3f();
+        // Plane equation of the accumulated points, null vector if they do not span a plane
+        ofVec4f fitPlane() {
+            if (n < 3){
+                ofLogVerbose("GreatSand") << "At least three points required" << endl;
+                return ofVec4f();
+            }
+            ofVec3f centroid = ofVec3f(sx/n, sy/n, sz/n);
+            
+            // Full 3x3 covariance matrix, excluding symmetries:
+            double xx = sxx - sx*sx/n; double xy = sxy - sx*sy/n; double xz = sxz - sx*sz/n;
+            double yy = syy - sy*sy/n; double yz = syz - sy*sz/n; double zz = szz - sz*sz/n;
+            
+            double det_x = yy*zz - yz*yz;
+            double det_y = xx*zz - xz*xz;
+            double det_z = xx*yy - xy*xy;
+            
+            double det_max = max(det_x, max(det_y, det_z));
+            if(det_max <= 0.0){
+                ofLogVerbose("GreatSand") << "The points don't span a plane" << endl;
+                return ofVec4f();
+            }
+            
+            // Pick path with best conditioning:
+            ofVec3f dir;
+            if (det_max == det_x) {
+                double a = (xz*yz - xy*zz) / det_x;
+                double b = (xy*yz - xz*yy) / det_x;
+                dir = ofVec3f(1.0, a, b);
+            } else if (det_max == det_y) {
+                double a = (yz*xz - xy*zz) / det_y;
+                double b = (xy*xz - yz*xx) / det_y;
+                dir = ofVec3f(a, 1.0, b);
+            } else {
+                double a = (yz*xy - xz*yy) / det_z;
+                double b = (xz*xy - yz*xx) / det_z;
+                dir = ofVec3f(a, b, 1.0);
+            }
+            return getPlaneEquation(centroid,dir);
         }
+    };
     
-        // Pick path with best conditioning:
-        ofVec3f dir;
-        if (det_max == det_x) {
-            ofLogVerbose("GreatSand") << "Plane oriented toward x" << endl;
-            float a = (xz*yz - xy*zz) / det_x;
-            float b = (xy*yz - xz*yy) / det_x;
-            dir = ofVec3f(1.0, a, b);
-        } else if (det_max == det_y) {
-            ofLogVerbose("GreatSand") << "Plane oriented toward y" << endl;
-            float a = (yz*xz - xy*zz) / det_y;
-            float b = (xy*xz - yz*xx) / det_y;
-            dir = ofVec3f(a, 1.0, b);
-        } else if (det_max == det_z){
-            ofLogVerbose("GreatSand") << "Plane oriented toward z" << endl;
-            float a = (yz*xy - xz*yy) / det_z;
-            float b = (xz*xy - yz*xx) / det_z;
-            dir = ofVec3f(a, b, 1.0);
-        } else {
-            ofLogVerbose("GreatSand") << "Error treating plane orientation" << endl;
+    // Compute plane equation from point cloud
+    static ofVec4f plane_from_points(ofVec3f* points, int n) {
+        PlaneFitAccumulator accumulator;
+        for (int i = 0; i < n; i++) {
+            accumulator.add(points[i]);
         }
-        
-        return getPlaneEquation(centroid,dir);
+        return accumulator.fitPlane();
     }
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+/***********************************************************************
+LayerCompositor - Composition of the renderer and game layers in the
+projector window.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "LayerCompositor.h"
+
+LayerCompositor::LayerCompositor()
+:composed(false){
+}
+
+void LayerCompositor::addLayer(string name, std::function<bool()> isActive, std::function<unsigned int()> getVersion, std::function<void()> draw){
+    Layer layer;
+    layer.name = name;
+    layer.isActive = isActive;
+    layer.getVersion = getVersion;
+    layer.draw = draw;
+    layer.wasActive = false;
+    layer.composedVersion = 0;
+    layers.push_back(layer);
+}
+
+void LayerCompositor::draw(int width, int height){
+    if (!composition.isAllocated() || composition.getWidth() != width || composition.getHeight() != height)
+    {
+        composition.allocate(width, height, GL_RGBA);
+        composed = false;
+        ofLogVerbose("LayerCompositor") << "draw(): composition framebuffer " << width << "x" << height;
+    }
+
+    bool changed = !composed;
+    for (auto & layer : layers)
+    {
+        bool active = layer.isActive();
+        if (active != layer.wasActive || (active && layer.getVersion() != layer.composedVersion))
+            changed = true;
+        layer.wasActive = active;
+    }
+
+    if (changed)
+    {
+        composition.begin();
+        ofClear(0, 0, 0, 255);
+        for (auto & layer : layers)
+        {
+            if (!layer.wasActive)
+                continue;
+            layer.draw();
+            layer.composedVersion = layer.getVersion();
+        }
+        composition.end();
+        composed = true;
+    }
+
+    // The composition is opaque: no blending with the window
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    ofSetColor(255);
+    composition.draw(0, 0);
+    ofPopStyle();
+}
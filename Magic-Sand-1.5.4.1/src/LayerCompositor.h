@@ -0,0 +1,58 @@
+/***********************************************************************
+LayerCompositor - Composition of the renderer and game layers in the
+projector window.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+
+//! Draws the projector window layers, skipping the idle ones
+/** Each layer tells if it is active and gives a version number that changes whenever its
+    content changes. Inactive layers are neither rendered by their owner nor drawn. The active
+    layers are composed in one framebuffer, which is only composed again when a layer becomes
+    active or inactive or when the version of an active layer changes: the other frames draw
+    the composition in a single pass */
+class LayerCompositor {
+public:
+    LayerCompositor();
+
+    // Layers are drawn in the order they are added
+    void addLayer(string name, std::function<bool()> isActive, std::function<unsigned int()> getVersion, std::function<void()> draw);
+    // To be called from the projector window draw: the framebuffer belongs to its GL context
+    void draw(int width, int height);
+    // Compose again at the next draw (the layers were not drawn in between)
+    void invalidate(){
+        composed = false;
+    }
+
+private:
+    struct Layer {
+        string name;
+        std::function<bool()> isActive;
+        std::function<unsigned int()> getVersion;
+        std::function<void()> draw;
+        bool wasActive;
+        unsigned int composedVersion;
+    };
+
+    vector<Layer> layers;
+    ofFbo composition;
+    bool composed;
+};
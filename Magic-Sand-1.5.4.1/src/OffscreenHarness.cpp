@@ -0,0 +1,271 @@
+/***********************************************************************
+OffscreenHarness - Runs the application on recorded depth frames without
+visible windows, compares the projector images to golden images and logs
+the frame timings.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "OffscreenHarness.h"
+#include "FrameClock.h"
+
+OffscreenHarness::Settings::Settings()
+:enabled(false),
+goldenDir("offscreen/golden"),
+outputDir("offscreen"),
+frames(300),
+goldenInterval(30),
+tolerance(2),
+updateGoldens(false),
+width(1280),
+height(800){
+}
+
+OffscreenHarness::Settings OffscreenHarness::parseArguments(int argc, char* argv[]){
+    Settings s;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--offscreen" && hasValue)
+        {
+            s.enabled = true;
+            s.recordingDir = argv[++i];
+        }
+        else if (arg == "--golden" && hasValue)
+            s.goldenDir = argv[++i];
+        else if (arg == "--output" && hasValue)
+            s.outputDir = argv[++i];
+        else if (arg == "--frames" && hasValue)
+            s.frames = max(1, ofToInt(argv[++i]));
+        else if (arg == "--interval" && hasValue)
+            s.goldenInterval = max(1, ofToInt(argv[++i]));
+        else if (arg == "--tolerance" && hasValue)
+            s.tolerance = ofToFloat(argv[++i]);
+        else if (arg == "--update-goldens")
+            s.updateGoldens = true;
+        else if (arg == "--size" && hasValue)
+        {
+            vector<string> size = ofSplitString(argv[++i], "x");
+            if (size.size() == 2)
+            {
+                s.width = max(1, ofToInt(size[0]));
+                s.height = max(1, ofToInt(size[1]));
+            }
+        }
+        else
+            ofLogWarning("OffscreenHarness") << "parseArguments(): ignored argument " << arg;
+    }
+    return s;
+}
+
+OffscreenHarness::OffscreenHarness()
+:frameCount(0),
+comparisons(0),
+failures(0),
+updateStart(0),
+updateTime(0),
+pendingTimings(false),
+pendingFrame(0),
+pendingUpdateTime(0),
+pendingDrawTime(0),
+totalUpdateTime(0),
+totalDrawTime(0),
+totalGPUTime(0),
+gpuTimedFrames(0),
+gpuTimer(false),
+gpuQuery(0){
+}
+
+void OffscreenHarness::setup(const Settings& ssettings){
+    settings = ssettings;
+    if (!settings.enabled)
+        return;
+
+    // Same random effects and animation times at each run
+    ofSeedRandom(0);
+    FrameClock::setFixedStep(getFrameTime());
+
+    ofDirectory::createDirectory(settings.goldenDir, true, true);
+    ofDirectory::createDirectory(settings.outputDir, true, true);
+    timingsFile.open(settings.outputDir + "/timings.csv", ofFile::WriteOnly);
+    timingsFile << "frame,update_ms,draw_cpu_ms,draw_gpu_ms" << endl;
+
+#ifndef TARGET_OPENGLES
+    gpuTimer = GLEW_ARB_timer_query;
+    if (gpuTimer)
+        glGenQueries(1, &gpuQuery);
+#endif
+    ofLogNotice("OffscreenHarness") << "setup(): " << settings.frames << " frames of " << settings.recordingDir
+        << " at " << settings.width << "x" << settings.height << (gpuTimer ? "" : ", no GPU timer");
+}
+
+void OffscreenHarness::beginUpdate(){
+    updateStart = ofGetElapsedTimeMicros();
+}
+
+void OffscreenHarness::endUpdate(){
+    updateTime = (ofGetElapsedTimeMicros() - updateStart) / 1000.0;
+}
+
+void OffscreenHarness::drawFrame(bool newDepthFrame, std::function<void()> draw){
+    if (!newDepthFrame || frameCount >= settings.frames)
+        return;
+    if (!frame.isAllocated())
+        frame.allocate(settings.width, settings.height, GL_RGBA);
+
+    // The previous frame's GPU time is known by now
+    writeTimings(false);
+
+    uint64_t drawStart = ofGetElapsedTimeMicros();
+#ifndef TARGET_OPENGLES
+    if (gpuTimer)
+        glBeginQuery(GL_TIME_ELAPSED, gpuQuery);
+#endif
+    frame.begin();
+    ofClear(0, 0, 0, 255);
+    draw();
+    frame.end();
+#ifndef TARGET_OPENGLES
+    if (gpuTimer)
+        glEndQuery(GL_TIME_ELAPSED);
+#endif
+    frameCount++;
+
+    pendingTimings = true;
+    pendingFrame = frameCount;
+    pendingUpdateTime = updateTime;
+    pendingDrawTime = (ofGetElapsedTimeMicros() - drawStart) / 1000.0;
+    totalUpdateTime += pendingUpdateTime;
+    totalDrawTime += pendingDrawTime;
+
+    if (frameCount % settings.goldenInterval == 0 || frameCount == settings.frames)
+        compareWithGolden(frameCount);
+    if (frameCount == settings.frames)
+        finish();
+}
+
+void OffscreenHarness::compareWithGolden(int frameNumber){
+    ofPixels image;
+    frame.readToPixels(image);
+    string name = "frame_" + ofToString(frameNumber, 4, '0') + ".png";
+    string goldenName = settings.goldenDir + "/" + name;
+
+    if (settings.updateGoldens)
+    {
+        ofSaveImage(image, goldenName);
+        ofLogNotice("OffscreenHarness") << "compareWithGolden(): frame " << frameNumber << " written to " << goldenName;
+        return;
+    }
+
+    ofPixels golden;
+    comparisons++;
+    if (!ofFile::doesFileExist(goldenName))
+    {
+        failures++;
+        ofSaveImage(image, settings.outputDir + "/" + "failed_" + name);
+        ofLogError("OffscreenHarness") << "compareWithGolden(): frame " << frameNumber << ": no golden image " << goldenName
+            << " (run with --update-goldens to write it)";
+        return;
+    }
+    if (!ofLoadImage(golden, goldenName) || golden.getWidth() != image.getWidth() || golden.getHeight() != image.getHeight())
+    {
+        failures++;
+        ofLogError("OffscreenHarness") << "compareWithGolden(): frame " << frameNumber << ": " << goldenName << " can not be read or has another size";
+        return;
+    }
+
+    // Mean absolute difference of the color channels, and an amplified difference image
+    ofPixels difference;
+    difference.allocate(image.getWidth(), image.getHeight(), OF_PIXELS_RGB);
+    size_t numPixels = image.getWidth() * image.getHeight();
+    size_t imageChannels = image.getNumChannels();
+    size_t goldenChannels = golden.getNumChannels();
+    const unsigned char* a = image.getData();
+    const unsigned char* b = golden.getData();
+    unsigned char* d = difference.getData();
+    double sum = 0;
+    for (size_t i = 0; i < numPixels; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            int diff = abs(int(a[i * imageChannels + c]) - int(b[i * goldenChannels + c]));
+            sum += diff;
+            d[i * 3 + c] = min(255, diff * 8);
+        }
+    }
+    float meanDifference = sum / (numPixels * 3);
+
+    if (meanDifference > settings.tolerance)
+    {
+        failures++;
+        ofSaveImage(image, settings.outputDir + "/" + "failed_" + name);
+        ofSaveImage(difference, settings.outputDir + "/" + "difference_" + name);
+        ofLogError("OffscreenHarness") << "compareWithGolden(): frame " << frameNumber << " differs from " << goldenName
+            << " (mean difference " << meanDifference << " > " << settings.tolerance << ")";
+    }
+    else
+        ofLogNotice("OffscreenHarness") << "compareWithGolden(): frame " << frameNumber << " matches (mean difference " << meanDifference << ")";
+}
+
+void OffscreenHarness::writeTimings(bool waitForGPU){
+    if (!pendingTimings)
+        return;
+    float gpuTime = -1;
+#ifndef TARGET_OPENGLES
+    if (gpuTimer)
+    {
+        GLint available = 0;
+        if (!waitForGPU)
+            glGetQueryObjectiv(gpuQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (waitForGPU || available)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(gpuQuery, GL_QUERY_RESULT, &elapsed);
+            gpuTime = elapsed / 1000000.0;
+            totalGPUTime += gpuTime;
+            gpuTimedFrames++;
+        }
+    }
+#endif
+    timingsFile << pendingFrame << "," << pendingUpdateTime << "," << pendingDrawTime << ",";
+    if (gpuTime >= 0)
+        timingsFile << gpuTime;
+    timingsFile << endl;
+    ofLogVerbose("OffscreenHarness") << "frame " << pendingFrame << ": update " << pendingUpdateTime
+        << " ms, draw " << pendingDrawTime << " ms (CPU) " << gpuTime << " ms (GPU)";
+    pendingTimings = false;
+}
+
+void OffscreenHarness::finish(){
+    writeTimings(true);
+    timingsFile.close();
+#ifndef TARGET_OPENGLES
+    if (gpuTimer)
+        glDeleteQueries(1, &gpuQuery);
+#endif
+
+    ofLogNotice("OffscreenHarness") << "finish(): " << frameCount << " frames, mean update " << totalUpdateTime / frameCount
+        << " ms, mean draw " << totalDrawTime / frameCount << " ms (CPU) "
+        << (gpuTimedFrames > 0 ? ofToString(totalGPUTime / gpuTimedFrames) : string("-")) << " ms (GPU)";
+    if (settings.updateGoldens)
+        ofLogNotice("OffscreenHarness") << "finish(): golden images written to " << settings.goldenDir;
+    else
+        ofLogNotice("OffscreenHarness") << "finish(): " << failures << " of " << comparisons << " golden image comparisons failed";
+    ofExit(min(failures, 255));
+}
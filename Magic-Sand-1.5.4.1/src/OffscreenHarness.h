@@ -0,0 +1,96 @@
+/***********************************************************************
+OffscreenHarness - Runs the application on recorded depth frames without
+visible windows, compares the projector images to golden images and logs
+the frame timings.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+
+//! Offscreen run of the projector rendering on a depth recording
+/** The windows are hidden and the kinect grabber plays the recorded frames. Each projector
+    frame following a new depth frame is rendered in a framebuffer, its CPU and GPU draw times and
+    the CPU update time are written to timings.csv, and every goldenInterval frames the image is
+    compared to the golden image of that frame. A missing golden image is a failure, unless the
+    run updates the golden images. The application exits after the last frame with the number of
+    failed comparisons (at most 255) as status */
+class OffscreenHarness {
+public:
+    struct Settings {
+        Settings();
+        bool enabled;
+        string recordingDir; // Raw depth frames played by the kinect grabber
+        string goldenDir; // Reference projector images
+        string outputDir; // Timings and images of the failed comparisons
+        int frames; // Number of depth frames to run
+        int goldenInterval; // Frames between two compared images
+        float tolerance; // Largest accepted mean absolute difference (0-255) with a golden image
+        bool updateGoldens; // Write the golden images instead of comparing with them
+        int width, height; // Projector resolution
+    };
+    // --offscreen <recording dir> [--golden <dir>] [--output <dir>] [--frames n] [--interval n]
+    // [--tolerance t] [--size wxh] [--update-goldens]. Settings.enabled is false without --offscreen
+    static Settings parseArguments(int argc, char* argv[]);
+
+    OffscreenHarness();
+
+    void setup(const Settings& settings);
+    bool isEnabled(){
+        return settings.enabled;
+    }
+    const Settings& getSettings(){
+        return settings;
+    }
+    // Fixed time step of the simulation, so that a run does not depend on the machine speed
+    double getFrameTime(){
+        return 1.0 / 60;
+    }
+
+    // To be called around the update of the application
+    void beginUpdate();
+    void endUpdate();
+    // To be called from the projector window draw: renders the frame in the framebuffer
+    // if a new depth frame was received in the update
+    void drawFrame(bool newDepthFrame, std::function<void()> draw);
+
+private:
+    void compareWithGolden(int frame);
+    void writeTimings(bool waitForGPU);
+    void finish();
+
+    Settings settings;
+    ofFbo frame;
+    int frameCount;
+    int comparisons;
+    int failures;
+
+    // Timings of the last frame, written once its GPU time is known
+    uint64_t updateStart;
+    float updateTime;
+    bool pendingTimings;
+    int pendingFrame;
+    float pendingUpdateTime, pendingDrawTime;
+    double totalUpdateTime, totalDrawTime, totalGPUTime;
+    int gpuTimedFrames;
+    ofFile timingsFile;
+
+    bool gpuTimer;
+    GLuint gpuQuery;
+};
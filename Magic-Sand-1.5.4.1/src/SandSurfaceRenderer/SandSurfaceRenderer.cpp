@@ -24,11 +24,29 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 ***********************************************************************/
 
 #include "SandSurfaceRenderer.h"
+#include "../FrameClock.h"
 
 using namespace ofxCSG;
 
 SandSurfaceRenderer::SandSurfaceRenderer(std::shared_ptr<KinectProjector> const& k, std::shared_ptr<ofAppBaseWindow> const& p)
 :settingsLoaded(false),
+useProceduralGrid(false),
+gridShadersLoaded(false),
+gridDecimation(1),
+gridStripColumns(0),
+useAdaptiveLOD(false),
+lodTolerance(3.0),
+patchesX(0),
+patchesY(0),
+useProjectorSpaceRendering(false),
+warpShaderLoaded(false),
+warpTexturesDirty(true),
+warpMapStep(1),
+useWaterSimulation(false),
+waterShaderLoaded(false),
+waterCellSize(2),
+sandboxDirty(true),
+projectorLayerVersion(0),
 editColorMap(false){
     kinectProjector = k;
     projWindow = p;
@@ -39,15 +57,12 @@ void SandSurfaceRenderer::setup(bool sdisplayGui){
     
     // Sandbox contourlines
     drawContourLines = true; // Flag if topographic contour lines are enabled
+    singlePassContourLines = true;
 	contourLineDistance = 10.0; // Elevation distance between adjacent topographic contour lines in millimiters
     
-    // Initialize the fbos and images
+    // Initialize the fbos and images - the contour line fbo is allocated when the two pass contour lines are used
     projResX = projWindow->getWidth();
     projResY = projWindow->getHeight();
-    contourLineFramebufferObject.allocate(projResX+1, projResY+1, GL_RGBA);
-    contourLineFramebufferObject.begin();
-    ofClear(0,0,0,255);
-    contourLineFramebufferObject.end();
 
     //Try to load settings file if possible
     if (loadSettings())
@@ -103,9 +118,6 @@ void SandSurfaceRenderer::setup(bool sdisplayGui){
     
 	kinectROI = kinectProjector->getKinectROI();
 
-    //setup the mesh
-    setupMesh();
-    
 	// Load shaders
     bool loaded = true;
 #ifdef TARGET_OPENGLES
@@ -118,17 +130,53 @@ void SandSurfaceRenderer::setup(bool sdisplayGui){
 		loaded = loaded && elevationShader.load("shaders/shadersGL3/elevationShader");
         ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL3/heightMapShader";
 		loaded = loaded && heightMapShader.load("shaders/shadersGL3/heightMapShader");
+        gridShadersLoaded = loadGridShader(elevationGridShader, "shaders/shadersGL3/", "elevationGridShader", "elevationShader")
+            && loadGridShader(heightMapGridShader, "shaders/shadersGL3/", "heightMapGridShader", "heightMapShader");
+        ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL3/heightMapWarpShader";
+        warpShaderLoaded = heightMapWarpShader.load("shaders/shadersGL3/heightMapWarpShader");
+        ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL3/waterShader";
+        waterShaderLoaded = waterSimulation.loadShaders("shaders/shadersGL3/") && waterShader.load("shaders/shadersGL3/waterShader");
 	}else{
         ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL2/elevationShader";
 		loaded = loaded && elevationShader.load("shaders/shadersGL2/elevationShader");
         ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL2/heightMapShader";
 		loaded = loaded && heightMapShader.load("shaders/shadersGL2/heightMapShader");
+        gridShadersLoaded = loadGridShader(elevationGridShader, "shaders/shadersGL2/", "elevationGridShader", "elevationShader")
+            && loadGridShader(heightMapGridShader, "shaders/shadersGL2/", "heightMapGridShader", "heightMapShader");
+        ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL2/heightMapWarpShader";
+        warpShaderLoaded = heightMapWarpShader.load("shaders/shadersGL2/heightMapWarpShader");
+        ofLogVerbose("SandSurfaceRenderer") << "setup(): Loading shadersGL2/waterShader";
+        waterShaderLoaded = waterSimulation.loadShaders("shaders/shadersGL2/") && waterShader.load("shaders/shadersGL2/waterShader");
 	}
 #endif
     if (!loaded)
     {
         ofLogError("GreatSand") << "setup(): shader not loaded" ;
     }
+    if (useProceduralGrid && !gridShadersLoaded)
+    {
+        ofLogWarning("SandSurfaceRenderer") << "setup(): grid shaders not loaded, using the CPU mesh";
+        useProceduralGrid = false;
+    }
+
+    if (useProjectorSpaceRendering && !warpShaderLoaded)
+    {
+        ofLogWarning("SandSurfaceRenderer") << "setup(): warp shader not loaded, using the kinect space rendering";
+        useProjectorSpaceRendering = false;
+    }
+    if (useWaterSimulation && !waterShaderLoaded)
+    {
+        ofLogWarning("SandSurfaceRenderer") << "setup(): water shaders not loaded, water simulation disabled";
+        useWaterSimulation = false;
+    }
+
+    //setup the grid strip and the mesh - the mesh is only built when it is used
+    if (useProceduralGrid || useProjectorSpaceRendering || useWaterSimulation)
+        updateROIMaskTexture();
+    if (!useProceduralGrid)
+        setupMesh();
+    if (useWaterSimulation)
+        waterSimulation.setupGrid(kinectROI, waterCellSize);
     
     //Prepare fbo
     fboProjWindow.allocate(projResX, projResY, GL_RGBA);
@@ -186,40 +234,217 @@ void SandSurfaceRenderer::setupMesh(){
     meshheight = kinectROI.height;
     mesh.clear();
 
+    // Only pixels inside the sand area get a vertex - the sandbox walls are not drawn
+    std::vector<int> vertexIndex(meshwidth*meshheight, -1);
 	for (unsigned int y = 0; y < meshheight; y++)
         for(unsigned int x=0;x<meshwidth;x++)
         {
+            if (!kinectProjector->isInsideKinectROI(x+kinectROI.x, y+kinectROI.y))
+                continue;
             ofPoint pt = ofPoint(x+kinectROI.x,y+kinectROI.y,0.0f)-ofPoint(0.5,0.5,0); // We move of a half pixel to center the color pixel (more beautiful)
+            vertexIndex[x+y*meshwidth] = mesh.getNumVertices();
             mesh.addVertex(pt); // make a new vertex
             mesh.addTexCoord(pt);
         }
     for(unsigned int y=0;y<meshheight-1;y++)
         for(unsigned int x=0;x<meshwidth-1;x++)
         {
-            mesh.addIndex(x+y*meshwidth);         // 0
-            mesh.addIndex((x+1)+y*meshwidth);     // 1
-            mesh.addIndex(x+(y+1)*meshwidth);     // 10
-            
-            mesh.addIndex((x+1)+y*meshwidth);     // 1
-            mesh.addIndex((x+1)+(y+1)*meshwidth); // 11
-            mesh.addIndex(x+(y+1)*meshwidth);     // 10
+            int i0 = vertexIndex[x+y*meshwidth];
+            int i1 = vertexIndex[(x+1)+y*meshwidth];
+            int i10 = vertexIndex[x+(y+1)*meshwidth];
+            int i11 = vertexIndex[(x+1)+(y+1)*meshwidth];
+
+            // No triangles with a corner outside the mask
+            if (i0 >= 0 && i1 >= 0 && i10 >= 0)
+            {
+                mesh.addIndex(i0);  // 0
+                mesh.addIndex(i1);  // 1
+                mesh.addIndex(i10); // 10
+            }
+            if (i1 >= 0 && i11 >= 0 && i10 >= 0)
+            {
+                mesh.addIndex(i1);  // 1
+                mesh.addIndex(i11); // 11
+                mesh.addIndex(i10); // 10
+            }
         }
+	ofLogVerbose("SandSurfaceRenderer") << "setupMesh. Vertices: " << mesh.getNumVertices() << " of " << meshwidth*meshheight;
+}
+
+void SandSurfaceRenderer::setupGridStrip(int columns){
+    // One grid row of columns vertices, drawGrid only draws the columns of the grid
+    gridStripColumns = std::max(columns, 2);
+    gridStrip.clear();
+    gridStrip.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
+    gridStrip.setUsage(GL_STATIC_DRAW);
+    for (int x = 0; x < gridStripColumns; x++)
+    {
+        gridStrip.addVertex(ofPoint(x, 0, 0));
+        gridStrip.addVertex(ofPoint(x, 1, 0));
+    }
+}
+
+void SandSurfaceRenderer::fitGridStripToROI(){
+    // Columns of the full ROI grid at the current decimation
+    setupGridStrip((int)ceil((kinectROI.width-1)/gridDecimation)+1);
+    ofLogVerbose("SandSurfaceRenderer") << "fitGridStripToROI(): " << gridStripColumns << " columns";
+}
+
+void SandSurfaceRenderer::updateROIMaskTexture(){
+    kinectROI = kinectProjector->getKinectROI();
+    ofLogVerbose("SandSurfaceRenderer") << "updateROIMaskTexture(): KinectROI: " << kinectROI;
+
+    ofPixels& mask = kinectProjector->getKinectROIMask();
+    if (mask.isAllocated())
+    {
+        kinectROIMaskTexture.loadData(mask);
+    } else {
+        // No sand polygon: the whole ROI is sand
+        ofVec2f kinectRes = kinectProjector->getKinectRes();
+        ofPixels fullMask;
+        fullMask.allocate(kinectRes.x, kinectRes.y, 1);
+        fullMask.set(255);
+        kinectROIMaskTexture.loadData(fullMask);
+    }
+    kinectROIMaskTexture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+    fitGridStripToROI();
+    setupTerrainPatches();
+}
+
+void SandSurfaceRenderer::setupTerrainPatches(){
+    ofVec2f ROIEnd(kinectROI.getMaxX()-1, kinectROI.getMaxY()-1);
+    patchesX = std::max(0, (int)ceil((kinectROI.width-1)/terrainPatchSize));
+    patchesY = std::max(0, (int)ceil((kinectROI.height-1)/terrainPatchSize));
+    terrainPatches.resize(patchesX*patchesY);
+    ofPixels& mask = kinectProjector->getKinectROIMask();
+    for (int j = 0; j < patchesY; j++)
+        for (int i = 0; i < patchesX; i++)
+        {
+            TerrainPatch& patch = terrainPatches[i+j*patchesX];
+            patch.origin = ofVec2f(kinectROI.x+i*terrainPatchSize, kinectROI.y+j*terrainPatchSize);
+            patch.end = ofVec2f(std::min(patch.origin.x+terrainPatchSize, ROIEnd.x), std::min(patch.origin.y+terrainPatchSize, ROIEnd.y));
+            patch.step = 1;
+
+            // A coarse triangle crossing the mask border would be discarded as a whole
+            bool sand = false, walls = false;
+            if (mask.isAllocated())
+                for (int y = patch.origin.y; y <= patch.end.y; y++)
+                    for (int x = patch.origin.x; x <= patch.end.x; x++)
+                    {
+                        if (mask.getData()[y*mask.getWidth()+x] != 0)
+                            sand = true;
+                        else
+                            walls = true;
+                    }
+            patch.onMaskBorder = sand && walls;
+        }
+    ofLogVerbose("SandSurfaceRenderer") << "setupTerrainPatches(): " << patchesX << "x" << patchesY << " patches";
+}
+
+void SandSurfaceRenderer::updateTerrainPatches(){
+    const ofFloatPixels& elevation = kinectProjector->getElevationImage();
+    if (!elevation.isAllocated())
+        return; // Base plane not set yet: keep the full resolution
+
+    const float* elevationData = elevation.getData();
+    ofPixels& mask = kinectProjector->getKinectROIMask();
+    const unsigned char* maskData = mask.isAllocated() ? mask.getData() : nullptr;
+    int width = elevation.getWidth();
+    for (auto& patch : terrainPatches)
+    {
+        // Relief of the sand inside the patch, the sandbox walls are not drawn
+        float minElevation = FLT_MAX;
+        float maxElevation = -FLT_MAX;
+        for (int y = patch.origin.y; y <= patch.end.y; y++)
+            for (int x = patch.origin.x; x <= patch.end.x; x++)
+            {
+                int idx = y*width+x;
+                if (maskData != nullptr && maskData[idx] == 0)
+                    continue;
+                minElevation = std::min(minElevation, elevationData[idx]);
+                maxElevation = std::max(maxElevation, elevationData[idx]);
+            }
+        if (maxElevation < minElevation)
+        {
+            patch.step = 0;
+            continue;
+        }
+        if (patch.onMaskBorder)
+        {
+            patch.step = 1;
+            continue;
+        }
+
+        // Halve the vertex spacing each time the relief doubles
+        float relief = maxElevation-minElevation;
+        int step = terrainMaxStep;
+        while (step > 1 && relief > lodTolerance*terrainMaxStep/step)
+            step /= 2;
+        patch.step = step;
+    }
+}
+
+bool SandSurfaceRenderer::loadGridShader(ofShader& shader, string shaderDir, string vertexName, string fragmentName){
+    // The grid vertex shaders are linked with the fragment shaders of the mesh rendering
+    ofLogVerbose("SandSurfaceRenderer") << "loadGridShader(): Loading " << shaderDir << vertexName;
+    if (!shader.setupShaderFromFile(GL_VERTEX_SHADER, shaderDir+vertexName+".vert"))
+        return false;
+    if (!shader.setupShaderFromFile(GL_FRAGMENT_SHADER, shaderDir+fragmentName+".frag"))
+        return false;
+    shader.bindDefaults();
+    return shader.linkProgram();
 }
 
 void SandSurfaceRenderer::update(){
     // Update Renderer state if needed
-    //if (kinectProjector->isROIUpdated() || kinectProjector->getKinectROI() != kinectROI)
-	if (kinectProjector->getKinectROI() != kinectROI)
-		setupMesh();
+	if (kinectProjector->isROIUpdated() || kinectProjector->getKinectROI() != kinectROI)
+    {
+        sandboxDirty = true;
+        if (useProceduralGrid || useProjectorSpaceRendering || useWaterSimulation)
+            updateROIMaskTexture();
+        if (!useProceduralGrid)
+            setupMesh();
+        if (useWaterSimulation)
+            waterSimulation.setupGrid(kinectROI, waterCellSize);
+        warpTexturesDirty = true;
+    }
     if (kinectProjector->isBasePlaneUpdated())
+    {
+        sandboxDirty = true;
         updateRangesAndBasePlane();
+        warpTexturesDirty = true;
+    }
     if (kinectProjector->isCalibrationUpdated())
+    {
+        sandboxDirty = true;
         updateConversionMatrices();
-    
-    // Draw sandbox
-    if (drawContourLines)
-        prepareContourLinesFbo();
-    drawSandbox();
+        warpTexturesDirty = true;
+    }
+    if (useProjectorSpaceRendering && warpTexturesDirty)
+        updateWarpTextures();
+
+    // Draw sandbox, only when the sand, the rendering settings or the water changed
+    if (kinectProjector->isDepthFrameNew() || sandboxDirty || useWaterSimulation)
+    {
+        if (isProjectorSpaceRendering())
+        {
+            drawSandboxProjectorSpace();
+        } else {
+            // The patch relief only changes with the sand, not with the water redraws
+            if (useProceduralGrid && useAdaptiveLOD && (kinectProjector->isDepthFrameNew() || sandboxDirty))
+                updateTerrainPatches();
+            if (drawContourLines && !singlePassContourLines)
+                prepareContourLinesFbo();
+            drawSandbox();
+        }
+        if (useWaterSimulation)
+        {
+            updateWaterSimulation();
+            drawWater();
+        }
+        sandboxDirty = false;
+        projectorLayerVersion++;
+    }
     
     // GUI
 	if (displayGui) {
@@ -254,39 +479,166 @@ void SandSurfaceRenderer::drawSandbox() {
     fboProjWindow.begin();
     ofBackground(0);
     kinectProjector->bind();
-    heightMapShader.begin();
-    heightMapShader.setUniformMatrix4f("kinectProjMatrix",transposedKinectProjMatrix);
-    heightMapShader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
-    heightMapShader.setUniform2f("heightColorMapTransformation",ofVec2f(heightMapScale,heightMapOffset));
-    heightMapShader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
-    heightMapShader.setUniform4f("basePlaneEq", basePlaneEq);
-    heightMapShader.setUniformTexture("heightColorMapSampler",heightMap.getTexture(), 2);
-    heightMapShader.setUniformTexture("pixelCornerElevationSampler", contourLineFramebufferObject.getTexture(), 3);
-    heightMapShader.setUniform1f("contourLineFactor", contourLineFactor);
-    heightMapShader.setUniform1i("drawContourLines", drawContourLines);
-    mesh.draw();
-    heightMapShader.end();
+    ofShader& shader = useProceduralGrid ? heightMapGridShader : heightMapShader;
+    shader.begin();
+    shader.setUniformMatrix4f("kinectProjMatrix",transposedKinectProjMatrix);
+    shader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
+    shader.setUniform2f("heightColorMapTransformation",ofVec2f(heightMapScale,heightMapOffset));
+    shader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
+    shader.setUniform4f("basePlaneEq", basePlaneEq);
+    shader.setUniformTexture("heightColorMapSampler",heightMap.getTexture(), 2);
+    if (drawContourLines && !singlePassContourLines)
+        shader.setUniformTexture("pixelCornerElevationSampler", contourLineFramebufferObject.getTexture(), 3);
+    shader.setUniform2f("contourLineFboTransformation",ofVec2f(contourLineFboScale,contourLineFboOffset));
+    shader.setUniform1f("contourLineFactor", contourLineFactor);
+    shader.setUniform1i("drawContourLines", drawContourLines);
+    shader.setUniform1i("singlePassContourLines", singlePassContourLines);
+    drawSurface(shader);
+    shader.end();
+    kinectProjector->unbind();
+    fboProjWindow.end();
+}
+
+bool SandSurfaceRenderer::isProjectorSpaceRendering(){
+    // Falls back to the kinect space rendering until the projector is calibrated
+    return useProjectorSpaceRendering && projToKinectTexture.isAllocated();
+}
+
+void SandSurfaceRenderer::updateWarpTextures(){
+    ofFloatPixels projToKinectMap, seaLevelInvDepth;
+    if (!kinectProjector->getProjToKinectWarp(projToKinectMap, seaLevelInvDepth, warpMapStep))
+        return; // Not calibrated: keep the current warp
+    projToKinectTexture.loadData(projToKinectMap);
+    seaLevelInvDepthTexture.loadData(seaLevelInvDepth);
+    projToKinectTexture.setTextureMinMagFilter(GL_LINEAR, GL_LINEAR);
+    seaLevelInvDepthTexture.setTextureMinMagFilter(GL_LINEAR, GL_LINEAR);
+    warpTexturesDirty = false;
+    ofLogVerbose("SandSurfaceRenderer") << "updateWarpTextures(): warp textures loaded (" << projToKinectMap.getWidth() << "x" << projToKinectMap.getHeight() << ")";
+}
+
+void SandSurfaceRenderer::drawSandboxProjectorSpace() {
+    fboProjWindow.begin();
+    ofBackground(0);
+    kinectProjector->bind();
+    heightMapWarpShader.begin();
+    heightMapWarpShader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
+    heightMapWarpShader.setUniform2f("heightColorMapTransformation",ofVec2f(heightMapScale,heightMapOffset));
+    heightMapWarpShader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
+    heightMapWarpShader.setUniform4f("basePlaneEq", basePlaneEq);
+    heightMapWarpShader.setUniformTexture("heightColorMapSampler",heightMap.getTexture(), 2);
+    heightMapWarpShader.setUniformTexture("projToKinectSampler", projToKinectTexture, 3);
+    heightMapWarpShader.setUniformTexture("kinectROIMaskSampler", kinectROIMaskTexture, 4);
+    heightMapWarpShader.setUniformTexture("seaLevelInvDepthSampler", seaLevelInvDepthTexture, 5);
+    heightMapWarpShader.setUniform1f("warpMapStep", warpMapStep);
+    heightMapWarpShader.setUniform2f("contourLineFboTransformation",ofVec2f(contourLineFboScale,contourLineFboOffset));
+    heightMapWarpShader.setUniform1f("contourLineFactor", contourLineFactor);
+    heightMapWarpShader.setUniform1i("drawContourLines", drawContourLines);
+    ofDrawRectangle(0, 0, projResX, projResY);
+    heightMapWarpShader.end();
+    kinectProjector->unbind();
+    fboProjWindow.end();
+}
+
+void SandSurfaceRenderer::updateWaterSimulation(){
+    // Size of a water cell on the base plane
+    float cellLength = basePlaneOffset.z*fabs(transposedKinectWorldMatrix(0,0))*waterCellSize;
+    waterSimulation.setTerrain(kinectProjector->getTexture(), kinectROIMaskTexture, transposedKinectWorldMatrix,
+                               ofVec2f(FilteredDepthScale,FilteredDepthOffset), basePlaneEq, cellLength);
+    waterSimulation.update(FrameClock::getLastFrameTime());
+}
+
+void SandSurfaceRenderer::drawWater(){
+    if (!waterSimulation.isReady())
+        return;
+
+    // One grid vertex per water cell, blended over the sand colors
+    ofRectangle gridROI = waterSimulation.getGridROI();
+    fboProjWindow.begin();
+    kinectProjector->bind();
+    waterShader.begin();
+    waterShader.setUniformMatrix4f("kinectProjMatrix",transposedKinectProjMatrix);
+    waterShader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
+    waterShader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
+    waterShader.setUniformTexture("kinectROIMaskSampler", kinectROIMaskTexture, 4);
+    waterShader.setUniformTexture("waterSampler", waterSimulation.getWaterTexture(), 6);
+    waterShader.setUniform1f("minWaterDepth", 0.5);
+    waterShader.setUniform1f("deepWaterDepth", 30.0);
+    drawGrid(waterShader, ofVec2f(gridROI.x, gridROI.y), ofVec2f(gridROI.getMaxX()-1, gridROI.getMaxY()-1),
+             waterSimulation.getCellSize(), ofVec4f(waterSimulation.getCellSize()));
+    waterShader.end();
     kinectProjector->unbind();
     fboProjWindow.end();
 }
 
 void SandSurfaceRenderer::prepareContourLinesFbo()
 {
+    if (!contourLineFramebufferObject.isAllocated())
+        contourLineFramebufferObject.allocate(projResX+1, projResY+1, GL_RGBA);
     contourLineFramebufferObject.begin();
     ofClear(255,255,255, 0);
     kinectProjector->bind();
-	elevationShader.begin();
-    elevationShader.setUniformMatrix4f("kinectProjMatrix",transposedKinectProjMatrix);
-    elevationShader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
-    elevationShader.setUniform2f("contourLineFboTransformation",ofVec2f(contourLineFboScale,contourLineFboOffset));
-    elevationShader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
-    elevationShader.setUniform4f("basePlaneEq", basePlaneEq);
-    mesh.draw();
-    elevationShader.end();
+    ofShader& shader = useProceduralGrid ? elevationGridShader : elevationShader;
+	shader.begin();
+    shader.setUniformMatrix4f("kinectProjMatrix",transposedKinectProjMatrix);
+    shader.setUniformMatrix4f("kinectWorldMatrix",transposedKinectWorldMatrix);
+    shader.setUniform2f("contourLineFboTransformation",ofVec2f(contourLineFboScale,contourLineFboOffset));
+    shader.setUniform2f("depthTransformation",ofVec2f(FilteredDepthScale,FilteredDepthOffset));
+    shader.setUniform4f("basePlaneEq", basePlaneEq);
+    drawSurface(shader);
+    shader.end();
     kinectProjector->unbind();
     contourLineFramebufferObject.end();
 }
 
+void SandSurfaceRenderer::drawSurface(ofShader& shader){
+    if (!useProceduralGrid)
+    {
+        mesh.draw();
+        return;
+    }
+
+    shader.setUniformTexture("kinectROIMaskSampler", kinectROIMaskTexture, 4);
+    if (!useAdaptiveLOD)
+    {
+        ofVec2f ROIEnd(kinectROI.getMaxX()-1, kinectROI.getMaxY()-1);
+        drawGrid(shader, ofVec2f(kinectROI.x, kinectROI.y), ROIEnd, gridDecimation, ofVec4f(gridDecimation));
+        return;
+    }
+
+    // The border shared with a coarser neighbour uses the neighbour vertex spacing
+    auto stepAt = [this](int i, int j) {
+        if (i < 0 || j < 0 || i >= patchesX || j >= patchesY)
+            return 0;
+        return terrainPatches[i+j*patchesX].step;
+    };
+    for (int j = 0; j < patchesY; j++)
+        for (int i = 0; i < patchesX; i++)
+        {
+            const TerrainPatch& patch = terrainPatches[i+j*patchesX];
+            if (patch.step == 0)
+                continue;
+            ofVec4f edgeStep(std::max(patch.step, stepAt(i-1, j)), std::max(patch.step, stepAt(i+1, j)),
+                             std::max(patch.step, stepAt(i, j-1)), std::max(patch.step, stepAt(i, j+1)));
+            drawGrid(shader, patch.origin, patch.end, patch.step, edgeStep);
+        }
+}
+
+void SandSurfaceRenderer::drawGrid(ofShader& shader, ofVec2f origin, ofVec2f end, int step, ofVec4f edgeStep){
+    // Grid of (gridSize.x+1) x (gridSize.y+1) vertices every step pixels, the last ones clamped on end
+    ofVec2f gridSize(ceil((end.x-origin.x)/step), ceil((end.y-origin.y)/step));
+    if (gridSize.x < 1 || gridSize.y < 1)
+        return;
+    shader.setUniform2f("gridOrigin", origin);
+    shader.setUniform2f("gridEnd", end);
+    shader.setUniform2f("gridSize", gridSize);
+    shader.setUniform1f("gridStep", step);
+    shader.setUniform4f("edgeStep", edgeStep);
+    // Only the first gridSize.x+1 columns of the strip, so a patch costs its own vertices only
+    if (gridSize.x+1 > gridStripColumns)
+        setupGridStrip(gridSize.x+1); // Water cells smaller than the decimation
+    gridStrip.getVbo().drawInstanced(GL_TRIANGLE_STRIP, 0, 2*(gridSize.x+1), gridSize.y);
+}
+
 void SandSurfaceRenderer::setupGui(){
     // instantiate the modal windows //
     auto theme = make_shared<ofxModalThemeProjKinect>();
@@ -298,6 +650,26 @@ void SandSurfaceRenderer::setupGui(){
     gui2->addToggle("Contour lines", drawContourLines)->setStripeColor(ofColor::blue);
     gui2->addSlider("Lines distance", 1, 30, contourLineDistance)->setName("Contour lines distance");
     gui2->getSlider("Contour lines distance")->setStripeColor(ofColor::blue);
+    gui2->addToggle("Single pass contour lines", singlePassContourLines)->setStripeColor(ofColor::blue);
+    gui2->addToggle("Procedural grid", useProceduralGrid)->setStripeColor(ofColor::green);
+    gui2->addSlider("Grid decimation", 1, 4, gridDecimation)->setPrecision(0);
+    gui2->getSlider("Grid decimation")->setStripeColor(ofColor::green);
+    gui2->addToggle("Adaptive LOD", useAdaptiveLOD)->setStripeColor(ofColor::green);
+    gui2->addSlider("LOD tolerance (mm)", 1, 20, lodTolerance)->setName("LOD tolerance");
+    gui2->getSlider("LOD tolerance")->setStripeColor(ofColor::green);
+    gui2->addToggle("Projector space rendering", useProjectorSpaceRendering)->setStripeColor(ofColor::green);
+    gui2->addToggle("Water simulation", useWaterSimulation)->setStripeColor(ofColor::cyan);
+    gui2->addSlider("Rain (mm/s)", 0, 20, waterSimulation.rainRate)->setName("Rain rate");
+    gui2->getSlider("Rain rate")->setStripeColor(ofColor::cyan);
+    gui2->addSlider("Hand rain (mm/s)", 0, 100, waterSimulation.handRainRate)->setName("Hand rain rate");
+    gui2->getSlider("Hand rain rate")->setStripeColor(ofColor::cyan);
+    gui2->addSlider("Drain (mm/s)", 0, 10, waterSimulation.drainRate)->setName("Drain rate");
+    gui2->getSlider("Drain rate")->setStripeColor(ofColor::cyan);
+    gui2->addSlider("Water cell size", 1, 8, waterCellSize)->setPrecision(0);
+    gui2->getSlider("Water cell size")->setStripeColor(ofColor::cyan);
+    gui2->addSlider("Water time step (ms)", 1, 10, waterSimulation.timeStep*1000)->setName("Water time step");
+    gui2->getSlider("Water time step")->setStripeColor(ofColor::cyan);
+    gui2->addButton("Dry sand")->setStripeColor(ofColor::cyan);
     gui2->addDropdown("Load Color Map", colorMapFilesList)->setName("Load Color Map");
     gui2->getDropdown("Load Color Map")->setStripeColor(ofColor::yellow);
     gui2->addHeader(":: Display ::", false);
@@ -319,6 +691,7 @@ void SandSurfaceRenderer::setupGui(){
     
     // once the gui has been assembled, register callbacks to listen for component specific events //
     gui2->onToggleEvent(this, &SandSurfaceRenderer::onToggleEvent);
+    gui2->onButtonEvent(this, &SandSurfaceRenderer::onButtonEvent);
     gui2->onSliderEvent(this, &SandSurfaceRenderer::onSliderEvent);
     gui2->onDropdownEvent(this, &SandSurfaceRenderer::onDropdownEvent);
     gui->onButtonEvent(this, &SandSurfaceRenderer::onButtonEvent);
@@ -373,9 +746,17 @@ void SandSurfaceRenderer::populateColorList(){
     colorList->get(0)->setLabelAlignment(ofxDatGuiAlignment::CENTER);
 }
 
+void SandSurfaceRenderer::onRenderingChanged(){
+    // The GUI changed a rendering setting or the color map: draw the sandbox again on next update
+    sandboxDirty = true;
+}
+
 void SandSurfaceRenderer::onButtonEvent(ofxDatGuiButtonEvent e){
+    onRenderingChanged();
     if (e.target->is("Save")) {
         saveModal->show();
+    } else if (e.target->is("Dry sand")) {
+        waterSimulation.clear();
     } else if (e.target->is("Reset colors")) {
         heightMap.loadFile(colorMapPath+colorMapFile);
         populateColorList();
@@ -428,14 +809,58 @@ void SandSurfaceRenderer::onButtonEvent(ofxDatGuiButtonEvent e){
 }
 
 void SandSurfaceRenderer::onToggleEvent(ofxDatGuiToggleEvent e){
+    onRenderingChanged();
     if (e.target->is("Contour lines")) {
         drawContourLines = e.checked;
+    } else if (e.target->is("Single pass contour lines")) {
+        singlePassContourLines = e.checked;
+    } else if (e.target->is("Procedural grid")) {
+        if (e.checked && !gridShadersLoaded)
+        {
+            ofLogWarning("SandSurfaceRenderer") << "onToggleEvent(): grid shaders not loaded";
+            e.target->setChecked(false);
+            return;
+        }
+        useProceduralGrid = e.checked;
+        if (useProceduralGrid)
+            updateROIMaskTexture();
+        else
+            setupMesh();
+    } else if (e.target->is("Adaptive LOD")) {
+        useAdaptiveLOD = e.checked;
+    } else if (e.target->is("Projector space rendering")) {
+        if (e.checked && !warpShaderLoaded)
+        {
+            ofLogWarning("SandSurfaceRenderer") << "onToggleEvent(): warp shader not loaded";
+            e.target->setChecked(false);
+            return;
+        }
+        useProjectorSpaceRendering = e.checked;
+        if (useProjectorSpaceRendering)
+        {
+            updateROIMaskTexture();
+            warpTexturesDirty = true;
+        }
+    } else if (e.target->is("Water simulation")) {
+        if (e.checked && !waterShaderLoaded)
+        {
+            ofLogWarning("SandSurfaceRenderer") << "onToggleEvent(): water shaders not loaded";
+            e.target->setChecked(false);
+            return;
+        }
+        useWaterSimulation = e.checked;
+        if (useWaterSimulation)
+        {
+            updateROIMaskTexture();
+            waterSimulation.setupGrid(kinectROI, waterCellSize);
+        }
     } else if (e.target->is("Edit")) {
         editColorMap = e.checked;
     }
 }
 
 void SandSurfaceRenderer::onColorPickerEvent(ofxDatGuiColorPickerEvent e){
+    onRenderingChanged();
     if (e.target->is("ColorPicker")) {
         int i = selectedColor;
         int j = heightMap.size()-1-i;
@@ -445,9 +870,30 @@ void SandSurfaceRenderer::onColorPickerEvent(ofxDatGuiColorPickerEvent e){
 }
 
 void SandSurfaceRenderer::onSliderEvent(ofxDatGuiSliderEvent e){
+    onRenderingChanged();
     if (e.target->is("Contour lines distance")) {
         contourLineDistance = e.value;
         contourLineFactor = contourLineFboScale/contourLineDistance;        
+    } else if (e.target->is("Grid decimation")) {
+        gridDecimation = (int)e.value;
+        fitGridStripToROI();
+    } else if (e.target->is("LOD tolerance")) {
+        lodTolerance = e.value;
+    } else if (e.target->is("Rain rate")) {
+        waterSimulation.rainRate = e.value;
+    } else if (e.target->is("Hand rain rate")) {
+        waterSimulation.handRainRate = e.value;
+    } else if (e.target->is("Drain rate")) {
+        waterSimulation.drainRate = e.value;
+    } else if (e.target->is("Water time step")) {
+        waterSimulation.timeStep = e.value/1000;
+        if (waterSimulation.getStableTimeStep() < waterSimulation.timeStep)
+            ofLogVerbose("SandSurfaceRenderer") << "onSliderEvent(): water time step above the stability bound, run in steps of "
+                << waterSimulation.getStableTimeStep()*1000 << " ms";
+    } else if (e.target->is("Water cell size")) {
+        waterCellSize = (int)e.value;
+        if (useWaterSimulation)
+            waterSimulation.setupGrid(kinectROI, waterCellSize);
     } else if (e.target->is("Height")) {
         int i = selectedColor;
         int j = heightMap.size()-1-i;
@@ -457,12 +903,14 @@ void SandSurfaceRenderer::onSliderEvent(ofxDatGuiSliderEvent e){
 }
 
 void SandSurfaceRenderer::onDropdownEvent(ofxDatGuiDropdownEvent e){
+    onRenderingChanged();
     colorMapFile = e.target->getLabel();
     heightMap.loadFile(colorMapPath+e.target->getLabel());
     populateColorList();
 }
 
 void SandSurfaceRenderer::onScrollViewEvent(ofxDatGuiScrollViewEvent e){
+    onRenderingChanged();
     int i = e.index;
     if (i != selectedColor){
         int j = heightMap.size()-1-i;
@@ -514,7 +962,19 @@ bool SandSurfaceRenderer::loadSettings(){
     xml.setTo("SURFACERENDERERSETTINGS");
     colorMapFile = xml.getValue<string>("colorMapFile");
     drawContourLines = xml.getValue<bool>("drawContourLines");
+    singlePassContourLines = xml.getValue<bool>("singlePassContourLines", true);
     contourLineDistance = xml.getValue<float>("contourLineDistance");
+    useProceduralGrid = xml.getValue<bool>("useProceduralGrid", false);
+    gridDecimation = ofClamp(xml.getValue<int>("gridDecimation", 1), 1, 4);
+    useAdaptiveLOD = xml.getValue<bool>("useAdaptiveLOD", false);
+    lodTolerance = xml.getValue<float>("lodTolerance", 3.0);
+    useProjectorSpaceRendering = xml.getValue<bool>("useProjectorSpaceRendering", false);
+    useWaterSimulation = xml.getValue<bool>("useWaterSimulation", false);
+    waterCellSize = ofClamp(xml.getValue<int>("waterCellSize", 2), 1, 8);
+    waterSimulation.rainRate = xml.getValue<float>("rainRate", 0);
+    waterSimulation.handRainRate = xml.getValue<float>("handRainRate", 40);
+    waterSimulation.drainRate = xml.getValue<float>("drainRate", 0.5);
+    waterSimulation.timeStep = ofClamp(xml.getValue<float>("waterTimeStep", 0.004), 0.001, 0.01);
     
     return true;
 }
@@ -527,7 +987,19 @@ bool SandSurfaceRenderer::saveSettings(){
     xml.setTo("SURFACERENDERERSETTINGS");
     xml.addValue("colorMapFile", colorMapFile);
     xml.addValue("drawContourLines", drawContourLines);
+    xml.addValue("singlePassContourLines", singlePassContourLines);
     xml.addValue("contourLineDistance", contourLineDistance);
+    xml.addValue("useProceduralGrid", useProceduralGrid);
+    xml.addValue("gridDecimation", gridDecimation);
+    xml.addValue("useAdaptiveLOD", useAdaptiveLOD);
+    xml.addValue("lodTolerance", lodTolerance);
+    xml.addValue("useProjectorSpaceRendering", useProjectorSpaceRendering);
+    xml.addValue("useWaterSimulation", useWaterSimulation);
+    xml.addValue("waterCellSize", waterCellSize);
+    xml.addValue("rainRate", waterSimulation.rainRate);
+    xml.addValue("handRainRate", waterSimulation.handRainRate);
+    xml.addValue("drainRate", waterSimulation.drainRate);
+    xml.addValue("waterTimeStep", waterSimulation.timeStep);
     xml.setToParent();
     return xml.save(settingsFile);
 }
@@ -30,6 +30,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "ofMain.h"
 #include "../KinectProjector/KinectProjector.h"
 #include "ColorMap.h"
+#include "WaterSimulation.h"
 
 
 class SaveModal : public ofxModalWindow
@@ -71,6 +72,10 @@ public:
     void update();
     void drawMainWindow(float x, float y, float width, float height);
     void drawProjectorWindow();
+    // Changes each time the projector window framebuffer is drawn again (see LayerCompositor)
+    unsigned int getProjectorLayerVersion(){
+        return projectorLayerVersion;
+    }
     
     // Gui and events functions
     void setupGui();
@@ -86,12 +91,26 @@ public:
 private:
     // Private methods
     void setupMesh();
+    void setupGridStrip(int columns);
+    void fitGridStripToROI();
+    void updateROIMaskTexture();
+    bool loadGridShader(ofShader& shader, string shaderDir, string vertexName, string fragmentName);
+    void drawSurface(ofShader& shader);
+    void setupTerrainPatches();
+    void updateTerrainPatches();
+    void drawGrid(ofShader& shader, ofVec2f origin, ofVec2f end, int step, ofVec4f edgeStep);
     void updateConversionMatrices();
     void updateRangesAndBasePlane();
     void drawSandbox();
+    void drawSandboxProjectorSpace();
+    bool isProjectorSpaceRendering();
+    void updateWarpTextures();
+    void updateWaterSimulation();
+    void drawWater();
     void prepareContourLinesFbo();
     void updateColorListColor(int i, int j);
     void populateColorList();
+    void onRenderingChanged();
     bool loadSettings();
     bool saveSettings();
     
@@ -112,10 +131,56 @@ private:
     ofMesh mesh;
     int meshwidth;          //Mesh size
     int meshheight;
+
+    // Procedural grid: a single row triangle strip instanced once per grid row, the vertex
+    // positions are generated in the shader from the ROI. Only the strip length follows the ROI
+    bool useProceduralGrid;
+    bool gridShadersLoaded;
+    int gridDecimation; // Kinect pixels between two grid vertices
+    ofVboMesh gridStrip;
+    int gridStripColumns; // Vertex columns of the strip: the ROI grid at the current decimation, grown if a grid needs more
+    ofTexture kinectROIMaskTexture; // Sand area mask sampled by the grid shaders
+
+    // Adaptive level of detail: the ROI is split in square patches drawn with the procedural
+    // grid, each patch vertex spacing follows the relief of the sand in the patch
+    struct TerrainPatch {
+        ofVec2f origin, end; // First and last kinect pixel - neighbouring patches share their borders
+        int step; // Vertex spacing, 0 when the patch only covers the sandbox walls
+        bool onMaskBorder; // Covers sand and walls: kept at full resolution as the shader discards the triangles crossing the mask border
+    };
+    static const int terrainPatchSize = 32;
+    static const int terrainMaxStep = 8;
+    bool useAdaptiveLOD;
+    float lodTolerance; // Patch relief (in mm) under which the coarsest vertex spacing is used
+    int patchesX, patchesY;
+    std::vector<TerrainPatch> terrainPatches;
+
+    // Projector space rendering: a single projector window quad, each fragment finds the sand
+    // it lights through the projector to kinect warp refined against the depth texture
+    bool useProjectorSpaceRendering;
+    bool warpShaderLoaded;
+    bool warpTexturesDirty; // Calibration, base plane or ROI changed since the warp textures were loaded
+    ofTexture projToKinectTexture; // One texel every warpMapStep projector pixels, linearly interpolated
+    ofTexture seaLevelInvDepthTexture;
+    int warpMapStep;
+
+    // Water flowing on the sand, drawn over the sand colors with the procedural grid
+    bool useWaterSimulation;
+    bool waterShaderLoaded;
+    int waterCellSize; // Kinect pixels per water cell
+    WaterSimulation waterSimulation;
+
+    // The sandbox is only drawn again on a new depth frame or when the rendering changed
+    bool sandboxDirty;
+    unsigned int projectorLayerVersion;
     
     // Shaders
     ofShader elevationShader;
     ofShader heightMapShader;
+    ofShader elevationGridShader;
+    ofShader heightMapGridShader;
+    ofShader heightMapWarpShader;
+    ofShader waterShader;
     
     // FBos
     ofFbo   fboProjWindow;    
@@ -141,6 +206,7 @@ private:
     // Contourlines
     float contourLineDistance, contourLineFactor;
     bool drawContourLines; // Flag if topographic contour lines are enabled
+    bool singlePassContourLines; // Contour lines from the elevation derivatives, without the contour line fbo pass
     
     // GUI Main interface and Modal
     bool displayGui;
@@ -0,0 +1,171 @@
+/***********************************************************************
+WaterSimulation - Shallow water simulation on the sand surface running
+in ping-pong framebuffers on the GPU.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "WaterSimulation.h"
+
+static const float gravity = 9810; // mm/s2
+static const float fluxDamping = 0.995; // Fraction of the pipe flows kept from one step to the next
+static const int maxStepsPerUpdate = 16; // Above this the water slows down instead of stalling the frame
+static const float maxWaterDepth = 100; // mm, deepest water for which the time step is kept stable
+static const float stabilitySafety = 0.5; // Fraction of the CFL bound used as the largest time step
+
+static bool linkPassShader(ofShader& shader, string shaderDir, string fragmentName)
+{
+    ofLogVerbose("WaterSimulation") << "loadShaders(): Loading " << shaderDir << fragmentName;
+    if (!shader.setupShaderFromFile(GL_VERTEX_SHADER, shaderDir+"waterPassShader.vert"))
+        return false;
+    if (!shader.setupShaderFromFile(GL_FRAGMENT_SHADER, shaderDir+fragmentName+".frag"))
+        return false;
+    shader.bindDefaults();
+    return shader.linkProgram();
+}
+
+WaterSimulation::WaterSimulation()
+:timeStep(0.004),
+rainRate(0),
+handRainRate(40),
+handRainElevation(150),
+drainRate(0.5),
+shadersLoaded(false),
+current(0),
+cellSize(1),
+gridResX(0),
+gridResY(0),
+timeAccumulator(0),
+depthTexture(nullptr),
+kinectROIMask(nullptr),
+cellLength(1){
+}
+
+bool WaterSimulation::loadShaders(string shaderDir){
+    shadersLoaded = linkPassShader(fluxShader, shaderDir, "waterFluxShader")
+        && linkPassShader(updateShader, shaderDir, "waterUpdateShader");
+    return shadersLoaded;
+}
+
+void WaterSimulation::setupGrid(ofRectangle kinectROI, int scellSize){
+    cellSize = std::max(1, scellSize);
+    gridROI = kinectROI;
+    gridResX = std::max(1, (int)(kinectROI.width/cellSize));
+    gridResY = std::max(1, (int)(kinectROI.height/cellSize));
+    for (int i = 0; i < 2; i++)
+    {
+        waterFbo[i].allocate(gridResX, gridResY, GL_RGBA32F);
+        fluxFbo[i].allocate(gridResX, gridResY, GL_RGBA32F);
+    }
+    clear();
+    ofLogVerbose("WaterSimulation") << "setupGrid(): " << gridResX << "x" << gridResY << " cells over " << gridROI;
+}
+
+void WaterSimulation::clear(){
+    for (int i = 0; i < 2; i++)
+    {
+        waterFbo[i].begin();
+        ofClear(0, 0, 0, 0);
+        waterFbo[i].end();
+        fluxFbo[i].begin();
+        ofClear(0, 0, 0, 0);
+        fluxFbo[i].end();
+    }
+    current = 0;
+    timeAccumulator = 0;
+}
+
+void WaterSimulation::setTerrain(ofTexture& sdepthTexture, ofTexture& skinectROIMask, const ofMatrix4x4& stransposedKinectWorldMatrix, ofVec2f sdepthTransformation, ofVec4f sbasePlaneEq, float scellLength){
+    depthTexture = &sdepthTexture;
+    kinectROIMask = &skinectROIMask;
+    transposedKinectWorldMatrix = stransposedKinectWorldMatrix;
+    depthTransformation = sdepthTransformation;
+    basePlaneEq = sbasePlaneEq;
+    cellLength = std::max(scellLength, 0.1f);
+}
+
+void WaterSimulation::update(float elapsedTime){
+    if (!isReady() || depthTexture == nullptr || kinectROIMask == nullptr)
+        return;
+
+    // The flows are stored in the alpha channel: no blending in the simulation passes
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    timeAccumulator += elapsedTime;
+    float dt = getStableTimeStep();
+    int steps = 0;
+    while (timeAccumulator >= dt && steps < maxStepsPerUpdate)
+    {
+        step(dt);
+        timeAccumulator -= dt;
+        steps++;
+    }
+    if (steps == maxStepsPerUpdate)
+        timeAccumulator = 0;
+    ofPopStyle();
+}
+
+float WaterSimulation::getStableTimeStep(){
+    // CFL condition: the shallow water waves (speed sqrt(g.h)) must not cross more than a cell per step
+    float maxStep = cellLength/sqrt(gravity*maxWaterDepth)*stabilitySafety;
+    return std::min(timeStep, maxStep);
+}
+
+void WaterSimulation::step(float dt){
+    int next = 1-current;
+    float cellArea = cellLength*cellLength;
+
+    // Pipe flows from the current water surface
+    fluxFbo[next].begin();
+    fluxShader.begin();
+    fluxShader.setUniformTexture("waterSampler", waterFbo[current].getTexture(), 1);
+    fluxShader.setUniformTexture("fluxSampler", fluxFbo[current].getTexture(), 2);
+    fluxShader.setUniform2f("gridRes", ofVec2f(gridResX, gridResY));
+    fluxShader.setUniform1f("timeStep", dt);
+    fluxShader.setUniform1f("pipeFactor", gravity*cellLength);
+    fluxShader.setUniform1f("cellArea", cellArea);
+    fluxShader.setUniform1f("fluxDamping", fluxDamping);
+    ofDrawRectangle(0, 0, gridResX, gridResY);
+    fluxShader.end();
+    fluxFbo[next].end();
+
+    // Water depths from the new flows, the rain and the drain
+    waterFbo[next].begin();
+    updateShader.begin();
+    updateShader.setUniformTexture("waterSampler", waterFbo[current].getTexture(), 1);
+    updateShader.setUniformTexture("fluxSampler", fluxFbo[next].getTexture(), 2);
+    updateShader.setUniformTexture("depthSampler", *depthTexture, 3);
+    updateShader.setUniformTexture("kinectROIMaskSampler", *kinectROIMask, 4);
+    updateShader.setUniform2f("gridOrigin", ofVec2f(gridROI.x, gridROI.y));
+    updateShader.setUniform1f("cellSize", cellSize);
+    updateShader.setUniform2f("gridRes", ofVec2f(gridResX, gridResY));
+    updateShader.setUniform1f("timeStep", dt);
+    updateShader.setUniform1f("cellArea", cellArea);
+    updateShader.setUniform2f("depthTransformation", depthTransformation);
+    updateShader.setUniformMatrix4f("kinectWorldMatrix", transposedKinectWorldMatrix);
+    updateShader.setUniform4f("basePlaneEq", basePlaneEq);
+    updateShader.setUniform1f("rainRate", rainRate);
+    updateShader.setUniform1f("handRainRate", handRainRate);
+    updateShader.setUniform1f("handRainElevation", handRainElevation);
+    updateShader.setUniform1f("drainRate", drainRate);
+    ofDrawRectangle(0, 0, gridResX, gridResY);
+    updateShader.end();
+    waterFbo[next].end();
+
+    current = next;
+}
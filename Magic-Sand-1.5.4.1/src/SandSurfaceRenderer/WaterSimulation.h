@@ -0,0 +1,90 @@
+/***********************************************************************
+WaterSimulation - Shallow water simulation on the sand surface running
+in ping-pong framebuffers on the GPU.
+Copyright (c) 2025 GlT-Ricardo
+
+This file is part of the Magic Sand.
+
+The Magic Sand is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Magic Sand is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Magic Sand; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#pragma once
+#include "ofMain.h"
+
+//! Virtual pipes shallow water model on a grid covering the kinect ROI
+/** Each cell stores its water depth and the sand elevation under it, and the flows
+    through the pipes to its four neighbours. The terrain is read from the filtered
+    depth texture at each step so the water follows the sand as it is shaped.
+    Everything stays in float framebuffers: the CPU only issues the passes */
+class WaterSimulation {
+public:
+    WaterSimulation();
+
+    bool loadShaders(string shaderDir);
+    // Allocate the grid (cellSize kinect pixels per cell) over the ROI and dry it
+    void setupGrid(ofRectangle kinectROI, int cellSize);
+    void clear();
+    // Sand surface seen by the kinect, in the format used by the sand renderer shaders
+    void setTerrain(ofTexture& depthTexture, ofTexture& kinectROIMask, const ofMatrix4x4& transposedKinectWorldMatrix, ofVec2f depthTransformation, ofVec4f basePlaneEq, float cellLength);
+    // Run the fixed time steps covering elapsedTime (s)
+    void update(float elapsedTime);
+    // timeStep bounded by the stability condition of the grid: larger steps are split in smaller ones
+    float getStableTimeStep();
+
+    bool isReady(){
+        return shadersLoaded && waterFbo[0].isAllocated();
+    }
+    // r: water depth (mm), g: terrain elevation (mm) of each cell
+    ofTexture& getWaterTexture(){
+        return waterFbo[current].getTexture();
+    }
+    ofRectangle getGridROI(){
+        return gridROI;
+    }
+    int getCellSize(){
+        return cellSize;
+    }
+
+    float timeStep; // Requested simulation time step (s), see getStableTimeStep
+    float rainRate; // Rain falling on the whole sand (mm/s)
+    float handRainRate; // Rain falling under the hands and objects held above the sand (mm/s)
+    float handRainElevation; // Elevation above which the kinect sees a hand instead of sand (mm)
+    float drainRate; // Water absorbed by the sand (mm/s)
+
+private:
+    void step(float dt);
+
+    bool shadersLoaded;
+    ofShader fluxShader;
+    ofShader updateShader;
+
+    // Ping-pong framebuffers, current holds the last state
+    ofFbo waterFbo[2];
+    ofFbo fluxFbo[2];
+    int current;
+
+    ofRectangle gridROI;
+    int cellSize;
+    int gridResX, gridResY;
+    float timeAccumulator;
+
+    // Terrain
+    ofTexture* depthTexture;
+    ofTexture* kinectROIMask;
+    ofMatrix4x4 transposedKinectWorldMatrix;
+    ofVec2f depthTransformation;
+    ofVec4f basePlaneEq;
+    float cellLength; // Cell side in mm at the base plane
+};
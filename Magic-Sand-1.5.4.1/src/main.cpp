@@ -63,7 +63,11 @@ bool setWindowDimensions(ofGLFWWindowSettings& settings, int windowsNum) {
 }
 
 //========================================================================
-int main() {
+int main(int argc, char* argv[]) {
+	// Offscreen runs (--offscreen <depth recording>): hidden windows of the projector resolution.
+	// With no display or GPU, run under Xvfb with a software GL (e.g. LIBGL_ALWAYS_SOFTWARE=1 for llvmpipe)
+	OffscreenHarness::Settings offscreenSettings = OffscreenHarness::parseArguments(argc, argv);
+
 	ofGLFWWindowSettings settings;
 //	setFirstWindowDimensions(settings);
 	//settings.width = 1200;
@@ -74,13 +78,22 @@ int main() {
 	settings.resizable = true;
 	settings.decorated = true;
 	settings.title = "Magic-Sand " + MagicSandVersion;
+	settings.visible = !offscreenSettings.enabled;
 	shared_ptr<ofAppBaseWindow> mainWindow = ofCreateWindow(settings);
     
-	setWindowDimensions(settings, 0);
-	mainWindow->setWindowPosition(ofGetScreenWidth() / 2 - settings.width / 2, ofGetScreenHeight() / 2 - settings.height / 2);
-    mainWindow->setWindowShape(settings.width, settings.height);
-    
-	setWindowDimensions(settings, 1);
+	if (offscreenSettings.enabled)
+	{
+		settings.width = offscreenSettings.width;
+		settings.height = offscreenSettings.height;
+	}
+	else
+	{
+		setWindowDimensions(settings, 0);
+		mainWindow->setWindowPosition(ofGetScreenWidth() / 2 - settings.width / 2, ofGetScreenHeight() / 2 - settings.height / 2);
+		mainWindow->setWindowShape(settings.width, settings.height);
+
+		setWindowDimensions(settings, 1);
+	}
 	settings.resizable = false;
 	settings.decorated = false;
 	settings.shareContextWith = mainWindow;
@@ -90,6 +103,7 @@ int main() {
 	shared_ptr<ofApp> mainApp(new ofApp);
 	ofAddListener(secondWindow->events().draw, mainApp.get(), &ofApp::drawProjWindow);
 	mainApp->projWindow = secondWindow;
+	mainApp->offscreen.setup(offscreenSettings);
 		
 	ofRunApp(mainWindow, mainApp);
 	ofRunMainLoop();
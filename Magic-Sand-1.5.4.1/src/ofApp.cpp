@@ -29,6 +29,8 @@ void ofApp::setup() {
 
 	// Setup kinectProjector
 	kinectProjector = std::make_shared<KinectProjector>(projWindow);
+	if (offscreen.isEnabled())
+		kinectProjector->setDepthPlayback(offscreen.getSettings().recordingDir);
 	kinectProjector->setup(true);
 
 	// Setup sandSurfaceRenderer
@@ -63,10 +65,32 @@ void ofApp::setup() {
 	feedingGameController.setKinectRes(kinectRes);
 	feedingGameController.setKinectROI(kinectROI);
 
+	// Projector window layers, in drawing order
+	projectorCompositor.addLayer("Sand", [] { return true; },
+		[this] { return sandSurfaceRenderer->getProjectorLayerVersion(); },
+		[this] { sandSurfaceRenderer->drawProjectorWindow(); });
+	projectorCompositor.addLayer("Map game", [this] { return mapGameController.isProjectorLayerActive(); },
+		[this] { return mapGameController.getProjectorLayerVersion(); },
+		[this] { mapGameController.drawProjectorWindow(); });
+	projectorCompositor.addLayer("Boid game", [this] { return boidGameController.isProjectorLayerActive(); },
+		[this] { return boidGameController.getProjectorLayerVersion(); },
+		[this] { boidGameController.drawProjectorWindow(); });
+	projectorCompositor.addLayer("Survival game", [this] { return survivalGameController.isProjectorLayerActive(); },
+		[this] { return survivalGameController.getProjectorLayerVersion(); },
+		[this] { survivalGameController.drawProjectorWindow(); });
+	projectorCompositor.addLayer("Feeding game", [this] { return feedingGameController.isProjectorLayerActive(); },
+		[this] { return feedingGameController.getProjectorLayerVersion(); },
+		[this] { feedingGameController.drawProjectorWindow(); });
+
+	// Offscreen runs start directly with the saved calibration
+	if (offscreen.isEnabled())
+		kinectProjector->startApplication();
 }
 
 
 void ofApp::update() {
+	offscreen.beginUpdate();
+	FrameClock::tick();
 	kinectProjector->update();
 	sandSurfaceRenderer->update();
 
@@ -80,10 +104,12 @@ void ofApp::update() {
 	}
 
 	// Atualizar todos os controllers
+	simulationClock.advance(FrameClock::getLastFrameTime());
 	mapGameController.update();
-	boidGameController.update();
-	survivalGameController.update();
-	feedingGameController.update();
+	boidGameController.update(simulationClock);
+	survivalGameController.update(simulationClock);
+	feedingGameController.update(simulationClock);
+	offscreen.endUpdate();
 }
 
 
@@ -106,14 +132,22 @@ void ofApp::draw()
 }
 
 void ofApp::drawProjWindow(ofEventArgs &args) 
+{
+	if (offscreen.isEnabled())
+		offscreen.drawFrame(kinectProjector->isDepthFrameNew(), [this] { drawProjectorLayers(); });
+	else
+		drawProjectorLayers();
+}
+
+void ofApp::drawProjectorLayers()
 {
 	if (kinectProjector->GetApplicationState() == KinectProjector::APPLICATION_STATE_RUNNING)
 	{
-		sandSurfaceRenderer->drawProjectorWindow();
-		mapGameController.drawProjectorWindow();
-		boidGameController.drawProjectorWindow();
-		survivalGameController.drawProjectorWindow();
-		feedingGameController.drawProjectorWindow();
+		projectorCompositor.draw(projWindow->getWidth(), projWindow->getHeight());
+	}
+	else
+	{
+		projectorCompositor.invalidate();
 	}
 	kinectProjector->drawProjectorWindow();
 }
@@ -180,6 +214,10 @@ void ofApp::keyPressed(int key)
 			feedingGameController.StartGame(); // Vai para INTRO
 		}
 	}
+	else if (key == 'r') // Record the depth frames for the offscreen runs
+	{
+		kinectProjector->toggleDepthRecording();
+	}
 }
 
 void ofApp::keyReleased(int key) {
@@ -8,6 +8,10 @@
 #include "Games/BoidGameController.h"
 #include "Games/SurvivalGameController.h"    // Adicionados
 #include "Games/FeedingGameController.h"     // Adicionados
+#include "Games/SimulationClock.h"
+#include "LayerCompositor.h"
+#include "OffscreenHarness.h"
+#include "FrameClock.h"
 
 class ofApp : public ofBaseApp {
 
@@ -32,14 +36,19 @@ public:
 	void gotMessage(ofMessage msg);
 
 	std::shared_ptr<ofAppBaseWindow> projWindow;
+	OffscreenHarness offscreen;                      // Set up by main() when run with --offscreen
 
 private:
+	void drawProjectorLayers();
+
 	std::shared_ptr<KinectProjector> kinectProjector;
 	SandSurfaceRenderer* sandSurfaceRenderer;
 	CMapGameController mapGameController;
 	CBoidGameController boidGameController;
 	CSurvivalGameController survivalGameController;  // Adicionados
 	CFeedingGameController feedingGameController;    // Adicionados
+	SimulationClock simulationClock;                 // Fixed rate ticks of the BOIDS, shared by the games
+	LayerCompositor projectorCompositor;             // Sand and game layers of the projector window
 
 													 
 	ofRectangle mainWindowROI;			// Main window ROI 	